@@ -0,0 +1,305 @@
+/*****************************************************************
+*** Throughput benchmark: run a set of 6502 workloads for a   ***
+*** fixed cycle budget each and report the speed as JSON.     ***
+*****************************************************************/
+
+//Every workload is an endless loop (it jumps back to its start), so the emulator never leaves the hot path.
+//Each one is run <repeats> times, the fastest run is reported.
+//With -p the host hardware counters of that run are reported as well, per emulated instruction.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "../src/6502.h"
+#include "../src/mem.h"
+#include "../src/perfctr.h"
+
+
+#define CODE_START      0x0200      //workloads are placed behind zeropage and stack
+#define DEFAULT_BUDGET  50000000    //cycles per run
+#define DEFAULT_REPEATS 3
+
+
+typedef struct
+{
+    const char* name;
+    const word* code;
+    uint32_t    length;
+    void        (*setup)(TMemory mem);  //prepare data, may be NULL
+} TWorkload;
+
+
+//nested 8-bit count down loops, see mini_progs/countdown.asm
+static const word countdown[] =
+{
+    0xA0, 0x10,             //start: LDY #$10
+    0xA2, 0xFF,             //outer: LDX #$FF
+    0xCA,                   //loop:  DEX
+    0xD0, 0xFD,             //       BNE loop
+    0x88,                   //       DEY
+    0xD0, 0xF8,             //       BNE outer
+    0x4C, 0x00, 0x02        //       JMP start
+};
+
+//32 bit addition a = a + b, see mini_progs/aplusb.asm
+static const word addition[] =
+{
+    0x18,                   //start: CLC
+    0xAD, 0x43, 0x20,       //       LDA $2043
+    0x65, 0x20,             //       ADC $20
+    0x8D, 0x43, 0x20,       //       STA $2043
+    0xAD, 0x44, 0x20,       //       LDA $2044
+    0x65, 0x21,             //       ADC $21
+    0x8D, 0x44, 0x20,       //       STA $2044
+    0xAD, 0x45, 0x20,       //       LDA $2045
+    0x65, 0x22,             //       ADC $22
+    0x8D, 0x45, 0x20,       //       STA $2045
+    0xAD, 0x46, 0x20,       //       LDA $2046
+    0x65, 0x23,             //       ADC $23
+    0x8D, 0x46, 0x20,       //       STA $2046
+    0x4C, 0x00, 0x02        //       JMP start
+};
+
+static void setupAddition(TMemory mem)
+{
+    memWrite(mem, 0x37, 0x20);  //b = $00001337
+    memWrite(mem, 0x13, 0x21);
+}
+
+//copy page ($10) to page ($12), then fill page ($14) with $55
+static const word memcpyset[] =
+{
+    0xA0, 0x00,             //start: LDY #$00
+    0xB1, 0x10,             //copy:  LDA ($10),Y
+    0x91, 0x12,             //       STA ($12),Y
+    0xC8,                   //       INY
+    0xD0, 0xF9,             //       BNE copy
+    0xA9, 0x55,             //       LDA #$55
+    0xA0, 0x00,             //       LDY #$00
+    0x91, 0x14,             //fill:  STA ($14),Y
+    0xC8,                   //       INY
+    0xD0, 0xFB,             //       BNE fill
+    0x4C, 0x00, 0x02        //       JMP start
+};
+
+static void setupMemcpyset(TMemory mem)
+{
+    memWrite(mem, 0x10, 0x11);  //source $1000
+    memWrite(mem, 0x11, 0x13);  //destination $1100
+    memWrite(mem, 0x12, 0x15);  //fill $1200
+    for (uint32_t i = 0; i < 256; i++) memWrite(mem, (word)i, 0x1000 + i);
+}
+
+//scramble 64 bytes at $1000, then bubble sort them ascending
+static const word bubblesort[] =
+{
+    0xA2, 0x3F,             //start:  LDX #$3F
+    0x8A,                   //fill:   TXA
+    0x49, 0xA5,             //        EOR #$A5
+    0x9D, 0x00, 0x10,       //        STA $1000,X
+    0xCA,                   //        DEX
+    0x10, 0xF7,             //        BPL fill
+    0xA0, 0x00,             //sort:   LDY #$00        ;nothing swapped yet
+    0xA2, 0x00,             //        LDX #$00
+    0xBD, 0x00, 0x10,       //inner:  LDA $1000,X
+    0xDD, 0x01, 0x10,       //        CMP $1001,X
+    0x90, 0x0F,             //        BCC noswap
+    0xF0, 0x0D,             //        BEQ noswap
+    0x48,                   //        PHA
+    0xBD, 0x01, 0x10,       //        LDA $1001,X
+    0x9D, 0x00, 0x10,       //        STA $1000,X
+    0x68,                   //        PLA
+    0x9D, 0x01, 0x10,       //        STA $1001,X
+    0xA0, 0x01,             //        LDY #$01        ;swapped
+    0xE8,                   //noswap: INX
+    0xE0, 0x3F,             //        CPX #$3F
+    0xD0, 0xE4,             //        BNE inner
+    0xC0, 0x00,             //        CPY #$00
+    0xD0, 0xDC,             //        BNE sort
+    0x4C, 0x00, 0x02        //        JMP start
+};
+
+//bitwise CRC-32 (polynomial $EDB88320) of the page at ($10), crc in $20..$23
+static const word crc32[] =
+{
+    0xA9, 0xFF,             //start: LDA #$FF
+    0x85, 0x20,             //       STA $20
+    0x85, 0x21,             //       STA $21
+    0x85, 0x22,             //       STA $22
+    0x85, 0x23,             //       STA $23
+    0xA0, 0x00,             //       LDY #$00
+    0xB1, 0x10,             //byte:  LDA ($10),Y
+    0x45, 0x20,             //       EOR $20
+    0x85, 0x20,             //       STA $20
+    0xA2, 0x08,             //       LDX #$08
+    0x46, 0x23,             //bit:   LSR $23
+    0x66, 0x22,             //       ROR $22
+    0x66, 0x21,             //       ROR $21
+    0x66, 0x20,             //       ROR $20
+    0x90, 0x18,             //       BCC nox
+    0xA5, 0x20,             //       LDA $20
+    0x49, 0x20,             //       EOR #$20
+    0x85, 0x20,             //       STA $20
+    0xA5, 0x21,             //       LDA $21
+    0x49, 0x83,             //       EOR #$83
+    0x85, 0x21,             //       STA $21
+    0xA5, 0x22,             //       LDA $22
+    0x49, 0xB8,             //       EOR #$B8
+    0x85, 0x22,             //       STA $22
+    0xA5, 0x23,             //       LDA $23
+    0x49, 0xED,             //       EOR #$ED
+    0x85, 0x23,             //       STA $23
+    0xCA,                   //nox:   DEX
+    0xD0, 0xDB,             //       BNE bit
+    0xC8,                   //       INY
+    0xD0, 0xD0,             //       BNE byte
+    0x4C, 0x00, 0x02        //       JMP start
+};
+
+static void setupCrc32(TMemory mem)
+{
+    memWrite(mem, 0x00, 0x10);  //data at $1000
+    memWrite(mem, 0x10, 0x11);
+    for (uint32_t i = 0; i < 256; i++) memWrite(mem, (word)i, 0x1000 + i);
+}
+
+//recursion 32 levels deep, every level is a JSR/RTS pair
+static const word recursion[] =
+{
+    0xA2, 0x20,             //start: LDX #$20
+    0x20, 0x08, 0x02,       //       JSR rec
+    0x4C, 0x00, 0x02,       //       JMP start
+    0xCA,                   //rec:   DEX
+    0xF0, 0x03,             //       BEQ out
+    0x20, 0x08, 0x02,       //       JSR rec
+    0xE8,                   //out:   INX
+    0x60                    //       RTS
+};
+
+static const TWorkload workloads[] =
+{
+    { "countdown",  countdown,  sizeof(countdown),  NULL },
+    { "addition",   addition,   sizeof(addition),   setupAddition },
+    { "memcpyset",  memcpyset,  sizeof(memcpyset),  setupMemcpyset },
+    { "bubblesort", bubblesort, sizeof(bubblesort), NULL },
+    { "crc32",      crc32,      sizeof(crc32),      setupCrc32 },
+    { "recursion",  recursion,  sizeof(recursion),  NULL },
+};
+
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//reset RAM and CPU and place workload at CODE_START
+static void prepare(T6502 cpu, const TWorkload* w)
+{
+    memReset(cpu->mem);
+    cpuReset(cpu);
+
+    for (uint32_t i = 0; i < w->length; i++) memWrite(cpu->mem, w->code[i], CODE_START + i);
+    if (w->setup != NULL) w->setup(cpu->mem);
+
+    cpu->PC = CODE_START;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t budget = DEFAULT_BUDGET;
+    int repeats = DEFAULT_REPEATS;
+    const char* only = NULL;
+    int perf = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:r:w:p")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c': budget = strtoull(optarg, NULL, 0); break;
+            case 'r': repeats = atoi(optarg); break;
+            case 'w': only = optarg; break;
+            case 'p': perf = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-c cycles per run] [-r repeats] [-w workload] [-p]\n", argv[0]);
+                return -1;
+        }
+    }
+    if (repeats < 1) repeats = 1;
+
+    if (perf && perfOpen() == 0)
+    {
+        fprintf(stderr, "Warning: perf events not available, host counters are reported as null\n");
+    }
+
+    T6502 cpu = cpuInit(memInit());
+    int first = 1;
+    int status = 0;
+
+    printf("{\n  \"engine\": \"%s\",\n  \"variant\": \"%s\",\n  \"budget_cycles\": %llu,\n  \"repeats\": %d,\n  \"workloads\": [",
+           CPU_ENGINE, CPU_VARIANT, (unsigned long long)budget, repeats);
+
+    for (uint32_t i = 0; i < WORKLOAD_COUNT; i++)
+    {
+        const TWorkload* w = &workloads[i];
+        if (only != NULL && strcmp(only, w->name) != 0) continue;
+
+        double best = 0;
+        uint64_t instructions = 0;
+        uint64_t cycles = 0;
+        TPerfSample host = { { 0 } }, sample = { { 0 } };
+
+        for (int r = 0; r < repeats; r++)
+        {
+            prepare(cpu, w);
+
+            if (perf) perfBegin();
+            double t0 = now();
+            eCpuStepStatus s = cpuRun(cpu, budget);
+            double t = now() - t0;
+            if (perf) perfEnd(&sample);
+
+            if (s != CPU_STEP_OK)
+            {
+                fprintf(stderr, "Error: workload %s failed at 0x%.4X\n", w->name, cpu->PC);
+                status = -2;
+                break;
+            }
+
+            if (r == 0 || t < best)
+            {
+                best = t;
+                instructions = cpu->instructions;
+                cycles = cpu->cycles;
+                host = sample;
+            }
+        }
+        if (best <= 0) continue;
+
+        printf("%s\n    { \"name\": \"%s\", \"instructions\": %llu, \"cycles\": %llu, \"seconds\": %.6f, "
+               "\"instructions_per_sec\": %.0f, \"cycles_per_sec\": %.0f, \"mips\": %.3f, \"ns_per_instruction\": %.3f",
+               first ? "" : ",", w->name, (unsigned long long)instructions, (unsigned long long)cycles, best,
+               instructions / best, cycles / best, instructions / best / 1e6, best * 1e9 / instructions);
+        if (perf)
+        {
+            //host counters per emulated instruction
+            printf(", \"host_per_instruction\": ");
+            perfWriteJson(stdout, &host, instructions);
+        }
+        printf(" }");
+        first = 0;
+    }
+
+    printf("\n  ]\n}\n");
+
+    if (perf) perfClose();
+    free(cpu->mem);
+    free(cpu);
+    return status;
+}
@@ -0,0 +1,332 @@
+/*****************************************************************
+*** Per-opcode cost matrix: time a tight loop for every       ***
+*** documented opcode and print host ns per instruction.      ***
+*****************************************************************/
+
+//For every opcode in opcodeTable a loop is built in memory (like test_progs/<op>_<mode>/, but without xa):
+//LOOP_COPIES copies of the instruction followed by JMP back to the start. Operands are chosen so that every
+//copy falls through to the next one:
+//- memory operands point into a scratch area, (zp,X) and (zp),Y pointers as well
+//- branches have offset 0, JMP/JMP () target the next copy
+//- instructions that need a partner are timed as pair: JSR/RTS, BRK/RTI, PHA/PLA and PHP/PLP (65C02: PHX/PLX,
+//  PHY/PLY too); BRK vectors through $FFFE to an RTI, which returns behind BRK's padding byte
+//The JMP closing the loop is counted as well, it adds about 1% to each result.
+//With -p the host hardware counters of the fastest run are collected too and reported per emulated
+//instruction, for every opcode (JSON) and per handler group, i.e. addressing mode (text).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "../src/6502.h"
+#include "../src/mem.h"
+#include "../src/opcodes.h"
+#include "../src/perfctr.h"
+#include "../src/utils.h"
+
+
+#define CODE_START      0x0200      //loop start
+#define SUB_START       0x0F00      //subroutine for JSR, just RTS
+#define IRQ_START       0x0F10      //interrupt handler for BRK, just RTI
+#define DATA_START      0x3000      //scratch area for memory operands
+#define JMP_PTRS        0x3100      //pointer table for JMP (), one pointer per copy
+#define ZRP_DATA        0x80        //zeropage operand
+#define ZRP_PTR         0x40        //zeropage pointer for (zp,X) and (zp),Y, points to DATA_START
+#define LOOP_COPIES     100
+#define DEFAULT_BUDGET  5000000     //cycles per run
+#define DEFAULT_REPEATS 3
+
+
+typedef struct
+{
+    int    supported;
+    double ns;          //host ns per emulated instruction
+    uint64_t instructions;
+    TPerfSample host;   //host counters of the fastest run, only with -p
+} TResult;
+
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//opcode that has to run together with the given one, 0 if it runs alone
+static word partnerOf(word opcode)
+{
+    switch (opcode)
+    {
+        case JSR_ABS:  return RTS_IMPL;
+        case RTS_IMPL: return JSR_ABS;
+        case BRK_IMPL: return RTI_IMPL;
+        case RTI_IMPL: return BRK_IMPL;
+        case PHA_IMPL: return PLA_IMPL;
+        case PLA_IMPL: return PHA_IMPL;
+        case PHP_IMPL: return PLP_IMPL;
+        case PLP_IMPL: return PHP_IMPL;
+#ifdef CPU_CMOS
+        case PHX_IMPL: return PLX_IMPL;
+        case PLX_IMPL: return PHX_IMPL;
+        case PHY_IMPL: return PLY_IMPL;
+        case PLY_IMPL: return PHY_IMPL;
+#endif
+        default:       return 0;
+    }
+}
+
+//write one instruction at a with operands that let execution fall through to the next instruction
+static address emit(TMemory mem, address a, word opcode, uint32_t copy)
+{
+    const TOpcodeInfo* info = &opcodeTable[opcode];
+    address next = a + info->length;
+    address operand = 0;
+
+    switch (info->mode)
+    {
+        case MODE_IMMD: operand = 0x01; break;
+        case MODE_ZRP:
+        case MODE_ZRPX:
+        case MODE_ZRPY: operand = ZRP_DATA; break;
+        case MODE_XIND:
+        case MODE_INDY:
+        case MODE_ZIND: operand = ZRP_PTR; break;
+        case MODE_ABSX:
+        case MODE_ABSY: operand = DATA_START; break;
+        case MODE_REL:  operand = 0x00; break;                  //taken or not, continue with next instruction
+        case MODE_IND:
+        case MODE_AXIND:                                        //X is 0
+        {
+            address ptr = JMP_PTRS + 2 * copy;
+            memWrite(mem, next & 0xFF, ptr);
+            memWrite(mem, next >> 8, ptr + 1);
+            operand = ptr;
+            break;
+        }
+        case MODE_ABS:
+        {
+            if (opcode == JMP_ABS) operand = next;
+            else if (opcode == JSR_ABS) operand = SUB_START;
+            else operand = DATA_START;
+            break;
+        }
+        default: break;
+    }
+
+    if (opcode == BRK_IMPL) next++;                             //padding byte, skipped by the RTI
+
+    memWrite(mem, opcode, a);
+    if (info->length > 1) memWrite(mem, operand & 0xFF, a + 1);
+    if (info->length > 2) memWrite(mem, operand >> 8, a + 2);
+
+    return next;
+}
+
+//build loop for opcode, together with its partner if it needs one
+static void build(T6502 cpu, word opcode)
+{
+    TMemory mem = cpu->mem;
+    word partner = partnerOf(opcode);
+    word first = opcode;
+    word second = partner;
+
+    memReset(mem);
+    cpuReset(cpu);
+
+    //pairs always run in program order: push before pull, JSR before RTS (which is the subroutine)
+    if (opcode == PLA_IMPL || opcode == PLP_IMPL || partnerOf(opcode) == PHX_IMPL || partnerOf(opcode) == PHY_IMPL)
+    {
+        first = partner;
+        second = opcode;
+    }
+    if (opcode == JSR_ABS || opcode == RTS_IMPL)
+    {
+        first = JSR_ABS;
+        second = 0;
+        memWrite(mem, RTS_IMPL, SUB_START);
+    }
+    if (opcode == BRK_IMPL || opcode == RTI_IMPL)
+    {
+        first = BRK_IMPL;
+        second = 0;
+        memWrite(mem, RTI_IMPL, IRQ_START);
+        memWrite(mem, IRQ_START & 0xFF, VECTOR_IRQ);
+        memWrite(mem, IRQ_START >> 8, VECTOR_IRQ + 1);
+    }
+
+    address a = CODE_START;
+    for (uint32_t i = 0; i < LOOP_COPIES; i++)
+    {
+        a = emit(mem, a, first, i);
+        if (second) a = emit(mem, a, second, i);
+    }
+    memWrite(mem, JMP_ABS, a);
+    memWrite(mem, CODE_START & 0xFF, a + 1);
+    memWrite(mem, CODE_START >> 8, a + 2);
+
+    memWrite(mem, DATA_START & 0xFF, ZRP_PTR);
+    memWrite(mem, DATA_START >> 8, ZRP_PTR + 1);
+
+    cpu->PC = CODE_START;
+}
+
+static TResult measure(T6502 cpu, word opcode, uint64_t budget, int repeats, int perf)
+{
+    TResult res;
+    TPerfSample sample = { { 0 } };
+    memset(&res, 0, sizeof(res));
+
+    for (int r = 0; r < repeats; r++)
+    {
+        build(cpu, opcode);
+
+        if (perf) perfBegin();
+        double t0 = now();
+        eCpuStepStatus s = cpuRun(cpu, budget);
+        double t = now() - t0;
+        if (perf) perfEnd(&sample);
+
+        if (s != CPU_STEP_OK) return res;
+
+        double ns = t * 1e9 / cpu->instructions;
+        if (!res.supported || ns < res.ns)
+        {
+            res.ns = ns;
+            res.instructions = cpu->instructions;
+            res.host = sample;
+        }
+        res.supported = 1;
+    }
+    return res;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t budget = DEFAULT_BUDGET;
+    int repeats = DEFAULT_REPEATS;
+    int json = 0;
+    int perf = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:r:jp")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c': budget = strtoull(optarg, NULL, 0); break;
+            case 'r': repeats = atoi(optarg); break;
+            case 'j': json = 1; break;
+            case 'p': perf = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-c cycles per opcode] [-r repeats] [-j] [-p]\n", argv[0]);
+                return -1;
+        }
+    }
+    if (repeats < 1) repeats = 1;
+
+    if (perf && perfOpen() == 0)
+    {
+        fprintf(stderr, "Warning: perf events not available, host counters are reported as null\n");
+    }
+
+    //library messages would end up between the results, e.g. in the JSON
+    logSetHandler(NULL, NULL);
+
+    T6502 cpu = cpuInit(memInit());
+    static TResult results[256];
+    double mode_ns[MODE_COUNT] = { 0 };
+    int mode_count[MODE_COUNT] = { 0 };
+    TPerfSample mode_host[MODE_COUNT];      //sum of host counters per emulated instruction, scaled by 1000
+    for (int m = 0; m < MODE_COUNT; m++)
+    {
+        memset(&mode_host[m], 0, sizeof(TPerfSample));
+        for (int i = 0; i < PERF_COUNT; i++) mode_host[m].valid[i] = 1;
+    }
+
+    for (uint32_t op = 0; op < 256; op++)
+    {
+        if (opcodeTable[op].mnemonic == NULL) continue;
+        results[op] = measure(cpu, op, budget, repeats, perf);
+
+        if (results[op].supported)
+        {
+            eAddrMode m = opcodeTable[op].mode;
+            mode_ns[m] += results[op].ns;
+            mode_count[m]++;
+
+            //every opcode weighs the same in its group, like for the ns average
+            TPerfSample per;
+            for (int i = 0; i < PERF_COUNT; i++)
+            {
+                per.valid[i] = results[op].host.valid[i];
+                per.value[i] = results[op].host.value[i] * 1000 / results[op].instructions;
+            }
+            perfAccumulate(&mode_host[m], &per);
+        }
+    }
+
+    if (json)
+    {
+        int first = 1;
+        printf("{\n  \"engine\": \"%s\",\n  \"variant\": \"%s\",\n  \"budget_cycles\": %llu,\n  \"opcodes\": [", CPU_ENGINE, CPU_VARIANT, (unsigned long long)budget);
+        for (uint32_t op = 0; op < 256; op++)
+        {
+            const TOpcodeInfo* info = &opcodeTable[op];
+            if (info->mnemonic == NULL) continue;
+
+            printf("%s\n    { \"opcode\": \"0x%.2X\", \"mnemonic\": \"%s\", \"mode\": \"%s\", \"paired\": %s, ",
+                   first ? "" : ",", op, info->mnemonic, addrModeNames[info->mode], partnerOf(op) ? "true" : "false");
+            if (results[op].supported) printf("\"ns_per_instruction\": %.3f", results[op].ns);
+            else printf("\"ns_per_instruction\": null");
+            if (perf && results[op].supported)
+            {
+                printf(", \"host_per_instruction\": ");
+                perfWriteJson(stdout, &results[op].host, results[op].instructions);
+            }
+            printf(" }");
+            first = 0;
+        }
+        printf("\n  ]\n}\n");
+    }
+    else
+    {
+        //16x16 matrix, row = hi nibble, column = lo nibble of the opcode; '-' undocumented, '?' not supported
+        printf("\nHost ns per emulated instruction (row: hi nibble, column: lo nibble)\n\n    ");
+        for (int c = 0; c < 16; c++) printf("  x%X  ", c);
+        printf("\n");
+        for (int r = 0; r < 16; r++)
+        {
+            printf("%Xx  ", r);
+            for (int c = 0; c < 16; c++)
+            {
+                word op = (r << 4) | c;
+                if (opcodeTable[op].mnemonic == NULL) printf("   -  ");
+                else if (!results[op].supported) printf("   ?  ");
+                else printf("%5.1f ", results[op].ns);
+            }
+            printf("\n");
+        }
+
+        printf("\nAverage per addressing mode%s:\n", perf ? " (host counters per emulated instruction)" : "");
+        for (int m = 0; m < MODE_COUNT; m++)
+        {
+            if (!mode_count[m]) continue;
+            printf("  %-5s %6.2f ns", addrModeNames[m], mode_ns[m] / mode_count[m]);
+
+            for (int i = 0; perf && i < PERF_COUNT; i++)
+            {
+                if (mode_host[m].valid[i]) printf("  %s %.2f", perfCounterNames[i], mode_host[m].value[i] / 1000.0 / mode_count[m]);
+                else printf("  %s n/a", perfCounterNames[i]);
+            }
+            printf("\n");
+        }
+
+        printf("\nJSR/RTS, BRK/RTI, PHA/PLA and PHP/PLP are timed as pairs (%s).\n", CPU_VARIANT);
+    }
+
+    if (perf) perfClose();
+    free(cpu->mem);
+    free(cpu);
+    return 0;
+}
@@ -4,43 +4,175 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include "6502.h"
 #include "mem.h"
 #include "utils.h"
-//#include "test.h"
-
+#include "coverage.h"
+#include "opcodes.h"
+#include "profile.h"
+#include "flight.h"
+#include "hooks.h"
+#include "hle.h"
+#ifdef ENABLE_BIN_TRACE
+    #include "trace.h"
+#endif
 
-#define PREPTEST(opcode)    //expand to nothing
-#define TEST(opcode)    //expand to nothing
 
-#define ENABLE_DBG_TRACE //dbg: print executed opcodes
+#ifndef DISABLE_DBG_TRACE
+    #define ENABLE_DBG_TRACE //dbg: print executed opcodes, build with -DDISABLE_DBG_TRACE to silence it
+#endif
 
 #ifdef ENABLE_DBG_TRACE
-    #define DBG_TRACE(opcode) printExecInfo(TAX_IMPL);
+    #define DBG_TRACE(opcode) printExecInfo(cpu, opcode);
 #else
     #define DBG_TRACE(opcode) //expand to nothing
 #endif
 
+#ifdef ENABLE_COVERAGE
+    #define COV_TRACE(cpu) covTrace(cpu->PC, memPeek(cpu->mem, cpu->PC)); //fuzzing: record PC edge and opcode
+#else
+    #define COV_TRACE(cpu) //expand to nothing
+#endif
+
+#ifdef ENABLE_PROFILER
+    #define PROF_ENTER(cpu) address prof_pc = cpu->PC; uint64_t prof_cycles = cpu->cycles; //profiling: remember where the instruction starts
+    #define PROF_LEAVE(cpu) if (profEnabled) profRecord(prof_pc, cpu->IR, cpu->PC, cpu->cycles - prof_cycles);
+    #define PROF_INTERRUPT(cpu, cycles) if (profEnabled) { profCall(cpu->PC); *profFrameCycles += cycles; } //frame of the handler at PC, its RTI returns from it
+#else
+    #define PROF_ENTER(cpu) //expand to nothing
+    #define PROF_LEAVE(cpu) //expand to nothing
+    #define PROF_INTERRUPT(cpu, cycles) //expand to nothing
+#endif
+
+#ifndef DISABLE_FLIGHT_RECORDER
+    #define FLIGHT_RECORD(cpu) flightRecord(cpu); //crash dumps: always remember the last instructions
+#else
+    #define FLIGHT_RECORD(cpu) //expand to nothing
+#endif
+
+#ifdef ENABLE_BIN_TRACE
+    #define BIN_TRACE(cpu) if (traceRing) traceRecord(cpu->mem, cpu->PC, cpu->A, cpu->X, cpu->Y, cpu->P, cpu->SP & 0xFF, cpu->cycles); //tracing: capture state before execution
+#else
+    #define BIN_TRACE(cpu) //expand to nothing
+#endif
+
 
 #define START_ADDRESS 0x0000    //start address of the programm (PC init)
 #define STACK_MIN 0x01FF        //stack grows downwards starting at this address
 #define STACK_MAX 0x0100        //end of stack range, next lower address results in stack overflow
 
 
-//allocate cpu struct and store cpu and memory to global variables 
+#ifdef CPU_HAS_BCD
+//Decimal mode results of ADC and SBC for every carry, A and operand: the result in the lo byte, N V Z C in
+//the hi byte at their positions in P. With the tables the decimal path of an ALU handler is a lookup; the
+//2A03 build has neither tables nor decimal path.
+static uint16_t bcdAdc[2][256][256];
+static uint16_t bcdSbc[2][256][256];
+static pthread_once_t bcdOnce = PTHREAD_ONCE_INIT;    //CPUs may be created on several threads at once
+
+static uint16_t bcdEntry(int result, int n, int v, int z, int c)
+{
+    return (result & 0xFF) | ((n ? 0x80 : 0) | (v ? 0x40 : 0) | (z ? 0x02 : 0) | (c ? 0x01 : 0)) << 8;
+}
+
+//see 6502.org "Decimal Mode" by Bruce Clark, appendix A: the NMOS parts take N and V from the intermediate
+//result and Z from the binary sum (SBC: all flags binary), the 65C02 takes N and Z from the decimal result
+static void initBcd(void)
+{
+    for (int c = 0; c < 2; c++)
+    for (int a = 0; a < 256; a++)
+    for (int b = 0; b < 256; b++)
+    {
+        //ADC
+        int lo = (a & 0x0F) + (b & 0x0F) + c;
+        if (lo >= 0x0A) lo = ((lo + 0x06) & 0x0F) + 0x10;
+        int r = (a & 0xF0) + (b & 0xF0) + lo;
+        int sr = (int)(sword)(a & 0xF0) + (int)(sword)(b & 0xF0) + lo;     //signed intermediate, gives N and V
+        int v = (sr < -128) || (sr > 127);
+#ifndef CPU_CMOS
+        int n = (r & 0x80) != 0;    //NMOS: N before the hi nibble is adjusted
+#endif
+        if (r >= 0xA0) r += 0x60;
+#ifdef CPU_CMOS
+        bcdAdc[c][a][b] = bcdEntry(r, r & 0x80, v, (r & 0xFF) == 0, r >= 0x100);
+#else
+        bcdAdc[c][a][b] = bcdEntry(r, n, v, ((a + b + c) & 0xFF) == 0, r >= 0x100);
+#endif
+
+        //SBC, carry and overflow are those of the binary subtraction
+        int bin = a - b - 1 + c;
+        int bv = ((a ^ bin) & 0x80) && ((a ^ b) & 0x80);
+        lo = (a & 0x0F) - (b & 0x0F) + c - 1;
+#ifdef CPU_CMOS
+        r = bin;
+        if (r < 0) r -= 0x60;
+        if (lo < 0) r -= 0x06;
+        bcdSbc[c][a][b] = bcdEntry(r, r & 0x80, bv, (r & 0xFF) == 0, bin >= 0);
+#else
+        if (lo < 0) lo = ((lo - 0x06) & 0x0F) - 0x10;
+        r = (a & 0xF0) - (b & 0xF0) + lo;
+        if (r < 0) r -= 0x60;
+        bcdSbc[c][a][b] = bcdEntry(r, bin & 0x80, bv, (bin & 0xFF) == 0, bin >= 0);
+#endif
+    }
+}
+
+//decimal mode: A and N V Z C from the table
+static inline void aluDecimal(T6502 cpu, const uint16_t table[2][256][256], word operand)
+{
+    uint16_t r = table[cpu->P & 0x01][cpu->A][operand];
+    cpu->A = r & 0xFF;
+    cpu->P = (cpu->P & ~0xC3) | (r >> 8);
+#ifdef CPU_CMOS
+    cpu->cycles++;              //the 65C02 fixes up the flags in an extra cycle
+#endif
+}
+#endif
+
+//allocate cpu struct, connect memory and reset registers
 T6502 cpuInit(TMemory mem) {
 
     T6502 cpu = (T6502)malloc(sizeof(CpuStruct));
+#ifdef CPU_HAS_BCD
+    pthread_once(&bcdOnce, initBcd);
+#endif
+    cpu->mem = mem;
+    memSetClock(mem, &cpu->cycles); //devices catch up to the CPU's cycle counter
+    cpu->break_fn = NULL;
+    cpu->break_ctx = NULL;
+    cpu->breakpoint_count = 0;
+    cpu->hooks = NULL;
+    cpu->hle = NULL;
+    cpu->stop_on_brk = 0;
+    cpu->halt_check = 0;
+    memset(cpu->breakpoints, 0, sizeof(cpu->breakpoints));
+    cpuReset(cpu);
+
+    return cpu;
+}
+
+//set all registers to their power-up values, memory is left untouched
+void cpuReset(T6502 cpu)
+{
     cpu->X = 0;
     cpu->Y = 0;
     cpu->A = 0;
-    cpu->P = 0x30; //00110000 = (N V - B D I Z C) // - always 1, B is 1 too because NES does not use decimal mode D at all
+    cpu->P = 0x34; //00110100 = (N V - B D I Z C) // - always 1, B is 1 too because NES does not use decimal mode D at all, interrupts masked
     cpu->IR = 0;
     cpu->SP = STACK_MIN;
-    cpu->PC = START_ADDRESS;
-    cpu->mem = mem;
-
-    return cpu;
+    cpu->PC = lohi2addr(memPeek(cpu->mem, VECTOR_RESET), memPeek(cpu->mem, VECTOR_RESET + 1)); //no device side effects, START_ADDRESS as long as the vector is not set
+    cpu->cycles = 0;
+    cpu->instructions = 0;
+    cpu->slice_end = 0;
+    cpu->irq = 0;
+    cpu->nmi = 0;
+    cpu->nmi_pending = 0;
+    cpu->stop = CPU_STOP_NONE;
+    cpu->stack_dumped = 0;
+    if (cpu->hle != NULL) hleReset(cpu->hle);  //memory may have changed without writes
+    schedReset(&cpu->sched);    //cycles start over, devices schedule their events again
 }
 
 
@@ -110,7 +242,7 @@ void setZByWord(T6502 cpu, word w)
 //set Z in P = (N V - B D I Z C)
 void setZByFlag(T6502 cpu, uint8_t flag)
 {
-    if (flag >= 0) cpu->P = cpu->P | 0b00000010;  //set Z to 1
+    if (flag >= 1) cpu->P = cpu->P | 0b00000010;  //set Z to 1
     else cpu->P = cpu->P & 0b11111101;            //set Z to 0
 }
 
@@ -265,20 +397,37 @@ word getAbsOp(T6502 cpu)
     return operand;
 }
 
+//reading across a page boundary costs one extra cycle
 word getAbsXOp(T6502 cpu)
 {
     address a = getAbsXAddr(cpu);          //get absolute address + X, i.e. (PC+1 concat PC+2) + X
+    if ((a & 0xFF) < cpu->X) cpu->cycles++; //lo byte wrapped => page crossed
     word operand = memRead(cpu->mem, a);              //get operand
     return operand;
 }
 
+//reading across a page boundary costs one extra cycle
 word getAbsYOp(T6502 cpu)
 {
     address a = getAbsYAddr(cpu);          //get absolute address + Y, i.e. (PC+1 concat PC+2) + Y
+    if ((a & 0xFF) < cpu->Y) cpu->cycles++; //lo byte wrapped => page crossed
     word operand = memRead(cpu->mem, a);              //get operand
     return operand;
 }
 
+//JMP only: the pointer's hi byte is fetched without carry into the hi byte of the pointer,
+//i.e. JMP ($10FF) reads $10FF and $1000, just like the NMOS 6502 does; the 65C02 reads $10FF and $1100
+address getIndAddr(T6502 cpu)
+{
+    address ptr = getAbsAddr(cpu);                                  //get pointer to the jump address
+#ifdef CPU_CMOS
+    address ptr_hi = ptr + 1;
+#else
+    address ptr_hi = (ptr & 0xFF00) | ((ptr + 1) & 0x00FF);         //hi byte of jump address, stays within the page
+#endif
+    return lohi2addr(memRead(cpu->mem, ptr), memRead(cpu->mem, ptr_hi));
+}
+
 sword getRelOp(T6502 cpu)
 {
     word operand = memRead(cpu->mem, cpu->PC+1);
@@ -289,7 +438,7 @@ sword getRelOp(T6502 cpu)
 //A1 is an 8bit zeropage address located at mem[PC+1].
 //A2 = A1+X is a zeropage address that contains the lo-byte of the 16bit target address (location of operand to be fetched).
 //Note: A2 must remain within zeropage (A2 &= 0xFF).
-word getXIndOp(T6502 cpu)
+address getXIndAddr(T6502 cpu)
 {
     word zrp_addr = memRead(cpu->mem, cpu->PC+1);                              //get base address from zeropage   
     word zrp_addrx = (zrp_addr + cpu->X) & 0xFF;                 //add X offset and wrap to zeropage    
@@ -297,41 +446,112 @@ word getXIndOp(T6502 cpu)
     word operand_ptr_hi = zrp_addrx + 1;                    //get hi part of the operand address address
     word operand_addr_lo = memRead(cpu->mem, operand_ptr_lo);             //get lo part of the operand address
     word operand_addr_hi = memRead(cpu->mem, operand_ptr_hi);             //get hi part of the operand address 
-    address a = lohi2addr(operand_addr_lo, operand_addr_hi);//convert lo byte and hi byte to a 16bit address
+    return lohi2addr(operand_addr_lo, operand_addr_hi);     //convert lo byte and hi byte to a 16bit address
+}
+
+word getXIndOp(T6502 cpu)
+{
+    address a = getXIndAddr(cpu);                           //get X indexed indirect address
     word operand = memRead(cpu->mem, a);                                  //finally, get operand value
     return operand;
 }
 
 //Indirection first, then indexing:
-//A1 is a 16bit address, whose lo-byte is located at mem[PC+1].
+//A1 is a 16bit address, whose lo-byte is located at zeropage address mem[PC+1] and whose hi-byte follows it (wrapping within zeropage).
 //A2 = A1+Y is the 16bit address that contains the operand to be fetched (=pointer).
-address getIndYOp(T6502 cpu)
+address getIndYAddr(T6502 cpu)
 {
     word zrp_addr = memRead(cpu->mem, cpu->PC+1);                              //get address, it's an 8bit zero page address   
-    word operand_addr_lo = zrp_addr;                        //get lo part of the operand address
-    word operand_addr_hi = zrp_addr + 1;                    //get hi part of the operand address
+    word operand_addr_lo = memRead(cpu->mem, zrp_addr);                   //get lo part of the operand address
+    word operand_addr_hi = memRead(cpu->mem, (word)(zrp_addr + 1));       //get hi part of the operand address
     address a = lohi2addr(operand_addr_lo, operand_addr_hi);//convert lo byte and hi byte to a 16bit address
-    a = a + cpu->Y;                                              //add Y offset to calculated address
+    return a + cpu->Y;                                           //add Y offset to calculated address
+}
+
+//reading across a page boundary costs one extra cycle
+word getIndYOp(T6502 cpu)
+{
+    address a = getIndYAddr(cpu);                           //get indirect Y indexed address
+    if ((a & 0xFF) < cpu->Y) cpu->cycles++;                 //lo byte wrapped => page crossed
     word operand = memRead(cpu->mem, a);                                  //finally, get operand
     return operand;
 }
 
-//just in case, print a brief warning that opcode <opcode_name> at address <opcode_address> caused a stack overflow
-void warnStackOverflow(T6502 cpu, const char* opcode_name, address opcode_address)
+#ifdef CPU_CMOS
+//65C02 (zp): the 16bit address at zeropage mem[PC+1] (hi byte wrapping within zeropage), (zp),Y without Y
+address getZIndAddr(T6502 cpu)
+{
+    word zrp_addr = memRead(cpu->mem, cpu->PC+1);
+    return lohi2addr(memRead(cpu->mem, zrp_addr), memRead(cpu->mem, (word)(zrp_addr + 1)));
+}
+
+word getZIndOp(T6502 cpu)
+{
+    return memRead(cpu->mem, getZIndAddr(cpu));
+}
+
+//65C02 JMP ($xxxx,X): jump address is at the absolute address + X
+address getAXIndAddr(T6502 cpu)
+{
+    address ptr = getAbsAddr(cpu) + cpu->X;
+    return lohi2addr(memRead(cpu->mem, ptr), memRead(cpu->mem, (address)(ptr + 1)));
+}
+#endif
+
+//the stack wrapped around within page 1: defined behaviour, but most likely a bug in the program, so warn
+//and write a crash dump (the first one after a reset only)
+static __attribute__((noinline, cold)) void warnStack(T6502 cpu, const char* what)
+{
+    const char* name = opcodeTable[cpu->IR].mnemonic;
+    logMessage("WARNING: %s instruction resulted in %s.\nStack pointer is now at: 0x%.4X.\n\n", name ? name : "???", what, cpu->SP);
+
+    if (!cpu->stack_dumped)
+    {
+        cpu->stack_dumped = 1;
+        flightDump(cpu, what);
+    }
+}
+
+//push value to mem[SP], SP wraps within page 1 like the 8-bit register of the real CPU
+static inline void push(T6502 cpu, word value)
+{
+    memWrite(cpu->mem, value, cpu->SP);
+    cpu->SP = 0x0100 | ((cpu->SP - 1) & 0xFF);
+    if (cpu->SP == STACK_MIN) warnStack(cpu, "stack overflow");
+}
+
+//pull the value on top of the stack, i.e. mem[SP+1], SP wraps within page 1
+static inline word pull(T6502 cpu)
+{
+    cpu->SP = 0x0100 | ((cpu->SP + 1) & 0xFF);
+    if (cpu->SP == STACK_MAX) warnStack(cpu, "stack underflow");
+    return memRead(cpu->mem, cpu->SP);
+}
+
+//push PC and the given P, set I and load PC from vector, shared by BRK and hardware interrupts
+static void interrupt(T6502 cpu, address vector, word p)
 {
-    if (cpu->SP < STACK_MAX) 
-        printf("WARNING: %s instruction at 0x%.4X resulted in stack overflow.\nStack pointer is now at: 0x%.4X.\n\n", opcode_name, opcode_address, cpu->SP);
+    push(cpu, (cpu->PC & 0xFF00) >> 8);     //push PC-HI
+    push(cpu, cpu->PC & 0x00FF);            //push PC-LO
+    push(cpu, p);                           //push P
+
+    setIByFlag(cpu, 1);
+#ifdef CPU_CMOS
+    setDByFlag(cpu, 0);         //the 65C02 enters handlers in binary mode
+#endif
+    cpu->PC = lohi2addr(memRead(cpu->mem, vector), memRead(cpu->mem, vector + 1));
 }
 
-//just in case, print a brief warning that opcode <opcode_name> at address <opcode_address> caused a stack underflow
-void warnStackUnderflow(T6502 cpu, const char* opcode_name, address opcode_address)
+//I got cleared: if IRQ is asserted, end the slice so cpuRun takes it
+static inline void irqUnmasked(T6502 cpu)
 {
-    if (cpu->SP > STACK_MIN)    
-        printf("WARNING: %s instruction at 0x%.4X resulted in stack underflow.\nStack pointer is now at: 0x%.4X.\n\n", opcode_name, opcode_address, cpu->SP);
+    if (cpu->irq && !getI(cpu)) cpu->slice_end = cpu->cycles;
 }
 
 // ################################ begin opcode implementation ################################
 
+//############################# TRANSFER INSTRUCTIONS #############################
+
 //X <- A
 //affects N and Z
 void tax(T6502 cpu) //OK
@@ -343,2194 +563,2505 @@ void tax(T6502 cpu) //OK
     setZByWord(cpu, cpu->X); 
 }
 
+//A <- X
+//affects N and Z
+void txa(T6502 cpu)
+{
+    cpu->A = cpu->X;    
+    
+    //set flags
+    setNByWord(cpu, cpu->A); 
+    setZByWord(cpu, cpu->A); 
+}
 
-// ################################# end opcode implementation #################################
+//Y <- A
+//affects N and Z
+void tay(T6502 cpu)
+{
+    cpu->Y = cpu->A;       
+    
+    //set flags
+    setNByWord(cpu, cpu->Y); 
+    setZByWord(cpu, cpu->Y);
+}
 
+//A <- Y
+//affects N and Z
+void tya(T6502 cpu)
+{
+    cpu->A = cpu->Y;      
 
-//here we go: fetch, decode, execute
-eCpuStepStatus cpuStep(T6502 cpu)
+    //set flags
+    setNByWord(cpu, cpu->A); 
+    setZByWord(cpu, cpu->A);    
+}
+
+//X <- SP
+//affects N and Z
+void tsx(T6502 cpu)
+{    
+    cpu->X = cpu->SP & 0xFF;    //only the lo byte, the hi byte of the stack is hard wired to page 1
+                
+    //set flags
+    setNByWord(cpu, cpu->X); 
+    setZByWord(cpu, cpu->X);    
+}
+
+//SP <- X
+//no flags
+void txs(T6502 cpu)
 {
-    if (cpu == NULL)
-    {
-        printf("\nError: CPU was not inited");
-        return CPU_STEP_ERROR;
-    }
+    cpu->SP = 0x0100 | cpu->X;  //stack is hard wired to page 1
+}
 
-    //fetch 
-    cpu->IR = memRead(cpu->mem, cpu->PC);
-    
-    //decode, then execute
-    switch(cpu->IR)
-    {
-        //############################# TRANSFER INSTRUCTIONS #############################
-        case TAX_IMPL:  //X <- A, 1 byte long
-        {
-            DBG_TRACE(TAX_IMPL);
-            cpu->PC++;                           //target next opcode
-            tax(cpu);                          //execute opcode      
-                    
-            return CPU_STEP_OK;
-        }
+//############################# STORAGE INSTRUCTIONS #############################
 
-        default: //invalid instruction
-        { 
-            printf("\nError: unknown instruction: 0x%X at 0x%.4X.\n", cpu->IR, cpu->PC);
-            return CPU_STEP_ERROR;
-        }            
-        
-	} //switch IR
-    
+//A <- M
+//affects N and Z
+void lda(T6502 cpu, word operand)
+{      
+    cpu->A = operand; 
+                
+    //set flags
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A);    
 }
+
+//X <- M
+//affects N and Z
+void ldx(T6502 cpu, word operand)
+{
+    cpu->X = operand;
     
-#ifdef OMITFORNOW
+    //set flags
+    setNByWord(cpu, cpu->X);
+    setZByWord(cpu, cpu->X);    
+}
 
-//load given 6502 binary and emulate it
-int main(int argc, char *argv[])
-{	
+//Y <- M
+//affects N and Z
+void ldy(T6502 cpu, word operand)
+{
+    cpu->Y = operand;
     
-    //exit if path to binary was not given
-    if (argc < 2) 
+    //set flags
+    setNByWord(cpu, cpu->Y);
+    setZByWord(cpu, cpu->Y);    
+}
+
+//A -> M
+//no flags
+void sta(T6502 cpu, address a)
+{      
+    memWrite(cpu->mem, cpu->A, a); //write contents of A to address a   
+}
+
+//X -> M
+//no flags
+void stx(T6502 cpu, address a)
+{      
+    memWrite(cpu->mem, cpu->X, a); //write contents of X to address a    
+}
+
+//Y -> M
+//no flags
+void sty(T6502 cpu, address a)
+{      
+    memWrite(cpu->mem, cpu->Y, a); //write contents of Y to address a    
+}
+
+//############################# ARITHMETIC INSTRUCTIONS #############################
+
+//A <- A + M + C
+//affects N, V, Z and C 
+//note: decimal mode only exists in builds of variants that have it (see variant.h), NES' 2A03 lacks BCD mode
+void adc(T6502 cpu, word operand)
+{
+#ifdef CPU_HAS_BCD
+    if (cpu->P & 0x08)
     {
-        printf("Input error: one argument expected: path to 6502-binary \n");
-        return -1;
+        aluDecimal(cpu, bcdAdc, operand);
+        return;
     }
+#endif
+    word Ainit = cpu->A;                         //get initial value of A since we need it to do some checks with it later
     
-    //load binary into emu-RAM
-    //int load_status = load(argv[1]);
+    dword A16 = Ainit + operand + getC(cpu);     //store result in 16 bit int to check whether it is greater than 8 bit
+    cpu->A = A16 & 0x00FF;                       //copy result without cary (if exists) to A
     
-    //exit if loading failed
-    //if (load_status != 0) return -1;
+    setNByWord(cpu, cpu->A);
     
-    //init registers
-    //reset();
-	
-    //initially, processor is running
-	int running = 1;
+    //if +a + +b got -c or -a + -b got +c then we have an overflow here (result didn't fit into 8 bit and wrapped over)
+    setVByFlag(cpu, (isN(operand) == isN(Ainit)) && (isN(operand) != isN(cpu->A)));
     
-	//here we go: fetch, decode, execute
-	while(running)
-	{
-        //fetch 
-		cpu->IR = memRead(mem, cpu->PC);
-        
-        //decode, then execute
-		switch(cpu->IR)
-		{
-            //############################# TRANSFER INSTRUCTIONS #############################
-			case TAX_IMPL:  //X <- A, 1 byte long
-            {
-                PREPTEST(TAX_IMPL);
-            
-                cpu->PC++;                           //target next opcode
-                tax();                          //execute opcode      
-                        
-                TEST(TAX_IMPL);            
-                break;
-            }
-            
-            case TXA_IMPL:  //A <- X, 1 byte long
-            {
-                PREPTEST(TXA_IMPL);
-            
-                cpu->PC++;                           //target next opcode
-                txa();                          //execute opcode      
-            
-                TEST(TXA_IMPL);
-                break;  
-            }
-            
-            case TAY_IMPL:  //Y <- A, 1 byte long
-            {
-                PREPTEST(TAY_IMPL);
-            
-                cpu->PC++;                           //target next opcode
-                tay();                          //execute opcode
-            
-                TEST(TAY_IMPL);
-                break;  
-            }
-            
-            case TYA_IMPL:  //A <- Y, 1 byte long
-            {
-                PREPTEST(TYA_IMPL);
-            
-                cpu->PC++;                           //target next opcode
-                tya();                          //execute opcode      
-            
-                TEST(TYA_IMPL);            
-                break;  
-            }
-                
-            case TSX_IMPL:  //X <- SP, 1 byte long
-            {
-                PREPTEST(TSX_IMPL);
-            
-                cpu->PC++;                           //target next opcode
-                tsx();                          //execute opcode      
-            
-                TEST(TSX_IMPL);
-                break;  
-            }
-             
-            case TXS_IMPL:  //SP <- X, 1 byte long
-            {
-                PREPTEST(TXS_IMPL);
-            
-                cpu->PC++;                           //target next opcode
-                txs();                          //execute opcode      
-            
-                TEST(TXS_IMPL);            
-                break;  
-            }   
-            
-            //############################# STORAGE INSTRUCTIONS #############################
-            //************ LDA: A <- M *************
-            case LDA_IMMD: //A <- M, 2 bytes long
-            {
-                PREPTEST(LDA_IMMD);
-            
-                word operand = getImdOp();      //target operand
-                cpu->PC += 2;                        //target next opcode 
-                lda(operand);                   //execute opcode
-            
-                TEST(LDA_IMMD);
-                break;  
-            }                
-            case LDA_ZRP: //A <- M from zeropage, 2 bytes long
-            {
-                PREPTEST(LDA_ZRP);
-            
-                word operand = getZrpOp();      //get operand from zeropage
-                cpu->PC += 2;                        //target next opcode
-                lda(operand);                   //execute opcode
-            
-                TEST(LDA_ZRP);
-                break;  
-            }         
-            //TODO/TOCHECK/LATER
-            case LDA_ZRPX: //A <- M from zeropage+X, 2 bytes long
-            {
-                PREPTEST(LDA_ZRPX);
-            
-                word operand = getZrpXOp();     //get operand from zeropage 
-                cpu->PC += 2;                        //target next opcode
-                lda(operand);                   //execute opcode
-            
-                TEST(LDA_ZRPX);
-                break;  
-            }
-            case LDA_ABS: //A <- M from [PChi,PClo], 3 bytes long
-            {
-                PREPTEST(LDA_ABS);
-            
-                word operand = getAbsOp();      //get operand from absolute address  
-                cpu->PC += 3;                        //target next opcode
-                lda(operand);                   //execute opcode
-            
-                TEST(LDA_ABS);
-                break;                          
-            }
-            
-            case LDA_ABSX: //A <- M from [[PChi,PClo]+X], 3 bytes long
-            {
-                PREPTEST(LDA_ABSX);
-                
-                word operand = getAbsXOp();     //get operand from absolute address + X
-                cpu->PC += 3;                        //target next opcode
-                lda(operand);                   //execute opcode
-            
-                TEST(LDA_ABSX);
-                break;                          
-            }
-            //TODO/TOCHECK/LATER
-            case LDA_ABSY: //A <- M from [[PChi,PClo]+Y], 3 bytes long
-            {
-                PREPTEST(LDA_ABSY);
-            
-                word operand = getAbsYOp();     //get operand from absolute address + Y
-                cpu->PC += 3;                        //target next opcode
-                lda(operand);                   //execute opcode
-            
-                TEST(LDA_ABSY);
-                break;                          
-            }
-            //TODO/TOCHECK/LATER
-            case LDA_XIND: //A <- M [TODO], 2 bytes long
-            {
-                PREPTEST(LDA_XIND);
+    setZByWord(cpu, cpu->A); 
+    
+    //result > 255 => 8 bits were not sufficient => need 9th bit = carry, otherwise clear carry, which might be set (and used) before
+    setCByFlag(cpu, A16 > 0xFF); 
+}
 
-                word operand = getXIndOp();     //get X indexed indirect operand
-                cpu->PC += 2;                        //target next opcode
-                lda(operand);                   //execute opcode
+//SBC: Subtract Memory from Accumulator with Borrow: A - M - !C -> A
+//affects N, V, Z and C 
+//note: in binary mode A - M - !C == A + ~M + C, so the flags are exactly those of ADC with the inverted operand
+void sbc(T6502 cpu, word operand)
+{
+#ifdef CPU_HAS_BCD
+    if (cpu->P & 0x08)
+    {
+        aluDecimal(cpu, bcdSbc, operand);
+        return;
+    }
+#endif
+    adc(cpu, ~operand);
+}
 
-                TEST(LDA_XIND);
-                break;
-            }
-            //TODO/TOCHECK/LATER
-            case LDA_INDY: //A <- M [TODO], 2 bytes long
-            {
-                word operand = getIndYOp();
-                cpu->PC += 2;
-                lda(operand);
-                break;
-            }
-            
-            //************ LDA: X <- M *************
-            case LDX_IMMD: //X <- M, e.g. LDX #$FF ; load X with $FF, 2 bytes long
-            {
-                PREPTEST(LDX_IMMD);
-            
-                word operand = getImdOp();      //target operand 
-                cpu->PC += 2;                        //target next opcode
-                ldx(operand); 
-            
-                TEST(LDX_IMMD);
-                break;  
-            }
-                
-            case LDX_ZRP: //X <- M from zeropage, 2 bytes long
-            {
-                PREPTEST(LDX_ZRP);
-            
-                word operand = getZrpOp();      //get operand from zeropage 
-                cpu->PC += 2;                        //target next opcode
-                ldx(operand);                   //execute opcode
-            
-                TEST(LDX_ZRP);
-                break;
-            }
-            
-                
-            case LDX_ZRPY: //X <- M from zeropage+Y, 2 bytes long
-            {
-                PREPTEST(LDX_ZRPY);
-            
-                word operand = getZrpYOp();     //get operand from zeropage 
-                cpu->PC += 2;                        //target next opcode
-                ldx(operand);                   //execute opcode
-            
-                TEST(LDX_ZRPY);
-                break; 
-            }
+//increment memory: M <- M + 1
+//affects N and Z
+void inc(T6502 cpu, address a)
+{
+    word w = memRead(cpu->mem, a);
+    memWrite(cpu->mem, ++w, a);
 
-            case LDX_ABS: //X <- M from [PChi,PClo], 3 bytes long
-            {
-                PREPTEST(LDX_ABS);
-            
-                word operand = getAbsOp();      //get operand from absolute address  
-                cpu->PC += 3;                        //target next opcode
-                ldx(operand);                   //execute opcode
-            
-                TEST(LDX_ABS);
-                break;         
-            }
-            
-            case LDX_ABSY: //X <- M from [[PChi,PClo]+Y], 3 bytes long
-            {
-                PREPTEST(LDX_ABSY);
-            
-                word operand = getAbsYOp();     //get operand from absolute address + Y
-                cpu->PC += 3;                        //target next opcode
-                ldx(operand);                   //execute opcode
-            
-                TEST(LDX_ABSY);
-                break; 
-            }
-             
-            //************ LDY: Y <- M *************
-            case LDY_IMMD: //X <- M, e.g. LDX #$FF ; load X with $FF, 2 bytes long
-            {
-                PREPTEST(LDY_IMMD);
-            
-                word operand = getImdOp();      //target operand 
-                cpu->PC += 2;                        //target next opcode
-                ldy(operand);                   //execute opcode
-            
-                TEST(LDY_IMMD);
-                break;  
-            }
+    setNByWord(cpu, w);
+    setZByWord(cpu, w);
+}
 
-            case LDY_ZRP: //X <- M from zeropage, 2 bytes long
-            {
-                PREPTEST(LDY_ZRP);
-            
-                word operand = getZrpOp();      //get operand from zeropage 
-                cpu->PC += 2;                        //target next opcode
-                ldy(operand);                   //execute opcode
-            
-                TEST(LDY_ZRP);
-                break;
-            }
-            
-            case LDY_ZRPX: //X <- M from zeropage+X, 2 bytes long
-            {
-                PREPTEST(LDY_ZRPX);
-            
-                word operand = getZrpXOp();     //get operand from zeropage 
-                cpu->PC += 2;                        //target next opcode
-                ldy(operand);                   //execute opcode
-            
-                TEST(LDY_ZRPX);
-                break; 
-            }
-            
-            case LDY_ABS: //X <- M from [PChi,PClo], 3 bytes long
-            {
-                PREPTEST(LDY_ABS);
-            
-                word operand = getAbsOp();      //get operand from absolute address  
-                cpu->PC += 3;                        //target next opcode
-                ldy(operand);                   //execute opcode
-            
-                TEST(LDY_ABS);
-                break;         
-            }
-            
-            case LDY_ABSX: //X <- M from [[PChi,PClo]+X], 3 bytes long
-            {
-                PREPTEST(LDY_ABSX);
-            
-                word operand = getAbsXOp();     //get operand from absolute address + X
-                cpu->PC += 3;                        //target next opcode
-                ldy(operand);                   //execute opcode
-            
-                TEST(LDY_ABSX);
-                break; 
-            }
-                
-                
-            //************ STA: A -> M *************
-            case STA_ZRP: //A -> M from zeropage, 2 bytes long
-            {               
-                PREPTEST(STA_ZRP);
-            
-                address a = getZrpAddr();       //get address from zeropage
-                cpu->PC += 2;                        //target next opcode
-                sta(a);                         //execute opcode
-            
-                TEST(STA_ZRP);
-                break;  
-            }    
-            
-            case STA_ZRPX: //A -> M from zeropage+X, 2 bytes long
-            {
-                PREPTEST(STA_ZRPX);
-            
-                address a = getZrpXAddr();      //get address from zeropage + X
-                cpu->PC += 2;                        //target next opcode
-                sta(a);                         //execute opcode
-            
-                TEST(STA_ZRPX);
-                break;  
-            }       
-
-            case STA_ABS: //A -> M from [PChi,PClo], 3 bytes long
-            {
-                PREPTEST(STA_ABS);
-            
-                address a = getAbsAddr();       //get absolute address
-                cpu->PC += 3;                        //target next opcode
-                sta(a);                         //execute opcode
-            
-                TEST(STA_ABS);
-                break;                          
-            }
-            
-            case STA_ABSX: //A -> M from [PChi,PClo] + X, 3 bytes long
-            {
-                PREPTEST(STA_ABSX);
-            
-                address a = getAbsXAddr();      //get absolute address + X
-                cpu->PC += 3;                        //target next opcode
-                sta(a);                         //execute opcode
-                
-                TEST(STA_ABSX);
-                break;                          
-            }
-            
-            case STA_ABSY: //A -> M from [PChi,PClo] + Y, 3 bytes long
-            {
-                PREPTEST(STA_ABSY);
-            
-                address a = getAbsYAddr();      //get absolute address + Y
-                cpu->PC += 3;                        //target next opcode
-                sta(a);                         //execute opcode
-            
-                TEST(STA_ABSY);
-                break;                          
-            }
-                
-            //TODO/TOCHECK/LATER 
-            /*
-            //STA ($20,X)	Stores the content of the Accumulator to the address obtained from the address calculated from "$20 adding content of Index Register X"
-            case LDA_XINDX_TEMPLATE: //A -> M [TODO], 2 bytes long
-            {
-                word operand = getXIndOp();
-                PC += 2;
-                lda(operand);
-                break;
-            }
-            case LDA_INDYX_TEMPLATE: //A <- M [TODO], 2 bytes long
-            {
-                word operand = getIndYOp();
-                PC += 2;
-                lda(operand);
-                break;
-            }
-            */  
-            
-                
-            //************ STX: X -> M *************
-            case STX_ZRP: //X -> M from zeropage, 2 bytes long
-            {               
-                PREPTEST(STX_ZRP);
-                
-                address a = getZrpAddr();       //get address from zeropage
-                cpu->PC += 2;                        //target next opcode
-                stx(a);                         //execute opcode
-                
-                TEST(STX_ZRP);
-                break;  
-            } 
-                
-            //************ STX: X -> M *************
-            case STX_ZRPY: //X -> M from zeropage+Y, 2 bytes long
-            {               
-                PREPTEST(STX_ZRPY);
-                
-                address a = getZrpYAddr();      //get address from zeropage + Y
-                cpu->PC += 2;                        //target next opcode
-                stx(a);                         //execute opcode
-                
-                TEST(STX_ZRPY);
-                break;  
-            }
-                                
-            case STX_ABS: //X -> M from [PChi,PClo], 3 bytes long
-            {
-                PREPTEST(STX_ABS);
-                
-                address a = getAbsAddr();       //get absolute address
-                cpu->PC += 3;                        //target next opcode
-                stx(a);                         //execute opcode
-                
-                TEST(STX_ABS);
-                break;                          
-            }
-                
-              
-            //************ STY: Y -> M *************                
-            case STY_ZRP: //Y -> M from zeropage, 2 bytes long
-            {               
-                PREPTEST(STY_ZRP);
-                
-                address a = getZrpAddr();       //get address from zeropage
-                cpu->PC += 2;                        //target next opcode
-                sty(a);                         //execute opcode
-                
-                TEST(STY_ZRP);
-                break;  
-            } 
-                
-            //************ STY: Y -> M *************
-            case STY_ZRPX: //Y -> M from zeropage+X, 2 bytes long
-            {               
-                PREPTEST(STY_ZRPX);
-                
-                address a = getZrpXAddr();      //get address from zeropage + X
-                cpu->PC += 2;                        //target next opcode
-                sty(a);                         //execute opcode
-                
-                TEST(STY_ZRPX);
-                break;  
-            }
-                
-                
-            case STY_ABS: //Y -> M from [PChi,PClo], 3 bytes long
-            {
-                PREPTEST(STY_ABS);
-                
-                address a = getAbsAddr();       //get absolute address
-                cpu->PC += 3;                        //target next opcode
-                sty(a);                         //execute opcode
-                
-                TEST(STY_ABS);
-                break;                          
-            }
+//increment X
+//affects N and Z
+void inx(T6502 cpu)
+{
+    cpu->X++;
+    
+    setNByWord(cpu, cpu->X);
+    setZByWord(cpu, cpu->X);        
+}
 
-            
-                
-                
-                
-            //############################# ARITHMETIC INSTRUCTIONS #############################
-            //ADC:  Add Memory to Accumulator with Carry: A <- A + M + C
-            case ADC_IMMD: //2 bytes long
-            {
-                word operand = getImdOp();      //target operand 
-                cpu->PC += 2;                        //target next opcode
-                adc(operand);                   //execute opcode
-                break;                   
-            }
-            case ADC_ZRP: //2 bytes long
-            {
-                word operand = getZrpOp();      //get operand from zeropage
-                cpu->PC += 2;                        //target next opcode
-                adc(operand);                   //execute opcode
-                break;                   
-            }
-            case ADC_ABS: //2 bytes long
-            {
-                word operand = getAbsOp();      //get operand from absolute address
-                cpu->PC += 2;                        //target next opcode
-                adc(operand);                   //execute opcode
-                break;                   
-            }
-                
-            //SBC: Subtract Memory from Accumulator with Borrow: A - M - !C -> A
-            case SBC_IMMD: //2 bytes long
-            {
-                word operand = getImdOp();      //target operand 
-                cpu->PC += 2;                        //target next opcode
-                sbc(operand);                   //execute opcode
-                break;
-            }
-                
-            //TODO: other SBCs here
-            
-                
-            case INC_ZRP: //2 bytes long
-            {
-                PREPTEST(INC_ZRP);
+//increment Y
+//affects N and Z
+void iny(T6502 cpu)
+{
+    cpu->Y++;
+    
+    setNByWord(cpu, cpu->Y);
+    setZByWord(cpu, cpu->Y);
+}
 
-                address a = getZrpAddr();       //get address from zeropage                 
-                cpu->PC += 2;                        //target next opcode
-                inc(a);                         //execute opcode
+//decrement memory at address a
+//affects N and Z
+void dec(T6502 cpu, address a)
+{
+    word w = memRead(cpu->mem, a); //get value from mem
+    w--;                           //decrement it
+    memWrite(cpu->mem, w, a);      //write it back
 
-                TEST(INC_ZRP);
-                break;
-            }
-            
-            case INC_ZRPX: //2 bytes long
-            {
-                PREPTEST(INC_ZRPX);
+    setNByWord(cpu, w);
+    setZByWord(cpu, w);
+}
 
-                address a = getZrpXAddr();      //get address from zeropage + X                 
-                cpu->PC += 2;                        //target next opcode
-                inc(a);                         //execute opcode
+//decrement X
+//affects N and Z
+void dex(T6502 cpu)
+{
+    cpu->X--;
+    
+    setNByWord(cpu, cpu->X);
+    setZByWord(cpu, cpu->X);        
+}
 
-                TEST(INC_ZRPX);
-                break;
-            }
+//decrement Y
+//affects N and Z
+void dey(T6502 cpu)
+{
+    cpu->Y--;
+    
+    setNByWord(cpu, cpu->Y);
+    setZByWord(cpu, cpu->Y);        
+}
 
-            case INC_ABS: //3 bytes long
-            {
-                PREPTEST(INC_ABS);
+//############################# SHIFT & ROTATE INSTRUCTIONS #############################
 
-                address a = getAbsAddr();       //get absolute address                
-                cpu->PC += 3;                        //target next opcode
-                inc(a);                         //execute opcode
+//A <- (A << 1), original bit #7 is stored to carry flag
+//affects N, Z, C
+void asl_accu(T6502 cpu)
+{   
+    setCByFlag(cpu, getBit(cpu->A, 7)); //before shifting, save bit #7 to carry
+    
+    cpu->A = cpu->A << 1; //the actual shift operation   
 
-                TEST(INC_ABS);
-                break;
-            }
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A); 
+}
 
-            case INC_ABSX: //3 bytes long
-            {
-                PREPTEST(INC_ABSX);
+//M[a] <- (M[a] << 1), original bit #7 is stored to carry flag
+//affects N, Z, C
+void asl(T6502 cpu, address a)
+{   
+    word w = memRead(cpu->mem, a); //get word stored at address
 
-                address a = getAbsXAddr();      //get absolute address                
-                cpu->PC += 3;                        //target next opcode
-                inc(a);                         //execute opcode
+    setCByFlag(cpu, getBit(w, 7)); //before shifting, save bit #7 to carry
+    
+    w = w << 1; //the actual shift operation
 
-                TEST(INC_ABSX);
-                break;
-            }
-            
-            
-            case INX_IMPL: 
-            {
-                PREPTEST(INX_IMPL);
-            
-                cpu->PC++;                //target next opcode
-                inx();               //execute opcode
-            
-                TEST(INX_IMPL);
-                break;        
-            }
-                
-            case INY_IMPL: 
-            {
-                PREPTEST(INY_IMPL);
-            
-                cpu->PC++;                //target next opcode
-                iny();               //execute opcode
-            
-                TEST(INY_IMPL);
-                break;        
-            }
+    memWrite(cpu->mem, w, a); //write back updated word
 
-            case DEC_ZRP:
-            {
-                PREPTEST(DEC_ZRP);
+    setNByWord(cpu, w);
+    setZByWord(cpu, w); 
+}
 
-                address a = getZrpAddr();       //get address from zeropage                 
-                cpu->PC += 2;                        //target next opcode
-                dec(a);                         //execute opcode
+//A <- (A >> 1), original bit #0 is stored to carry flag
+//affects N, Z, C
+void lsr_accu(T6502 cpu)
+{   
+    setCByFlag(cpu, getBit(cpu->A, 0)); //before shifting, save bit #0 to carry
+    
+    cpu->A = cpu->A >> 1; //the actual shift operation   
 
-                TEST(DEC_ZRP);
-                break;
-            }
-            
-            case DEC_ZRPX:
-            {
-                PREPTEST(DEC_ZRPX);
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A); 
+}
 
-                address a = getZrpXAddr();      //get address from zeropage + X                 
-                cpu->PC += 2;                        //target next opcode
-                dec(a);                         //execute opcode
+//M[a] <- (M[a] >> 1), original bit #0 is stored to carry flag
+//affects N, Z, C
+void lsr(T6502 cpu, address a)
+{   
+    word w = memRead(cpu->mem, a); //get word stored at address
 
-                TEST(DEC_ZRPX);
-                break;
-            }
+    setCByFlag(cpu, getBit(w, 0)); //before shifting, save bit #0 to carry
+    
+    w = w >> 1; //the actual shift operation
 
-            case DEC_ABS:
-            {
-                PREPTEST(DEC_ABS);
+    memWrite(cpu->mem, w, a); //write back updated word
 
-                address a = getAbsAddr();       //get absolute address                
-                cpu->PC += 3;                        //target next opcode
-                dec(a);                         //execute opcode
+    setNByWord(cpu, w);
+    setZByWord(cpu, w); 
+}
 
-                TEST(DEC_ABS);
-                break;
-            }
+//rotate left: shift A left, copy carry to bit #0 of A and original bit #7 to carry
+//affects N, Z, C
+void rol_accu(T6502 cpu)
+{   
+    word c = getC(cpu); //carry rotates in, so keep it before it is overwritten
 
-            case DEC_ABSX:
-            {
-                PREPTEST(DEC_ABSX);
+    setCByFlag(cpu, getBit(cpu->A, 7)); //before shifting, save bit #7 to carry
+    
+    cpu->A = cpu->A << 1; //the actual shift operation
 
-                address a = getAbsXAddr();      //get absolute address                
-                cpu->PC += 3;                        //target next opcode
-                dec(a);                         //execute opcode
+    cpu->A = cpu->A | c; //copy old carry to bit #0
 
-                TEST(DEC_ABSX);
-                break;
-            }
-                
-            case DEX_IMPL: 
-            {
-                PREPTEST(DEX_IMPL);
-            
-                cpu->PC++;                //target next opcode
-                dex();               //execute opcode
-            
-                TEST(DEX_IMPL);
-                break;        
-            }
-                
-            case DEY_IMPL: 
-            {
-                PREPTEST(DEY_IMPL);
-            
-                cpu->PC++;                //target next opcode
-                dey();               //execute opcode
-            
-                TEST(DEY_IMPL);
-                break;        
-            }
-                
-                
-            //############################# SHIFT & ROTATE INSTRUCTIONS #############################
-            case ASL_ACCU: 
-            {
-                PREPTEST(ASL_ACCU);
-            
-                cpu->PC++;                //target next opcode
-                asl_accu();          //execute opcode
-            
-                TEST(ASL_ACCU);
-                break;        
-            }
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A); 
+}
 
-            case ASL_ZRP: 
-            {
-                PREPTEST(ASL_ZRP);
-                
-                address a = getZrpAddr();       //get address from zeropage                 
-                cpu->PC += 2;                        //target next opcode                
-                asl(a);                         //execute opcode
+//rotate left: shift M[a] left, copy carry to bit #0 of M[a] and original bit #7 to carry
+//affects N, Z, C
+void rol(T6502 cpu, address a)
+{   
+    word w = memRead(cpu->mem, a); //get word stored at address
+    word c = getC(cpu);            //carry rotates in, so keep it before it is overwritten
 
-                TEST(ASL_ZRP);
-                break;        
-            }
-            
-            case ASL_ZRPX: 
-            {
-                PREPTEST(ASL_ZRPX);
-                
-                address a = getZrpXAddr();      //get address from zeropage+X                 
-                cpu->PC += 2;                        //target next opcode                
-                asl(a);                         //execute opcode
+    setCByFlag(cpu, getBit(w, 7)); //before shifting, save bit #7 to carry
+    
+    w = w << 1; //the actual shift operation
 
-                TEST(ASL_ZRPX);
-                break;        
-            }
+    w = w | c; //copy old carry to bit #0
 
-            case ASL_ABS: 
-            {
-                PREPTEST(ASL_ABS);
-                
-                address a = getAbsAddr();       //get absoulte address                 
-                cpu->PC += 3;                        //target next opcode                
-                asl(a);                         //execute opcode
+    memWrite(cpu->mem, w, a); //write back updated word
 
-                TEST(ASL_ABS);
-                break;        
-            }
+    setNByWord(cpu, w);
+    setZByWord(cpu, w); 
+}
 
-            case ASL_ABSX: 
-            {
-                PREPTEST(ASL_ABSX);
-                
-                address a = getAbsXAddr();      //get absoulte+X address                 
-                cpu->PC += 3;                        //target next opcode                
-                asl(a);                         //execute opcode
+//rotate right: shift A right, copy carry to bit #7 of A and original bit #0 to carry
+//affects N, Z, C
+void ror_accu(T6502 cpu)
+{   
+    word c = getC(cpu); //carry rotates in, so keep it before it is overwritten
 
-                TEST(ASL_ABSX);
-                break;        
-            }
+    setCByFlag(cpu, getBit(cpu->A, 0)); //before shifting, save bit #0 to carry
+    
+    cpu->A = cpu->A >> 1; //the actual shift operation
 
-            case LSR_ACCU: 
-            {
-                PREPTEST(LSR_ACCU);
-            
-                cpu->PC++;                           //target next opcode
-                lsr_accu();                     //execute opcode
-            
-                TEST(LSR_ACCU);
-                break;        
-            }
+    cpu->A = cpu->A | (c << 7); //copy old carry to bit #7
 
-            case LSR_ZRP: 
-            {
-                PREPTEST(LSR_ZRP);
-                
-                address a = getZrpAddr();       //get address from zeropage                 
-                cpu->PC += 2;                        //target next opcode                
-                lsr(a);                         //execute opcode
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A); 
+}
 
-                TEST(LSR_ZRP);
-                break;        
-            }
-            
-            case LSR_ZRPX: 
-            {
-                PREPTEST(LSR_ZRPX);
-                
-                address a = getZrpXAddr();      //get address from zeropage+X                 
-                cpu->PC += 2;                        //target next opcode                
-                lsr(a);                         //execute opcode
+//rotate right: shift M[a] right, copy carry to bit #7 of M[a] and original bit #0 to carry
+//affects N, Z, C
+void ror(T6502 cpu, address a)
+{   
+    word w = memRead(cpu->mem, a); //get word stored at address
+    word c = getC(cpu);            //carry rotates in, so keep it before it is overwritten
 
-                TEST(LSR_ZRPX);
-                break;        
-            }
+    setCByFlag(cpu, getBit(w, 0)); //before shifting, save bit #0 to carry
+    
+    w = w >> 1; //the actual shift operation
 
-            case LSR_ABS: 
-            {
-                PREPTEST(LSR_ABS);
-                
-                address a = getAbsAddr();       //get absoulte address                 
-                cpu->PC += 3;                        //target next opcode                
-                lsr(a);                         //execute opcode
+    w = w | (c << 7); //copy old carry to bit #7
 
-                TEST(LSR_ABS);
-                break;        
-            }
+    memWrite(cpu->mem, w, a); //write back updated word
 
-            case LSR_ABSX: 
-            {
-                PREPTEST(LSR_ABSX);
-                
-                address a = getAbsXAddr();      //get absoulte+X address                 
-                cpu->PC += 3;                        //target next opcode                
-                lsr(a);                         //execute opcode
+    setNByWord(cpu, w);
+    setZByWord(cpu, w); 
+}
 
-                TEST(LSR_ABSX);
-                break;        
-            }
+//############################# LOGIC INSTRUCTIONS #############################
 
-            case ROL_ACCU: 
-            {
-                PREPTEST(ROL_ACCU);
-            
-                cpu->PC++;                //target next opcode
-                rol_accu();          //execute opcode
-            
-                TEST(ROL_ACCU);
-                break;        
-            }
+//A <-- A & operand
+//affects N, Z
+void and(T6502 cpu, word operand)
+{
+    cpu->A = cpu->A & operand;
 
-            case ROL_ZRP: 
-            {
-                PREPTEST(ROL_ZRP);
-                
-                address a = getZrpAddr();       //get address from zeropage                 
-                cpu->PC += 2;                        //target next opcode                
-                rol(a);                         //execute opcode
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A);
+}
 
-                TEST(ROL_ZRP);
-                break;        
-            }
-            
-            case ROL_ZRPX: 
-            {
-                PREPTEST(ROL_ZRPX);
-                
-                address a = getZrpXAddr();      //get address from zeropage+X                 
-                cpu->PC += 2;                        //target next opcode                
-                rol(a);                         //execute opcode
+//A <-- A | operand
+//affects N, Z
+void ora(T6502 cpu, word operand)
+{
+    cpu->A = cpu->A | operand;
 
-                TEST(ROL_ZRPX);
-                break;        
-            }
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A);
+}
 
-            case ROL_ABS: 
-            {
-                PREPTEST(ROL_ABS);
-                
-                address a = getAbsAddr();       //get absoulte address                 
-                cpu->PC += 3;                        //target next opcode                
-                rol(a);                         //execute opcode
+//A <-- A ^ operand
+//affects N, Z
+void eor(T6502 cpu, word operand)
+{
+    cpu->A = cpu->A ^ operand;
 
-                TEST(ROL_ABS);
-                break;        
-            }
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A);
+}
 
-            case ROL_ABSX: 
-            {
-                PREPTEST(ROL_ABSX);
-                
-                address a = getAbsXAddr();      //get absoulte+X address                 
-                cpu->PC += 3;                        //target next opcode                
-                rol(a);                         //execute opcode
+//############################# COMPARE AND TEST BIT INSTRUCTIONS #############################
 
-                TEST(ROL_ABSX);
-                break;        
-            }
-            
-                
-            case ROR_ACCU: 
-            {
-                PREPTEST(ROR_ACCU);
-            
-                cpu->PC++;                //target next opcode
-                ror_accu();          //execute opcode
-            
-                TEST(ROR_ACCU);
-                break;        
-            }
+//reg - M (compute difference = compare), shared by CMP, CPX and CPY
+//affects N, Z, C
+void compare(T6502 cpu, word reg, word operand)
+{
+    word diff = reg - operand;
 
-            case ROR_ZRP: 
-            {
-                PREPTEST(ROR_ZRP);
-                
-                address a = getZrpAddr();       //get address from zeropage                 
-                cpu->PC += 2;                        //target next opcode                
-                ror(a);                         //execute opcode
+    setCByFlag(cpu, reg >= operand);    //no borrow needed
+    setNByWord(cpu, diff);              //N is bit #7 of the 8 bit difference
+    setZByWord(cpu, diff);
+}
 
-                TEST(ROR_ZRP);
-                break;        
-            }
-            
-            case ROR_ZRPX: 
-            {
-                PREPTEST(ROR_ZRPX);
-                
-                address a = getZrpXAddr();      //get address from zeropage+X                 
-                cpu->PC += 2;                        //target next opcode                
-                ror(a);                         //execute opcode
+//A - M
+//affects N, Z, C
+void cmp(T6502 cpu, word operand)
+{
+    compare(cpu, cpu->A, operand);
+}
 
-                TEST(ROR_ZRPX);
-                break;        
-            }
+//X - M
+//affects N, Z, C
+void cpx(T6502 cpu, word operand)
+{
+    compare(cpu, cpu->X, operand);
+}
 
-            case ROR_ABS: 
-            {
-                PREPTEST(ROR_ABS);
-                
-                address a = getAbsAddr();       //get absoulte address                 
-                cpu->PC += 3;                        //target next opcode                
-                ror(a);                         //execute opcode
+//Y - M
+//affects N, Z, C
+void cpy(T6502 cpu, word operand)
+{
+    compare(cpu, cpu->Y, operand);
+}
 
-                TEST(ROR_ABS);
-                break;        
-            }
+//A & M, bits #7 and #6 of M are copied to N and V
+//affects N, V, Z
+void bit(T6502 cpu, word operand)
+{
+    setNByFlag(cpu, getBit(operand, 7));
+    setVByFlag(cpu, getBit(operand, 6));
+    setZByWord(cpu, cpu->A & operand);
+}
 
-            case ROR_ABSX: 
-            {
-                PREPTEST(ROR_ABSX);
-                
-                address a = getAbsXAddr();      //get absoulte+X address                 
-                cpu->PC += 3;                        //target next opcode                
-                ror(a);                         //execute opcode
+//############################# SET AND CLEAR INSTRUCTIONS #############################
 
-                TEST(ROR_ABSX);
-                break;        
-            }
+//C <-- 1
+//affects C
+void sec(T6502 cpu)
+{
+    setCByFlag(cpu, 1); //set C
+}
 
-            //############################# LOGIC INSTRUCTIONS #############################
-            case AND_IMMD: 
-            {
-                PREPTEST(AND_IMMD);
-                
-                word operand = getImdOp();      //get immediate operand
-                cpu->PC += 2;                        //target next opcode
-                and(operand);                   //execute opcode
-                
-                TEST(AND_IMMD);
-                break;        
-            }
+//D <-- 1
+//affects D
+void sed(T6502 cpu)
+{
+    setDByFlag(cpu, 1); //set D
+}
 
-            case AND_ZRP: 
-            {
-                PREPTEST(AND_ZRP);
-                
-                word operand = getZrpOp();      //get zeropage operand
-                cpu->PC += 2;                        //target next opcode
-                and(operand);                   //execute opcode
-                
-                TEST(AND_ZRP);
-                break;        
-            }
+//I <-- 1
+//affects I
+void sei(T6502 cpu)
+{
+    setIByFlag(cpu, 1); //set I
+}
 
-            case AND_ZRPX: 
-            {
-                PREPTEST(AND_ZRPX);
-                
-                word operand = getZrpXOp();     //get zeropage+X operand
-                cpu->PC += 2;                        //target next opcode
-                and(operand);                   //execute opcode
-                
-                TEST(AND_ZRPX);
-                break;        
-            }
+//C <-- 0
+//affects C
+void clc(T6502 cpu)
+{
+    setCByFlag(cpu, 0); //clear C
+}
 
-            case AND_ABS: 
-            {
-                PREPTEST(AND_ABS);
-                
-                word operand =  getAbsOp();     //get absoulte operand
-                cpu->PC += 3;                        //target next opcode
-                and(operand);                   //execute opcode
-                
-                TEST(AND_ABS);
-                break;        
-            }
+//D <-- 0
+//affects D
+void cld(T6502 cpu)
+{
+    setDByFlag(cpu, 0); //clear D
+}
 
-            case AND_ABSX: 
-            {
-                PREPTEST(AND_ABSX);
-                
-                word operand =  getAbsXOp();    //get absolute+X operand
-                cpu->PC += 3;                        //target next opcode
-                and(operand);                   //execute opcode
-                
-                TEST(AND_ABSX);
-                break;        
-            }
+//I <-- 0
+//affects I
+void cli(T6502 cpu)
+{
+    setIByFlag(cpu, 0); //clear I
+    irqUnmasked(cpu);
+}
 
-            case AND_ABSY: 
-            {
-                PREPTEST(AND_ABSY);
-                
-                word operand =  getAbsYOp();    //get absolute+Y operand
-                cpu->PC += 3;                        //target next opcode
-                and(operand);                   //execute opcode
-                
-                TEST(AND_ABSY);
-                break;        
-            }
+//V <-- 0
+//affects V
+void clv(T6502 cpu)
+{
+    setVByFlag(cpu, 0); //clear V
+}
 
-            case AND_XIND: 
-            {
-                PREPTEST(AND_XIND);
-                
-                word operand =  getXIndOp();    //get X indexed indirect operand
-                cpu->PC += 2;                        //target next opcode
-                and(operand);                   //execute opcode
-                
-                TEST(AND_XIND);
-                break;        
-            }
+//############################# JUMP AND SUBROUTINE INSTRUCTIONS #############################
 
-            case AND_INDY: 
-            {
-             //TODO      
-             break;;  
-            }
+//jump to new location
+//3 bytes long
+//no flags affected
+void jmp(T6502 cpu, address a)
+{
+    cpu->PC = a;
+}
 
-            case ORA_IMMD: 
-            {
-                PREPTEST(ORA_IMMD);
-                
-                word operand = getImdOp();      //get immediate operand
-                cpu->PC += 2;                        //target next opcode
-                ora(operand);                   //execute opcode
-                
-                TEST(ORA_IMMD);
-                break;        
-            }
+//jump to subroutine: push PC to stack and load PC with jump address a
+//note: JSR instruction increments the PC only by 2 (according to real HW implementation)
+//the PC is incremented to proper address later by corresponding RTS
+//no flags affected
+void jsr(T6502 cpu, address a)
+{
+    push(cpu, (cpu->PC & 0xFF00) >> 8);     //push PC-HI to stack
+    push(cpu, cpu->PC & 0x00FF);            //push PC-LO to stack
 
-            case ORA_ZRP: 
-            {
-                PREPTEST(ORA_ZRP);
-                
-                word operand = getZrpOp();      //get zeropage operand
-                cpu->PC += 2;                        //target next opcode
-                ora(operand);                   //execute opcode
-                
-                TEST(ORA_ZRP);
-                break;        
-            }
+    cpu->PC = a;                     //store jump address to PC
+}
 
-            case ORA_ZRPX: 
-            {
-                PREPTEST(ORA_ZRPX);
-                
-                word operand = getZrpXOp();     //get zeropage+X operand
-                cpu->PC += 2;                        //target next opcode
-                ora(operand);                   //execute opcode
-                
-                TEST(ORA_ZRPX);
-                break;        
-            }
+//return from subroutine: pull previously saved PC value from stack and loat it into PC register
+//note: after pulling the PC from stack it must be incremented (according to real HW implementation)
+//no flags affected
+void rts(T6502 cpu)
+{
+    word pclo = pull(cpu);           //pull value from stack, the value should be LO byte of the previously pushed PC register
+    word pchi = pull(cpu);           //pull value from stack, the value should be HI byte of the previously pushed PC register
 
-            case ORA_ABS: 
-            {
-                PREPTEST(ORA_ABS);
-                
-                word operand =  getAbsOp();     //get absoulte operand
-                cpu->PC += 3;                        //target next opcode
-                ora(operand);                   //execute opcode
-                
-                TEST(ORA_ABS);
-                break;        
-            }
+    cpu->PC = lohi2addr(pclo, pchi); //from LO byte and HI byte, construct address and store it into PC register (PC is then restored after JSR)
+}
 
-            case ORA_ABSX: 
-            {
-                PREPTEST(ORA_ABSX);
-                
-                word operand =  getAbsXOp();    //get absolute+X operand
-                cpu->PC += 3;                        //target next opcode
-                ora(operand);                   //execute opcode
-                
-                TEST(ORA_ABSX);
-                break;        
-            }
+//return from interrupt: pull P, then the PC pushed by the interrupt (or BRK), which is not incremented
+//affects all bits in P, because a new value is fetched into P
+void rti_impl(T6502 cpu)
+{
+    cpu->P = pull(cpu);
+    word pclo = pull(cpu);
+    word pchi = pull(cpu);
 
-            case ORA_ABSY: 
-            {
-                PREPTEST(ORA_ABSY);
-                
-                word operand =  getAbsYOp();    //get absolute+Y operand
-                cpu->PC += 3;                        //target next opcode
-                ora(operand);                   //execute opcode
-                
-                TEST(ORA_ABSY);
-                break;        
-            }
+    cpu->PC = lohi2addr(pclo, pchi);
+    irqUnmasked(cpu);
+}
 
-            case ORA_XIND: 
-            {
-                PREPTEST(ORA_XIND);
-                
-                word operand =  getXIndOp();    //get X indexed indirect operand
-                cpu->PC += 2;                        //target next opcode
-                ora(operand);                   //execute opcode
-                
-                TEST(ORA_XIND);
-                break;        
-            }
+//############################# BRANCH INSTRUCTIONS #############################
 
-            case ORA_INDY: 
-            {
-             //TODO      
-             break;;  
-            }
+//the instruction at pc jumps or branches to itself: unless an interrupt can still come (pending NMI, IRQ
+//asserted and not masked, or a device event that may raise one) the CPU spins there forever
+static inline void checkHalt(T6502 cpu, address pc)
+{
+    if (!cpu->halt_check || cpu->nmi_pending || (cpu->irq && !getI(cpu)) || schedNext(&cpu->sched) != SCHED_NEVER) return;
+    cpuStop(cpu, CPU_STOP_HALT, pc);
+}
 
+//add signed offset to jump to current position + offset, which is in [-128, 127]
+//a taken branch costs one extra cycle, one more if it crosses a page
+void branch(T6502 cpu, sword operand)
+{
+    address target = (address) ((int) cpu->PC + operand);
 
-            case EOR_IMMD: 
-            {
-                PREPTEST(EOR_IMMD);
-                
-                word operand = getImdOp();      //get immediate operand
-                cpu->PC += 2;                        //target next opcode
-                eor(operand);                   //execute opcode
-                
-                TEST(EOR_IMMD);
-                break;        
-            }
+    if (operand == -2) checkHalt(cpu, target);
 
-            case EOR_ZRP: 
-            {
-                PREPTEST(EOR_ZRP);
-                
-                word operand = getZrpOp();      //get zeropage operand
-                cpu->PC += 2;                        //target next opcode
-                eor(operand);                   //execute opcode
-                
-                TEST(EOR_ZRP);
-                break;        
-            }
+    cpu->cycles += ((target ^ cpu->PC) & 0xFF00) ? 2 : 1;
+    cpu->PC = target;
+}
 
-            case EOR_ZRPX: 
-            {
-                PREPTEST(EOR_ZRPX);
-                
-                word operand = getZrpXOp();     //get zeropage+X operand
-                cpu->PC += 2;                        //target next opcode
-                eor(operand);                   //execute opcode
-                
-                TEST(EOR_ZRPX);
-                break;        
-            }
+//branch to PC+operand if C is 0
+//2 bytes long, no flags affected
+void bcc(T6502 cpu, sword operand)
+{    
+    if (getC(cpu) == 0) branch(cpu, operand);
+}
 
-            case EOR_ABS: 
-            {
-                PREPTEST(EOR_ABS);
-                
-                word operand =  getAbsOp();     //get absoulte operand
-                cpu->PC += 3;                        //target next opcode
-                eor(operand);                   //execute opcode
-                
-                TEST(EOR_ABS);
-                break;        
-            }
+//branch to PC+operand if C is 1
+//2 bytes long, no flags affected
+void bcs(T6502 cpu, sword operand)
+{    
+    if (getC(cpu) == 1) branch(cpu, operand);
+}
 
-            case EOR_ABSX: 
-            {
-                PREPTEST(EOR_ABSX);
-                
-                word operand =  getAbsXOp();    //get absolute+X operand
-                cpu->PC += 3;                        //target next opcode
-                eor(operand);                   //execute opcode
-                
-                TEST(EOR_ABSX);
-                break;        
-            }
+//branch to PC+operand if Z is 1
+//2 bytes long, no flags affected
+void beq(T6502 cpu, sword operand)
+{    
+    if (getZ(cpu) == 1) branch(cpu, operand);
+}
 
-            case EOR_ABSY: 
-            {
-                PREPTEST(EOR_ABSY);
-                
-                word operand =  getAbsYOp();    //get absolute+Y operand
-                cpu->PC += 3;                        //target next opcode
-                eor(operand);                   //execute opcode
-                
-                TEST(EOR_ABSY);
-                break;        
-            }
+//branch to PC+operand if N is 1
+//2 bytes long, no flags affected
+void bmi(T6502 cpu, sword operand)
+{    
+    if (getN(cpu) == 1) branch(cpu, operand);
+}
 
-            case EOR_XIND: 
-            {
-                PREPTEST(EOR_XIND);
-                
-                word operand =  getXIndOp();    //get X indexed indirect operand
-                cpu->PC += 2;                        //target next opcode
-                eor(operand);                   //execute opcode
-                
-                TEST(EOR_XIND);
-                break;        
-            }
+//branch to PC+operand if Z is 0
+//2 bytes long, no flags affected
+void bne(T6502 cpu, sword operand)
+{
+    if (getZ(cpu) == 0) branch(cpu, operand);
+}
 
-            case EOR_INDY: 
-            {
-             //TODO      
-             break;;  
-            }
+//branch to PC+operand if N is 0
+//2 bytes long, no flags affected
+void bpl(T6502 cpu, sword operand)
+{
+    if (getN(cpu) == 0) branch(cpu, operand);
+}
 
+//branch to PC+operand if V is 0
+//2 bytes long, no flags affected
+void bvc(T6502 cpu, sword operand)
+{
+    if (getV(cpu) == 0) branch(cpu, operand);
+}
 
+//branch to PC+operand if V is 1
+//2 bytes long, no flags affected
+void bvs(T6502 cpu, sword operand)
+{
+    if (getV(cpu) == 1) branch(cpu, operand);
+}
 
-            //############################# COMPARE AND TEST BIT INSTRUCTIONS #############################
-            case CMP_IMMD: 
-            {
-                PREPTEST(CMP_IMMD);
-                
-                word operand = getImdOp();      //get immediate operand
-                cpu->PC += 2;                        //target next opcode
-                cmp(operand);                   //execute opcode
-                
-                TEST(CMP_IMMD);
-                break;
+//############################# STACK INSTRUCTIONS #############################
 
-            }
-                
-            //############################# SET AND CLEAR INSTRUCTIONS #############################
-            case SEC_IMPL: 
-            {
-                PREPTEST(SEC_IMPL);
-            
-                cpu->PC++;   //target next opcode
-                sec();  //execute opcode
-            
-                TEST(SEC_IMPL);
-                break; 
-            }
-            
-            case SED_IMPL: 
-            {
-                PREPTEST(SED_IMPL);
-            
-                cpu->PC++;   //target next opcode
-                sed();  //execute opcode
-            
-                TEST(SED_IMPL);
-                break; 
-            }
-                
-            case SEI_IMPL: 
-            {
-                PREPTEST(SEI_IMPL);
-            
-                cpu->PC++;   //target next opcode
-                sei();  //execute opcode
-            
-                TEST(SEI_IMPL);
-                break; 
-            }
-                
-                
-                
-            case CLC_IMPL: 
-            {
-                PREPTEST(CLC_IMPL);
-            
-                cpu->PC++;   //target next opcode
-                clc();  //execute opcode
-                
-                TEST(CLC_IMPL);
-                break; 
-            }
-                
-            case CLD_IMPL: 
-            {
-                PREPTEST(CLD_IMPL);
-            
-                cpu->PC++;   //target next opcode
-                cld();  //execute opcode
-            
-                TEST(CLD_IMPL);
-                break; 
-            }
-                
-            case CLI_IMPL: 
-            {
-                PREPTEST(CLI_IMPL);
-            
-                cpu->PC++;   //target next opcode
-                cli();  //execute opcode
-            
-                TEST(CLI_IMPL);
-                break; 
-            }
-                
-            case CLV_IMPL: 
-            {
-                PREPTEST(CLV_IMPL);
-            
-                cpu->PC++;   //target next opcode
-                clv();  //execute opcode
-            
-                TEST(CLV_IMPL);
-                break; 
-            }
-                
-            //############################# JUMP AND SUBROUTINE INSTRUCTIONS #############################
-            case JMP_ABS:
-            {
-                PREPTEST(JMP_ABS);
-            
-                address a = getAbsAddr();   //get absolute address
-                cpu->PC += 3;                    //target next opcode
-                jmp(a);                     //execute opcode
-            
-                TEST(JMP_ABS);
-                break; 
-            }
+//push A to stack, i.e. mem[SP] <- A
+//no flags affected
+void pha(T6502 cpu)
+{
+    push(cpu, cpu->A);
+}
 
-            case JMP_IND: //TODO
-            {
-                PREPTEST(JMP_IND);
-            
-                // cpu->PC++;   //target next opcode
-                // jmp();  //execute opcode
-            
-                TEST(JMP_IND);
-                break; 
-            }
+//pull value from stack into A, i.e. A <- mem[SP+1]
+//affects N and Z
+void pla(T6502 cpu)
+{
+    cpu->A = pull(cpu);     //value in SP is free to be overwritten by next push operation
 
-            case JSR_ABS:
-            {
-                PREPTEST(JSR_ABS);
-
-                address a = getAbsAddr();       //get absoulte address
-                cpu->PC += 2;                        //it's 3-byte opcode but we must increment only by 2 (corresponding RTS will increment the PC later)
-                jsr(a);                         //execute opcode
-            
-                TEST(JSR_ABS);
-                break; 
-            }
+    //set flags
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A); 
+}
 
-            case RTS_IMPL:
-            {
-                PREPTEST(RTS_IMPL);
-                            
-                rts();  //execute opcode
-                cpu->PC++;   //PC must be incremented after pulling it from stack 
-                        //because it still points to JSR's 2nd parameter rather than to the next opcode
-            
-                TEST(RTS_IMPL);
-                break; 
-            }
+//push P to stack, i.e. mem[SP] <- P
+//no flags affected
+void php(T6502 cpu)
+{
+    push(cpu, cpu->P | 0b00110000);     //pushed copy has always B and bit #5 set
+}
 
-            case RTI_IMPL: //TODO
-            {
-                PREPTEST(RTI_IMPL);
-            
-                // cpu->PC++;   //target next opcode
-                // jsr();  //execute opcode
-            
-                TEST(RTI_IMPL);
-                break; 
-            }                      
-                            
-            //############################# BRANCH INSTRUCTIONS #############################
-
-            case BCC_REL:
-            {
-                PREPTEST(BCC_REL);
+//pull value from stack into P, i.e. P <- mem[SP+1]
+//affects all bits in P, because a new value is fetched into P
+void plp(T6502 cpu)
+{
+    cpu->P = pull(cpu);     //value in SP is free to be overwritten by next push operation
+    irqUnmasked(cpu);
+}
 
-                sword operand = getRelOp(); //get relative operand, which is a signed word
-                cpu->PC += 2;                    //target next instruction, if branch is taken, we'll jump from here
-                bcc(operand);               //execute opcode
+//############################# MISC INSTRUCTIONS #############################
 
-                TEST(BCC_REL);
-                break;
-            }
+//software interrupt: push PC+2 (BRK has a padding byte) and P with B set, set I and jump via the IRQ vector
+//affects I
+void brk_impl(T6502 cpu)
+{
+    cpu->PC++;                      //skip padding byte
+    interrupt(cpu, VECTOR_IRQ, cpu->P | 0b00110000);
+}
 
-            case BCS_REL:
-            {
-                PREPTEST(BCS_REL);
+#ifdef CPU_CMOS
+//############################# 65C02 INSTRUCTIONS #############################
 
-                sword operand = getRelOp(); //get relative operand, which is a signed word
-                cpu->PC += 2;                    //target next instruction, if branch is taken, we'll jump from here
-                bcs(operand);               //execute opcode
+//push X to stack
+//no flags affected
+void phx(T6502 cpu)
+{
+    push(cpu, cpu->X);
+}
 
-                TEST(BCS_REL);
-                break;
-            }
+//push Y to stack
+//no flags affected
+void phy(T6502 cpu)
+{
+    push(cpu, cpu->Y);
+}
 
-            case BEQ_REL:
-            {
-                PREPTEST(BEQ_REL);
+//pull X from stack
+//affects N and Z
+void plx(T6502 cpu)
+{
+    cpu->X = pull(cpu);
+    setNByWord(cpu, cpu->X);
+    setZByWord(cpu, cpu->X);
+}
 
-                sword operand = getRelOp(); //get relative operand, which is a signed word
-                cpu->PC += 2;                    //target next instruction, if branch is taken, we'll jump from here
-                beq(operand);               //execute opcode
+//pull Y from stack
+//affects N and Z
+void ply(T6502 cpu)
+{
+    cpu->Y = pull(cpu);
+    setNByWord(cpu, cpu->Y);
+    setZByWord(cpu, cpu->Y);
+}
 
-                TEST(BEQ_REL);
-                break;
-            }
+//0 -> M
+//no flags
+void stz(T6502 cpu, address a)
+{
+    memWrite(cpu->mem, 0, a);
+}
 
-            case BMI_REL:
-            {
-                PREPTEST(BMI_REL);
+//M <- M | A, Z from A & M
+//affects Z
+void tsb(T6502 cpu, address a)
+{
+    word w = memRead(cpu->mem, a);
+    setZByWord(cpu, cpu->A & w);
+    memWrite(cpu->mem, w | cpu->A, a);
+}
 
-                sword operand = getRelOp(); //get relative operand, which is a signed word
-                cpu->PC += 2;                    //target next instruction, if branch is taken, we'll jump from here
-                bmi(operand);               //execute opcode
+//M <- M & ~A, Z from A & M
+//affects Z
+void trb(T6502 cpu, address a)
+{
+    word w = memRead(cpu->mem, a);
+    setZByWord(cpu, cpu->A & w);
+    memWrite(cpu->mem, w & ~cpu->A, a);
+}
 
-                TEST(BMI_REL);
-                break;
-            }
+//A <- A + 1
+//affects N and Z
+void inc_accu(T6502 cpu)
+{
+    cpu->A++;
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A);
+}
 
-            case BNE_REL: 
-            {
-                PREPTEST(BNE_REL);
+//A <- A - 1
+//affects N and Z
+void dec_accu(T6502 cpu)
+{
+    cpu->A--;
+    setNByWord(cpu, cpu->A);
+    setZByWord(cpu, cpu->A);
+}
 
-                sword operand = getRelOp(); //get relative operand, which is a signed word
-                cpu->PC += 2;                    //target next instruction, if branch is taken, we'll jump from here
-                bne(operand);               //execute opcode
+//BIT #: A & M, unlike the other BIT modes N and V are left alone
+//affects Z
+void bit_immd(T6502 cpu, word operand)
+{
+    setZByWord(cpu, cpu->A & operand);
+}
+#endif
 
-                TEST(BNE_REL);
-                break;
-            }
+// ################################# end opcode implementation #################################
 
-            case BPL_REL: 
-            {
-                PREPTEST(BPL_REL);
 
-                sword operand = getRelOp(); //get relative operand, which is a signed word
-                cpu->PC += 2;                    //target next instruction, if branch is taken, we'll jump from here
-                bpl(operand);               //execute opcode
+//call fn(ctx, when) once cycles reach when (absolute), returns 0 on success
+//may be called from event callbacks and while an instruction executes: the current slice ends early if needed
+int cpuSchedule(T6502 cpu, uint64_t when, TEventFn fn, void* ctx)
+{
+    if (schedAdd(&cpu->sched, when, fn, ctx) != 0) return -1;
+    if (when < cpu->slice_end) cpu->slice_end = when;
+    return 0;
+}
 
-                TEST(BPL_REL);
-                break;
-            }
+//remove all scheduled events with the given callback and context
+void cpuUnschedule(T6502 cpu, TEventFn fn, void* ctx)
+{
+    schedRemove(&cpu->sched, fn, ctx);
+}
 
-            case BVC_REL: 
-            {
-                PREPTEST(BVC_REL);
+//take a pending NMI, or IRQ if not masked by I, returns 1 if an interrupt was taken (cpuStep users call it in between steps)
+int cpuInterrupt(T6502 cpu)
+{
+    address vector;
 
-                sword operand = getRelOp(); //get relative operand, which is a signed word
-                cpu->PC += 2;                    //target next instruction, if branch is taken, we'll jump from here
-                bvc(operand);               //execute opcode
+    if (cpu->nmi_pending)
+    {
+        cpu->nmi_pending = 0;
+        vector = VECTOR_NMI;
+    }
+    else if (cpu->irq && !getI(cpu)) vector = VECTOR_IRQ;
+    else return 0;
 
-                TEST(BVC_REL);
-                break;
-            }
+    interrupt(cpu, vector, (cpu->P | 0b00100000) & 0b11101111); //pushed copy has B clear: hardware, not BRK
+    cpu->cycles += 7;
+    PROF_INTERRUPT(cpu, 7);     //PC is the handler's entry now
+    return 1;
+}
 
-            case BVS_REL: 
-            {
-                PREPTEST(BVS_REL);
+//assert (1) or release (0) the IRQ line for a source, a bit in the range 0x01..0x80
+void cpuSetIrq(T6502 cpu, word source, int asserted)
+{
+    if (asserted) cpu->irq |= source;
+    else cpu->irq &= ~source;
 
-                sword operand = getRelOp(); //get relative operand, which is a signed word
-                cpu->PC += 2;                    //target next instruction, if branch is taken, we'll jump from here
-                bvs(operand);               //execute opcode
+    cpu->slice_end = cpu->cycles;   //let cpuRun look at it after the current instruction
+}
 
-                TEST(BVS_REL);
-                break;
-            }
-                
-            //############################# STACK INSTRUCTIONS #############################
-            case PHA_IMPL:
-            {
-                PREPTEST(PHA_IMPL);
+//assert (1) or release (0) the NMI line, an interrupt is triggered on assertion only
+void cpuSetNmi(T6502 cpu, int asserted)
+{
+    if (asserted && !cpu->nmi)
+    {
+        cpu->nmi_pending = 1;
+        cpu->slice_end = cpu->cycles;
+    }
+    cpu->nmi = asserted ? 1 : 0;
+}
 
-                cpu->PC++;
-                pha();
 
-                TEST(PHA_IMPL);
-                break;           
-            }    
+//here we go: fetch, decode, execute
+eCpuStepStatus cpuStep(T6502 cpu)
+{
+    if (cpu == NULL)
+    {
+        logMessage("\nError: CPU was not inited");
+        return CPU_STEP_ERROR;
+    }
 
-            case PLA_IMPL:
-            {
-                PREPTEST(PLA_IMPL);
+    //fetch 
+    cpu->IR = memRead(cpu->mem, cpu->PC);
+    FLIGHT_RECORD(cpu);
 
-                cpu->PC++;
-                pla();
+    //account base cycles, addressing modes and branches add their penalties while executing
+    cpu->cycles += opcodeTable[cpu->IR].cycles;
+    cpu->instructions++;
+    
+    //decode, then execute
+    switch(cpu->IR)
+    {
+        //############################# TRANSFER INSTRUCTIONS #############################
+        case TAX_IMPL: //X <- A, 1 byte long
+        {
+            DBG_TRACE(TAX_IMPL);
+            cpu->PC++;
+            tax(cpu);
+            return CPU_STEP_OK;
+        }
 
-                TEST(PLA_IMPL);
-                break;           
-            } 
+        case TXA_IMPL: //A <- X, 1 byte long
+        {
+            DBG_TRACE(TXA_IMPL);
+            cpu->PC++;
+            txa(cpu);
+            return CPU_STEP_OK;
+        }
 
-            case PHP_IMPL:
-            {
-                PREPTEST(PHP_IMPL);
+        case TAY_IMPL: //Y <- A, 1 byte long
+        {
+            DBG_TRACE(TAY_IMPL);
+            cpu->PC++;
+            tay(cpu);
+            return CPU_STEP_OK;
+        }
 
-                cpu->PC++;
-                php();
+        case TYA_IMPL: //A <- Y, 1 byte long
+        {
+            DBG_TRACE(TYA_IMPL);
+            cpu->PC++;
+            tya(cpu);
+            return CPU_STEP_OK;
+        }
 
-                TEST(PHP_IMPL);
-                break;           
-            } 
+        case TSX_IMPL: //X <- SP, 1 byte long
+        {
+            DBG_TRACE(TSX_IMPL);
+            cpu->PC++;
+            tsx(cpu);
+            return CPU_STEP_OK;
+        }
 
-            case PLP_IMPL:
-            {
-                PREPTEST(PLP_IMPL);
+        case TXS_IMPL: //SP <- X, 1 byte long
+        {
+            DBG_TRACE(TXS_IMPL);
+            cpu->PC++;
+            txs(cpu);
+            return CPU_STEP_OK;
+        }
 
-                cpu->PC++;
-                plp();
+        //############################# STORAGE INSTRUCTIONS #############################
+        case LDA_IMMD: //A <- M, 2 bytes long
+        {
+            DBG_TRACE(LDA_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            lda(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-                TEST(PLP_IMPL);
-                break;           
-            } 
+        case LDA_ZRP: //A <- M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(LDA_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            lda(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
+        case LDA_ZRPX: //A <- M from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(LDA_ZRPX);
+            word operand = getZrpXOp(cpu);
+            cpu->PC += 2;
+            lda(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-            //############################# MISC INSTRUCTIONS #############################
-            case NOP_IMPL: //do nothing, 1 byte long
-            {
-                cpu->PC++; //nothing to do, just target next operand
-                break;
-            }
+        case LDA_ABS: //A <- M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(LDA_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            lda(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-            //case BRK_IMPL:
-            //{
-                //cpu->PC++;
-                //brk(); //TODO
-                //printf("TODO: BRK NOT IMPLEMENTED");
-            //    break;
-            //}
+        case LDA_ABSX: //A <- M from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(LDA_ABSX);
+            word operand = getAbsXOp(cpu);
+            cpu->PC += 3;
+            lda(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-            //TODO: delte this if BRK works properly, BKR is also 0x0
-            case 0x0: //no instruction found, assuming that program has exited
-            {
-                printf("\nNo more instructions. Emulation stopped. \n");
-                running = 0;
-                break;
-            }
-            
-			default: //invalid instruction
-            { 
-                printf("\nError: unknown instruction: 0x%X at 0x%.4X. Emulation stopped. \n", cpu->IR, cpu->PC); 
-                running = 0;
-            }            
-            
-		} //switch IR
-
-	} //while running
-    
-    
-#ifdef TEST_MODE 
-printf("\nTestmode was on.\n");  
-#endif
+        case LDA_ABSY: //A <- M from [PChi,PClo]+Y, 3 bytes long
+        {
+            DBG_TRACE(LDA_ABSY);
+            word operand = getAbsYOp(cpu);
+            cpu->PC += 3;
+            lda(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-	return 0;
-}
+        case LDA_XIND: //A <- M from [[zeropage+X]], 2 bytes long
+        {
+            DBG_TRACE(LDA_XIND);
+            word operand = getXIndOp(cpu);
+            cpu->PC += 2;
+            lda(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//X <- A
-//affects N and Z
-void tax(void) //OK
-{    
-    cpu->X = cpu->A;
-                
-    //set flags
-    setNByWord(cpu->X);
-    setZByWord(cpu->X); 
-}
+        case LDA_INDY: //A <- M from [[zeropage]]+Y, 2 bytes long
+        {
+            DBG_TRACE(LDA_INDY);
+            word operand = getIndYOp(cpu);
+            cpu->PC += 2;
+            lda(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//A <- X
-//affects N and Z
-void txa(void)
-{
-    cpu->A = cpu->X;    
-    
-    //set flags
-    setNByWord(cpu->A); 
-    setZByWord(cpu->A); 
-}
+        case LDX_IMMD: //X <- M, 2 bytes long
+        {
+            DBG_TRACE(LDX_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            ldx(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
+        case LDX_ZRP: //X <- M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(LDX_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            ldx(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//Y <- A
-//affects N and Z
-void tay(void)
-{
-    cpu->Y = cpu->A;       
-    
-    //set flags
-    setNByWord(cpu->Y); 
-    setZByWord(cpu->Y);
-}
+        case LDX_ZRPY: //X <- M from zeropage+Y, 2 bytes long
+        {
+            DBG_TRACE(LDX_ZRPY);
+            word operand = getZrpYOp(cpu);
+            cpu->PC += 2;
+            ldx(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//A <- Y
-//affects N and Z
-void tya(void)
-{
-    cpu->A = cpu->Y;      
+        case LDX_ABS: //X <- M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(LDX_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            ldx(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    //set flags
-    setNByWord(cpu->A); 
-    setZByWord(cpu->A);    
-}
+        case LDX_ABSY: //X <- M from [PChi,PClo]+Y, 3 bytes long
+        {
+            DBG_TRACE(LDX_ABSY);
+            word operand = getAbsYOp(cpu);
+            cpu->PC += 3;
+            ldx(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//X <- SP
-//affects N and Z
-void tsx(void)
-{    
-	cpu->X = cpu->SP;       
-                
-    //set flags
-    setNByWord(cpu->X); 
-    setZByWord(cpu->X);    
-}
+        case LDY_IMMD: //Y <- M, 2 bytes long
+        {
+            DBG_TRACE(LDY_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            ldy(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//SP <- X
-//no flags
-void txs(void)
-{
-    cpu->SP = cpu->X;      
-}
+        case LDY_ZRP: //Y <- M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(LDY_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            ldy(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
+        case LDY_ZRPX: //Y <- M from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(LDY_ZRPX);
+            word operand = getZrpXOp(cpu);
+            cpu->PC += 2;
+            ldy(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//A <- M
-//affects N and Z
-void lda(word operand)
-{      
-    cpu->A = operand; 
-                
-    //set flags
-    setNByWord(cpu->A);
-    setZByWord(cpu->A);    
-}
+        case LDY_ABS: //Y <- M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(LDY_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            ldy(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//A -> M
-//no flags
-void sta(address a)
-{      
-    memWrite(mem, cpu->A, a); //write contents of A to address a   
-}
+        case LDY_ABSX: //Y <- M from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(LDY_ABSX);
+            word operand = getAbsXOp(cpu);
+            cpu->PC += 3;
+            ldy(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//X -> M
-void stx(address a)
-{      
-    memWrite(mem, cpu->X, a); //write contents of X to address a    
-}
+        case STA_ZRP: //A -> M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(STA_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            sta(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//Y -> M
-void sty(address a)
-{      
-    memWrite(mem, cpu->Y, a); //write contents of Y to address a    
-}
+        case STA_ZRPX: //A -> M from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(STA_ZRPX);
+            address a = getZrpXAddr(cpu);
+            cpu->PC += 2;
+            sta(cpu, a);
+            return CPU_STEP_OK;
+        }
 
+        case STA_ABS: //A -> M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(STA_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            sta(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//############################# ARITHMETIC INSTRUCTIONS #############################
-//A <- A + M + C
-//affects N, V, Z and C 
-//note: decimal mode is not treated here, since NES' 6502 lacks BCD mode
-void adc(word operand)
-{
-    word Ainit = cpu->A;                         //get initial value of A since we need it to do some checks with it later
-    
-    dword A16 = Ainit + operand + getC();   //store result in 16 bit int to check whether it is greater than 8 bit
-    cpu->A = A16 & 0x0000FFFF;                   //copy result without cary (if exists) to A
-    
-    setNByWord(cpu->A);
-    
-    //if +a + +b got -c or -a + -b got +c then we have an overflow here (result didn't fit into 8 bit and wrapped over)
-    if ( (isN(operand) && isN(Ainit) && !isN(cpu->A)) || (!isN(operand) && !isN(Ainit) && isN(cpu->A)) )
-    {
-        setVByFlag(1);
-    }
-    
-    setZByWord(cpu->A); 
-    
-    //result > 255 => 8 bits were not sufficient => need 9th bit = carry, otherwise clear carry, which might be set (and used) before
-    (A16 > 0xFF) ? setCByFlag(1) : setCByFlag(0); 
-    
-       
-    //TODO: test with http://skilldrick.github.io/easy6502/    
-    printRegs(cpu);
-}
+        case STA_ABSX: //A -> M from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(STA_ABSX);
+            address a = getAbsXAddr(cpu);
+            cpu->PC += 3;
+            sta(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//SBC: Subtract Memory from Accumulator with Borrow: A - M - !C -> A
-//affects N, V, Z and C 
-void sbc(word operand)
-{
-    word Ainit = cpu->A;                         //get initial value of A since we need it to do some checks with it later
-    
-    dword A16 = Ainit - operand - !getC();  //store result in 16 bit int to check whether it is greater than 8 bit
-    cpu->A = A16 & 0x0000FFFF;                   //copy result without cary (if exists) to A
-    
-    setNByWord(cpu->A);
-    
-    //TODO: do stuff here too
-    
-    //TODO: test with http://skilldrick.github.io/easy6502/    
-    printRegs(cpu);
-    
-}
+        case STA_ABSY: //A -> M from [PChi,PClo]+Y, 3 bytes long
+        {
+            DBG_TRACE(STA_ABSY);
+            address a = getAbsYAddr(cpu);
+            cpu->PC += 3;
+            sta(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//increment memory: M <- M + 1
-//affects N and Z
-void inc(address a)
-{
-    word w = memRead(mem, a);
-    memWrite(mem, ++w, a);
+        case STA_XIND: //A -> M from [[zeropage+X]], 2 bytes long
+        {
+            DBG_TRACE(STA_XIND);
+            address a = getXIndAddr(cpu);
+            cpu->PC += 2;
+            sta(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(w);
-    setZByWord(w);
-}
+        case STA_INDY: //A -> M from [[zeropage]]+Y, 2 bytes long
+        {
+            DBG_TRACE(STA_INDY);
+            address a = getIndYAddr(cpu);
+            cpu->PC += 2;
+            sta(cpu, a);
+            return CPU_STEP_OK;
+        }
 
+        case STX_ZRP: //X -> M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(STX_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            stx(cpu, a);
+            return CPU_STEP_OK;
+        }
 
+        case STX_ZRPY: //X -> M from zeropage+Y, 2 bytes long
+        {
+            DBG_TRACE(STX_ZRPY);
+            address a = getZrpYAddr(cpu);
+            cpu->PC += 2;
+            stx(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//increment X
-//affects N and Z
-void inx(void)
-{
-    cpu->X++;
-    
-    setNByWord(cpu->X);
-    setZByWord(cpu->X);        
-}
+        case STX_ABS: //X -> M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(STX_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            stx(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//increment Y
-//affects N and Z
-void iny(void)
-{
-    cpu->Y++;
-    
-    setNByWord(cpu->Y);
-    setZByWord(cpu->Y);
-}
+        case STY_ZRP: //Y -> M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(STY_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            sty(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//decrement memory at address a
-//affects N and Z
-void dec(address a)
-{
-    word w = memRead(mem, a); //get value from mem
-    w--;             //decrement it
-    memWrite(mem, w, a);       //write it back
+        case STY_ZRPX: //Y -> M from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(STY_ZRPX);
+            address a = getZrpXAddr(cpu);
+            cpu->PC += 2;
+            sty(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(w);
-    setZByWord(w);
-}
+        case STY_ABS: //Y -> M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(STY_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            sty(cpu, a);
+            return CPU_STEP_OK;
+        }
 
+        //############################# ARITHMETIC INSTRUCTIONS #############################
+        case ADC_IMMD: //A <- A + M + C, 2 bytes long
+        {
+            DBG_TRACE(ADC_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            adc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//decrement X
-//affects N and Z
-void dex(void)
-{
-    cpu->X--;
-    
-    setNByWord(cpu->X);
-    setZByWord(cpu->X);        
-}
+        case ADC_ZRP: //A <- A + M + C from zeropage, 2 bytes long
+        {
+            DBG_TRACE(ADC_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            adc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//decrement Y
-//affects N and Z
-void dey(void)
-{
-    cpu->Y--;
-    
-    setNByWord(cpu->Y);
-    setZByWord(cpu->Y);        
-}
+        case ADC_ZRPX: //A <- A + M + C from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(ADC_ZRPX);
+            word operand = getZrpXOp(cpu);
+            cpu->PC += 2;
+            adc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//A <- (A << 1), original bit #7 is stored to carry flag
-//affects N, Z, C
-void asl_accu(void)
-{   
-    setCByFlag(getBit(cpu->A, 7)); //before shifting, save bit #7 to carry
-    
-    cpu->A = cpu->A << 1; //the actual shift operation   
+        case ADC_ABS: //A <- A + M + C from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(ADC_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            adc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(cpu->A);
-    setZByWord(cpu->A); 
-}
+        case ADC_ABSX: //A <- A + M + C from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(ADC_ABSX);
+            word operand = getAbsXOp(cpu);
+            cpu->PC += 3;
+            adc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//M[a] <- (M[a] << 1), original bit #7 is stored to carry flag
-//affects N, Z, C
-void asl(address a)
-{   
-    word w = memRead(mem, a); //get word stored at address
+        case ADC_ABSY: //A <- A + M + C from [PChi,PClo]+Y, 3 bytes long
+        {
+            DBG_TRACE(ADC_ABSY);
+            word operand = getAbsYOp(cpu);
+            cpu->PC += 3;
+            adc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    setCByFlag(getBit(w, 7)); //before shifting, save bit #7 to carry
-    
-    w = w << 1; //the actual shift operation
+        case ADC_XIND: //A <- A + M + C from [[zeropage+X]], 2 bytes long
+        {
+            DBG_TRACE(ADC_XIND);
+            word operand = getXIndOp(cpu);
+            cpu->PC += 2;
+            adc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    memWrite(mem, w, a); //write back updated word
+        case ADC_INDY: //A <- A + M + C from [[zeropage]]+Y, 2 bytes long
+        {
+            DBG_TRACE(ADC_INDY);
+            word operand = getIndYOp(cpu);
+            cpu->PC += 2;
+            adc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(w);
-    setZByWord(w); 
-}
+        case SBC_IMMD: //A <- A - M - !C, 2 bytes long
+        {
+            DBG_TRACE(SBC_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            sbc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//A <- (A >> 1), original bit #0 is stored to carry flag
-//affects N, Z, C
-void lsr_accu(void)
-{   
-    setCByFlag(getBit(cpu->A, 0)); //before shifting, save bit #0 to carry
-    
-    cpu->A = cpu->A >> 1; //the actual shift operation   
+        case SBC_ZRP: //A <- A - M - !C from zeropage, 2 bytes long
+        {
+            DBG_TRACE(SBC_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            sbc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(cpu->A);
-    setZByWord(cpu->A); 
-}
+        case SBC_ZRPX: //A <- A - M - !C from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(SBC_ZRPX);
+            word operand = getZrpXOp(cpu);
+            cpu->PC += 2;
+            sbc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//M[a] <- (M[a] >> 1), original bit #0 is stored to carry flag
-//affects N, Z, C
-void lsr(address a)
-{   
-    word w = memRead(mem, a); //get word stored at address
+        case SBC_ABS: //A <- A - M - !C from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(SBC_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            sbc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    setCByFlag(getBit(w, 0)); //before shifting, save bit #0 to carry
-    
-    w = w >> 1; //the actual shift operation
+        case SBC_ABSX: //A <- A - M - !C from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(SBC_ABSX);
+            word operand = getAbsXOp(cpu);
+            cpu->PC += 3;
+            sbc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    memWrite(mem, w, a); //write back updated word
+        case SBC_ABSY: //A <- A - M - !C from [PChi,PClo]+Y, 3 bytes long
+        {
+            DBG_TRACE(SBC_ABSY);
+            word operand = getAbsYOp(cpu);
+            cpu->PC += 3;
+            sbc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(w);
-    setZByWord(w); 
-}
+        case SBC_XIND: //A <- A - M - !C from [[zeropage+X]], 2 bytes long
+        {
+            DBG_TRACE(SBC_XIND);
+            word operand = getXIndOp(cpu);
+            cpu->PC += 2;
+            sbc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//rotate left: shift A left, copy original bit #7 to carry and to bit #0 of A
-//affects N, Z, C
-void rol_accu(void)
-{   
-    setCByFlag(getBit(cpu->A, 7)); //before shifting, save bit #7 to carry
-    
-    cpu->A = cpu->A << 1; //the actual shift operation
+        case SBC_INDY: //A <- A - M - !C from [[zeropage]]+Y, 2 bytes long
+        {
+            DBG_TRACE(SBC_INDY);
+            word operand = getIndYOp(cpu);
+            cpu->PC += 2;
+            sbc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    cpu->A = cpu->A | getC(); //copy carry to bit #0
+        case INC_ZRP: //M <- M + 1 from zeropage, 2 bytes long
+        {
+            DBG_TRACE(INC_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            inc(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(cpu->A);
-    setZByWord(cpu->A); 
-}
+        case INC_ZRPX: //M <- M + 1 from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(INC_ZRPX);
+            address a = getZrpXAddr(cpu);
+            cpu->PC += 2;
+            inc(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//rotate left: shift M[a] left, copy original bit #7 to carry and to bit #0 of M[a]
-//affects N, Z, C
-void rol(address a)
-{   
-    word w = memRead(mem, a); //get word stored at address
+        case INC_ABS: //M <- M + 1 from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(INC_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            inc(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-    setCByFlag(getBit(w, 7)); //before shifting, save bit #7 to carry
-    
-    w = w << 1; //the actual shift operation
+        case INC_ABSX: //M <- M + 1 from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(INC_ABSX);
+            address a = getAbsXAddr(cpu);
+            cpu->PC += 3;
+            inc(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-    w = w | getC(); //copy carry to bit #0
+        case INX_IMPL: //X <- X + 1, 1 byte long
+        {
+            DBG_TRACE(INX_IMPL);
+            cpu->PC++;
+            inx(cpu);
+            return CPU_STEP_OK;
+        }
 
-    memWrite(mem, w, a); //write back updated word
+        case INY_IMPL: //Y <- Y + 1, 1 byte long
+        {
+            DBG_TRACE(INY_IMPL);
+            cpu->PC++;
+            iny(cpu);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(w);
-    setZByWord(w); 
-}
+        case DEC_ZRP: //M <- M - 1 from zeropage, 2 bytes long
+        {
+            DBG_TRACE(DEC_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            dec(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//rotate right: shift A right, copy original bit #0 to carry and to bit #7 of A
-//affects N, Z, C
-void ror_accu(void)
-{   
-    setCByFlag(getBit(cpu->A, 0)); //before shifting, save bit #0 to carry
-    
-    cpu->A = cpu->A >> 1; //the actual shift operation
+        case DEC_ZRPX: //M <- M - 1 from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(DEC_ZRPX);
+            address a = getZrpXAddr(cpu);
+            cpu->PC += 2;
+            dec(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-    cpu->A = cpu->A | (getC() << 7); //copy carry to bit #7
+        case DEC_ABS: //M <- M - 1 from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(DEC_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            dec(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(cpu->A);
-    setZByWord(cpu->A); 
-}
+        case DEC_ABSX: //M <- M - 1 from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(DEC_ABSX);
+            address a = getAbsXAddr(cpu);
+            cpu->PC += 3;
+            dec(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//rotate right: shift M[a] rigth, copy original bit #0 to carry and to bit #7 of M[a]
-//affects N, Z, C
-void ror(address a)
-{   
-    word w = memRead(mem, a); //get word stored at address
+        case DEX_IMPL: //X <- X - 1, 1 byte long
+        {
+            DBG_TRACE(DEX_IMPL);
+            cpu->PC++;
+            dex(cpu);
+            return CPU_STEP_OK;
+        }
 
-    setCByFlag(getBit(w, 0)); //before shifting, save bit #0 to carry
-    
-    w = w >> 1; //the actual shift operation
+        case DEY_IMPL: //Y <- Y - 1, 1 byte long
+        {
+            DBG_TRACE(DEY_IMPL);
+            cpu->PC++;
+            dey(cpu);
+            return CPU_STEP_OK;
+        }
+
+        //############################# SHIFT & ROTATE INSTRUCTIONS #############################
+        case ASL_ACCU: //shift left A, 1 byte long
+        {
+            DBG_TRACE(ASL_ACCU);
+            cpu->PC++;
+            asl_accu(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case ASL_ZRP: //shift left of zeropage, 2 bytes long
+        {
+            DBG_TRACE(ASL_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            asl(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ASL_ZRPX: //shift left of zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(ASL_ZRPX);
+            address a = getZrpXAddr(cpu);
+            cpu->PC += 2;
+            asl(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ASL_ABS: //shift left of [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(ASL_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            asl(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ASL_ABSX: //shift left of [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(ASL_ABSX);
+            address a = getAbsXAddr(cpu);
+            cpu->PC += 3;
+            asl(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case LSR_ACCU: //shift right A, 1 byte long
+        {
+            DBG_TRACE(LSR_ACCU);
+            cpu->PC++;
+            lsr_accu(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case LSR_ZRP: //shift right of zeropage, 2 bytes long
+        {
+            DBG_TRACE(LSR_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            lsr(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case LSR_ZRPX: //shift right of zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(LSR_ZRPX);
+            address a = getZrpXAddr(cpu);
+            cpu->PC += 2;
+            lsr(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case LSR_ABS: //shift right of [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(LSR_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            lsr(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case LSR_ABSX: //shift right of [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(LSR_ABSX);
+            address a = getAbsXAddr(cpu);
+            cpu->PC += 3;
+            lsr(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ROL_ACCU: //rotate left A, 1 byte long
+        {
+            DBG_TRACE(ROL_ACCU);
+            cpu->PC++;
+            rol_accu(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case ROL_ZRP: //rotate left of zeropage, 2 bytes long
+        {
+            DBG_TRACE(ROL_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            rol(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ROL_ZRPX: //rotate left of zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(ROL_ZRPX);
+            address a = getZrpXAddr(cpu);
+            cpu->PC += 2;
+            rol(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ROL_ABS: //rotate left of [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(ROL_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            rol(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ROL_ABSX: //rotate left of [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(ROL_ABSX);
+            address a = getAbsXAddr(cpu);
+            cpu->PC += 3;
+            rol(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ROR_ACCU: //rotate right A, 1 byte long
+        {
+            DBG_TRACE(ROR_ACCU);
+            cpu->PC++;
+            ror_accu(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case ROR_ZRP: //rotate right of zeropage, 2 bytes long
+        {
+            DBG_TRACE(ROR_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            ror(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ROR_ZRPX: //rotate right of zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(ROR_ZRPX);
+            address a = getZrpXAddr(cpu);
+            cpu->PC += 2;
+            ror(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ROR_ABS: //rotate right of [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(ROR_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            ror(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case ROR_ABSX: //rotate right of [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(ROR_ABSX);
+            address a = getAbsXAddr(cpu);
+            cpu->PC += 3;
+            ror(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        //############################# LOGIC INSTRUCTIONS #############################
+        case AND_IMMD: //A <- A & M, 2 bytes long
+        {
+            DBG_TRACE(AND_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            and(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case AND_ZRP: //A <- A & M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(AND_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            and(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case AND_ZRPX: //A <- A & M from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(AND_ZRPX);
+            word operand = getZrpXOp(cpu);
+            cpu->PC += 2;
+            and(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    w = w | (getC() << 7); //copy carry to bit #7
+        case AND_ABS: //A <- A & M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(AND_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            and(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case AND_ABSX: //A <- A & M from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(AND_ABSX);
+            word operand = getAbsXOp(cpu);
+            cpu->PC += 3;
+            and(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case AND_ABSY: //A <- A & M from [PChi,PClo]+Y, 3 bytes long
+        {
+            DBG_TRACE(AND_ABSY);
+            word operand = getAbsYOp(cpu);
+            cpu->PC += 3;
+            and(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case AND_XIND: //A <- A & M from [[zeropage+X]], 2 bytes long
+        {
+            DBG_TRACE(AND_XIND);
+            word operand = getXIndOp(cpu);
+            cpu->PC += 2;
+            and(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case AND_INDY: //A <- A & M from [[zeropage]]+Y, 2 bytes long
+        {
+            DBG_TRACE(AND_INDY);
+            word operand = getIndYOp(cpu);
+            cpu->PC += 2;
+            and(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case ORA_IMMD: //A <- A | M, 2 bytes long
+        {
+            DBG_TRACE(ORA_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            ora(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case ORA_ZRP: //A <- A | M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(ORA_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            ora(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case ORA_ZRPX: //A <- A | M from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(ORA_ZRPX);
+            word operand = getZrpXOp(cpu);
+            cpu->PC += 2;
+            ora(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case ORA_ABS: //A <- A | M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(ORA_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            ora(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case ORA_ABSX: //A <- A | M from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(ORA_ABSX);
+            word operand = getAbsXOp(cpu);
+            cpu->PC += 3;
+            ora(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case ORA_ABSY: //A <- A | M from [PChi,PClo]+Y, 3 bytes long
+        {
+            DBG_TRACE(ORA_ABSY);
+            word operand = getAbsYOp(cpu);
+            cpu->PC += 3;
+            ora(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case ORA_XIND: //A <- A | M from [[zeropage+X]], 2 bytes long
+        {
+            DBG_TRACE(ORA_XIND);
+            word operand = getXIndOp(cpu);
+            cpu->PC += 2;
+            ora(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case ORA_INDY: //A <- A | M from [[zeropage]]+Y, 2 bytes long
+        {
+            DBG_TRACE(ORA_INDY);
+            word operand = getIndYOp(cpu);
+            cpu->PC += 2;
+            ora(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case EOR_IMMD: //A <- A ^ M, 2 bytes long
+        {
+            DBG_TRACE(EOR_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            eor(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case EOR_ZRP: //A <- A ^ M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(EOR_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            eor(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case EOR_ZRPX: //A <- A ^ M from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(EOR_ZRPX);
+            word operand = getZrpXOp(cpu);
+            cpu->PC += 2;
+            eor(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case EOR_ABS: //A <- A ^ M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(EOR_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            eor(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case EOR_ABSX: //A <- A ^ M from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(EOR_ABSX);
+            word operand = getAbsXOp(cpu);
+            cpu->PC += 3;
+            eor(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case EOR_ABSY: //A <- A ^ M from [PChi,PClo]+Y, 3 bytes long
+        {
+            DBG_TRACE(EOR_ABSY);
+            word operand = getAbsYOp(cpu);
+            cpu->PC += 3;
+            eor(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case EOR_XIND: //A <- A ^ M from [[zeropage+X]], 2 bytes long
+        {
+            DBG_TRACE(EOR_XIND);
+            word operand = getXIndOp(cpu);
+            cpu->PC += 2;
+            eor(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case EOR_INDY: //A <- A ^ M from [[zeropage]]+Y, 2 bytes long
+        {
+            DBG_TRACE(EOR_INDY);
+            word operand = getIndYOp(cpu);
+            cpu->PC += 2;
+            eor(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        //############################# COMPARE AND TEST BIT INSTRUCTIONS #############################
+        case CMP_IMMD: //A - M, 2 bytes long
+        {
+            DBG_TRACE(CMP_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            cmp(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    memWrite(mem, w, a); //write back updated word
+        case CMP_ZRP: //A - M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(CMP_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            cmp(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CMP_ZRPX: //A - M from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(CMP_ZRPX);
+            word operand = getZrpXOp(cpu);
+            cpu->PC += 2;
+            cmp(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CMP_ABS: //A - M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(CMP_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            cmp(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CMP_ABSX: //A - M from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(CMP_ABSX);
+            word operand = getAbsXOp(cpu);
+            cpu->PC += 3;
+            cmp(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CMP_ABSY: //A - M from [PChi,PClo]+Y, 3 bytes long
+        {
+            DBG_TRACE(CMP_ABSY);
+            word operand = getAbsYOp(cpu);
+            cpu->PC += 3;
+            cmp(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CMP_XIND: //A - M from [[zeropage+X]], 2 bytes long
+        {
+            DBG_TRACE(CMP_XIND);
+            word operand = getXIndOp(cpu);
+            cpu->PC += 2;
+            cmp(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CMP_INDY: //A - M from [[zeropage]]+Y, 2 bytes long
+        {
+            DBG_TRACE(CMP_INDY);
+            word operand = getIndYOp(cpu);
+            cpu->PC += 2;
+            cmp(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CPX_IMMD: //X - M, 2 bytes long
+        {
+            DBG_TRACE(CPX_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            cpx(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CPX_ZRP: //X - M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(CPX_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            cpx(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CPX_ABS: //X - M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(CPX_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            cpx(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CPY_IMMD: //Y - M, 2 bytes long
+        {
+            DBG_TRACE(CPY_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            cpy(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CPY_ZRP: //Y - M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(CPY_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            cpy(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case CPY_ABS: //Y - M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(CPY_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            cpy(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case BIT_ZRP: //A & M from zeropage, 2 bytes long
+        {
+            DBG_TRACE(BIT_ZRP);
+            word operand = getZrpOp(cpu);
+            cpu->PC += 2;
+            bit(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case BIT_ABS: //A & M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(BIT_ABS);
+            word operand = getAbsOp(cpu);
+            cpu->PC += 3;
+            bit(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        //############################# SET AND CLEAR INSTRUCTIONS #############################
+        case SEC_IMPL: //C <- 1, 1 byte long
+        {
+            DBG_TRACE(SEC_IMPL);
+            cpu->PC++;
+            sec(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case SED_IMPL: //D <- 1, 1 byte long
+        {
+            DBG_TRACE(SED_IMPL);
+            cpu->PC++;
+            sed(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case SEI_IMPL: //I <- 1, 1 byte long
+        {
+            DBG_TRACE(SEI_IMPL);
+            cpu->PC++;
+            sei(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case CLC_IMPL: //C <- 0, 1 byte long
+        {
+            DBG_TRACE(CLC_IMPL);
+            cpu->PC++;
+            clc(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case CLD_IMPL: //D <- 0, 1 byte long
+        {
+            DBG_TRACE(CLD_IMPL);
+            cpu->PC++;
+            cld(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case CLI_IMPL: //I <- 0, 1 byte long
+        {
+            DBG_TRACE(CLI_IMPL);
+            cpu->PC++;
+            cli(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case CLV_IMPL: //V <- 0, 1 byte long
+        {
+            DBG_TRACE(CLV_IMPL);
+            cpu->PC++;
+            clv(cpu);
+            return CPU_STEP_OK;
+        }
+
+        //############################# JUMP AND SUBROUTINE INSTRUCTIONS #############################
+        case JMP_ABS: //PC <- M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(JMP_ABS);
+            address a = getAbsAddr(cpu);
+            if (a == cpu->PC) checkHalt(cpu, a);
+            cpu->PC += 3;
+            jmp(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case JMP_IND: //PC <- M from [[PChi,PClo]], 3 bytes long
+        {
+            DBG_TRACE(JMP_IND);
+            address a = getIndAddr(cpu);
+            cpu->PC += 3;
+            jmp(cpu, a);
+            return CPU_STEP_OK;
+        }
+
+        case JSR_ABS: //push PC, PC <- M from [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(JSR_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 2;                   //it's 3-byte opcode but we must increment only by 2 (corresponding RTS will increment the PC later)
+            jsr(cpu, a);
+            if (cpu->hle != NULL && hleIsEntry(cpu->hle, a))
+            {
+                hleJsr(cpu, a);
+                cpu->slice_end = cpu->cycles;   //cpuRun hands the routine to its handler
+            }
+            return CPU_STEP_OK;
+        }
+
+        case RTS_IMPL: //pull PC, 1 byte long
+        {
+            DBG_TRACE(RTS_IMPL);
+            rts(cpu);
+            cpu->PC++;                      //PC still points to JSR's 2nd parameter rather than to the next opcode
+            return CPU_STEP_OK;
+        }
+
+        //############################# BRANCH INSTRUCTIONS #############################
+        case BCC_REL: //branch if condition holds, 2 bytes long
+        {
+            DBG_TRACE(BCC_REL);
+            sword operand = getRelOp(cpu);
+            cpu->PC += 2;                   //target next instruction, if branch is taken, we'll jump from here
+            bcc(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case BCS_REL: //branch if condition holds, 2 bytes long
+        {
+            DBG_TRACE(BCS_REL);
+            sword operand = getRelOp(cpu);
+            cpu->PC += 2;                   //target next instruction, if branch is taken, we'll jump from here
+            bcs(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case BEQ_REL: //branch if condition holds, 2 bytes long
+        {
+            DBG_TRACE(BEQ_REL);
+            sword operand = getRelOp(cpu);
+            cpu->PC += 2;                   //target next instruction, if branch is taken, we'll jump from here
+            beq(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case BMI_REL: //branch if condition holds, 2 bytes long
+        {
+            DBG_TRACE(BMI_REL);
+            sword operand = getRelOp(cpu);
+            cpu->PC += 2;                   //target next instruction, if branch is taken, we'll jump from here
+            bmi(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case BNE_REL: //branch if condition holds, 2 bytes long
+        {
+            DBG_TRACE(BNE_REL);
+            sword operand = getRelOp(cpu);
+            cpu->PC += 2;                   //target next instruction, if branch is taken, we'll jump from here
+            bne(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case BPL_REL: //branch if condition holds, 2 bytes long
+        {
+            DBG_TRACE(BPL_REL);
+            sword operand = getRelOp(cpu);
+            cpu->PC += 2;                   //target next instruction, if branch is taken, we'll jump from here
+            bpl(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case BVC_REL: //branch if condition holds, 2 bytes long
+        {
+            DBG_TRACE(BVC_REL);
+            sword operand = getRelOp(cpu);
+            cpu->PC += 2;                   //target next instruction, if branch is taken, we'll jump from here
+            bvc(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        case BVS_REL: //branch if condition holds, 2 bytes long
+        {
+            DBG_TRACE(BVS_REL);
+            sword operand = getRelOp(cpu);
+            cpu->PC += 2;                   //target next instruction, if branch is taken, we'll jump from here
+            bvs(cpu, operand);
+            return CPU_STEP_OK;
+        }
+
+        //############################# STACK INSTRUCTIONS #############################
+        case PHA_IMPL: //push A, 1 byte long
+        {
+            DBG_TRACE(PHA_IMPL);
+            cpu->PC++;
+            pha(cpu);
+            return CPU_STEP_OK;
+        }
+
+        case PLA_IMPL: //pull A, 1 byte long
+        {
+            DBG_TRACE(PLA_IMPL);
+            cpu->PC++;
+            pla(cpu);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(w);
-    setZByWord(w); 
-}
+        case PHP_IMPL: //push P, 1 byte long
+        {
+            DBG_TRACE(PHP_IMPL);
+            cpu->PC++;
+            php(cpu);
+            return CPU_STEP_OK;
+        }
 
-//A <-- A & operand
-//affects N, Z
-void and(word operand)
-{
-    cpu->A = cpu->A & operand;
+        case PLP_IMPL: //pull P, 1 byte long
+        {
+            DBG_TRACE(PLP_IMPL);
+            cpu->PC++;
+            plp(cpu);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(cpu->A);
-    setZByWord(cpu->A);
-}
+        //############################# MISC INSTRUCTIONS #############################
+        case NOP_IMPL: //do nothing, 1 byte long
+        {
+            DBG_TRACE(NOP_IMPL);
+            cpu->PC++;
+            return CPU_STEP_OK;
+        }
 
-//A <-- A | operand
-//affects N, Z
-void ora(word operand)
-{
-    cpu->A = cpu->A | operand;
+        case RTI_IMPL: //pull P and PC, 1 byte long
+        {
+            DBG_TRACE(RTI_IMPL);
+            cpu->PC++;
+            rti_impl(cpu);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(cpu->A);
-    setZByWord(cpu->A);
-}
+        case BRK_IMPL: //software interrupt, 1 byte long plus padding byte
+        {
+            DBG_TRACE(BRK_IMPL);
+            cpu->PC++;
+            brk_impl(cpu);
+            return CPU_STEP_OK;
+        }
 
-//A <-- A ^ operand
-//affects N, Z
-void eor(word operand)
-{
-    cpu->A = cpu->A ^ operand;
+#ifdef CPU_CMOS
+        //############################# 65C02 INSTRUCTIONS #############################
+        case BRA_REL: //branch always, 2 bytes long
+        {
+            DBG_TRACE(BRA_REL);
+            sword operand = getRelOp(cpu);
+            cpu->PC += 2;                   //target next instruction, we'll jump from here
+            branch(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    setNByWord(cpu->A);
-    setZByWord(cpu->A);
-}
+        case PHX_IMPL: //push X, 1 byte long
+        {
+            DBG_TRACE(PHX_IMPL);
+            cpu->PC++;
+            phx(cpu);
+            return CPU_STEP_OK;
+        }
 
-//A - M (compute difference = compare)
-//affects N, Z, C
-void cmp (word operand)
-{
-    int diff = (int)cpu->A - (int)operand;
+        case PHY_IMPL: //push Y, 1 byte long
+        {
+            DBG_TRACE(PHY_IMPL);
+            cpu->PC++;
+            phy(cpu);
+            return CPU_STEP_OK;
+        }
 
-    if (diff == 0)
-    {
-        setCByFlag(1);
-        setZByFlag(1);
-        return;
-    }
+        case PLX_IMPL: //pull X, 1 byte long
+        {
+            DBG_TRACE(PLX_IMPL);
+            cpu->PC++;
+            plx(cpu);
+            return CPU_STEP_OK;
+        }
 
-    if (diff > 0)
-    {
-        setCByFlag(1);
-        return;
-    }
+        case PLY_IMPL: //pull Y, 1 byte long
+        {
+            DBG_TRACE(PLY_IMPL);
+            cpu->PC++;
+            ply(cpu);
+            return CPU_STEP_OK;
+        }
 
-    if (diff < 0)
-    {
-        setNByFlag(1);
-        return;
-    }
-}
+        case STZ_ZRP: //0 -> M in zeropage, 2 bytes long
+        {
+            DBG_TRACE(STZ_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            stz(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-                        
-//C <-- 1
-//affects C
-void sec(void)
-{
-    setCByFlag(1); //set C
-}
+        case STZ_ZRPX: //0 -> M in zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(STZ_ZRPX);
+            address a = getZrpXAddr(cpu);
+            cpu->PC += 2;
+            stz(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//D <-- 1
-//affects D
-void sed(void)
-{
-    setDByFlag(1); //set D
-}
+        case STZ_ABS: //0 -> M at [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(STZ_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            stz(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//I <-- 1
-//affects I
-void sei(void)
-{
-    setIByFlag(1); //set I
-}
+        case STZ_ABSX: //0 -> M at [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(STZ_ABSX);
+            address a = getAbsXAddr(cpu);
+            cpu->PC += 3;
+            stz(cpu, a);
+            return CPU_STEP_OK;
+        }
 
+        case TSB_ZRP: //M <- M | A in zeropage, 2 bytes long
+        {
+            DBG_TRACE(TSB_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            tsb(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//C <-- 0
-//affects C
-void clc(void)
-{
-    setCByFlag(0); //clear C
-}
+        case TSB_ABS: //M <- M | A at [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(TSB_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            tsb(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//D <-- 0
-//affects D
-void cld(void)
-{
-    setDByFlag(0); //clear D
-}
+        case TRB_ZRP: //M <- M & ~A in zeropage, 2 bytes long
+        {
+            DBG_TRACE(TRB_ZRP);
+            address a = getZrpAddr(cpu);
+            cpu->PC += 2;
+            trb(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//I <-- 0
-//affects I
-void cli(void)
-{
-    setIByFlag(0); //clear I
-}
+        case TRB_ABS: //M <- M & ~A at [PChi,PClo], 3 bytes long
+        {
+            DBG_TRACE(TRB_ABS);
+            address a = getAbsAddr(cpu);
+            cpu->PC += 3;
+            trb(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-//V <-- 0
-//affects V
-void clv(void)
-{
-    setVByFlag(0); //clear V
-}
+        case INC_ACCU: //A <- A + 1, 1 byte long
+        {
+            DBG_TRACE(INC_ACCU);
+            cpu->PC++;
+            inc_accu(cpu);
+            return CPU_STEP_OK;
+        }
 
-//jump to new location
-//3 bytes long
-//no flags affected
-void jmp(address a)
-{
-    cpu->PC = a;
-}
+        case DEC_ACCU: //A <- A - 1, 1 byte long
+        {
+            DBG_TRACE(DEC_ACCU);
+            cpu->PC++;
+            dec_accu(cpu);
+            return CPU_STEP_OK;
+        }
 
+        case BIT_IMMD: //A & M, 2 bytes long
+        {
+            DBG_TRACE(BIT_IMMD);
+            word operand = getImdOp(cpu);
+            cpu->PC += 2;
+            bit_immd(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
+        case BIT_ZRPX: //A & M from zeropage+X, 2 bytes long
+        {
+            DBG_TRACE(BIT_ZRPX);
+            word operand = getZrpXOp(cpu);
+            cpu->PC += 2;
+            bit(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//jump to subroutine: push PC to stack and load PC with jump address a
-//note: JSR instruction increments the PC only by 2 (according to real HW implementation)
-//the PC is incremented to proper address later by corresponding RTS
-//no flags affected
-void jsr(address a)
-{
-    memWrite(mem, (cpu->PC & 0xFF00)>>2, cpu->SP);  //push PC-HI to stack
+        case BIT_ABSX: //A & M from [PChi,PClo]+X, 3 bytes long
+        {
+            DBG_TRACE(BIT_ABSX);
+            word operand = getAbsXOp(cpu);
+            cpu->PC += 3;
+            bit(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    cpu->SP--;                       //point to next free stack location
+        case JMP_AXIND: //PC <- M from [[PChi,PClo]+X], 3 bytes long
+        {
+            DBG_TRACE(JMP_AXIND);
+            address a = getAXIndAddr(cpu);
+            cpu->PC += 3;
+            jmp(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-    memWrite(mem, cpu->PC & 0x00FF, cpu->SP);       //push PC-LO to stack
+        case ORA_ZIND: //A <- A | M from [[zeropage]], 2 bytes long
+        {
+            DBG_TRACE(ORA_ZIND);
+            word operand = getZIndOp(cpu);
+            cpu->PC += 2;
+            ora(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    cpu->SP--;                       //point to next free stack location
-    
-    cpu->PC = a;                     //store jump address to PC
+        case AND_ZIND: //A <- A & M from [[zeropage]], 2 bytes long
+        {
+            DBG_TRACE(AND_ZIND);
+            word operand = getZIndOp(cpu);
+            cpu->PC += 2;
+            and(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    //pushing beyond MAX?
-    warnStackOverflow("JSR", cpu->PC-2);
-}
+        case EOR_ZIND: //A <- A ^ M from [[zeropage]], 2 bytes long
+        {
+            DBG_TRACE(EOR_ZIND);
+            word operand = getZIndOp(cpu);
+            cpu->PC += 2;
+            eor(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-//return from subroutine: pull previously saved PC value from stack and loat it into PC register
-//note: after pulling the PC from stack it must be incremented (according to real HW implementation)
-//no flags affected
-void rts(void)
-{    
-    cpu->SP++;                       //target value on stack that will be pulled
+        case ADC_ZIND: //A <- A + M + C from [[zeropage]], 2 bytes long
+        {
+            DBG_TRACE(ADC_ZIND);
+            word operand = getZIndOp(cpu);
+            cpu->PC += 2;
+            adc(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    word pclo = memRead(mem, cpu->SP);        //pull value from stack, the value should be LO byte of the previously pushed PC register
-    
-    cpu->SP++;                       //target next stack value that will be pulled
-    
-    word pchi = memRead(mem, cpu->SP);        //pull value from stack, the value should be HI byte of the previously pushed PC register
+        case STA_ZIND: //A -> M at [[zeropage]], 2 bytes long
+        {
+            DBG_TRACE(STA_ZIND);
+            address a = getZIndAddr(cpu);
+            cpu->PC += 2;
+            sta(cpu, a);
+            return CPU_STEP_OK;
+        }
 
-    cpu->PC = lohi2addr(pclo, pchi); //from LO byte and HI byte, construct address and store it into PC register (PC is then restored after JSR)
+        case LDA_ZIND: //A <- M from [[zeropage]], 2 bytes long
+        {
+            DBG_TRACE(LDA_ZIND);
+            word operand = getZIndOp(cpu);
+            cpu->PC += 2;
+            lda(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
-    //pulling beyond MIN?
-    warnStackUnderflow("RTS", cpu->PC);
-}
+        case CMP_ZIND: //A - M from [[zeropage]], 2 bytes long
+        {
+            DBG_TRACE(CMP_ZIND);
+            word operand = getZIndOp(cpu);
+            cpu->PC += 2;
+            cmp(cpu, operand);
+            return CPU_STEP_OK;
+        }
 
+        case SBC_ZIND: //A <- A - M - !C from [[zeropage]], 2 bytes long
+        {
+            DBG_TRACE(SBC_ZIND);
+            word operand = getZIndOp(cpu);
+            cpu->PC += 2;
+            sbc(cpu, operand);
+            return CPU_STEP_OK;
+        }
+#endif
 
-//X <- M
-//affects N and Z
-void ldx(word operand)
-{
-    cpu->X = operand;
+        default: //invalid instruction
+        { 
+            logMessage("\nError: unknown instruction: 0x%X at 0x%.4X.\n", cpu->IR, cpu->PC);
+            return CPU_STEP_ERROR;
+        }            
+        
+	} //switch IR
     
-    //set flags
-    setNByWord(cpu->X);
-    setZByWord(cpu->X);    
 }
 
-//Y <- M
-//affects N and Z
-void ldy(word operand)
+//execute instructions until at least the given number of cycles has elapsed, stops early if a step fails
+//a slice ends at the next event deadline, events and interrupts are handled in between slices only
+//opcode at PC, read without side effects on devices
+static inline word peekOpcode(T6502 cpu)
 {
-    cpu->Y = operand;
-    
-    //set flags
-    setNByWord(cpu->Y);
-    setZByWord(cpu->Y);    
+    const word* page = cpu->mem->read[cpu->PC >> 8];
+    return (page != NULL) ? page[cpu->PC & 0xFF] : memPeek(cpu->mem, cpu->PC);
 }
 
-//branch to PC+operand if C is 0
-//2 bytes long, no flags affected
-void bcc(sword operand)
-{    
-    if (getC() == 0)
+//run the current slice; check_breakpoints and hooked are constants, so the compiler builds a separate loop
+//per combination: the plain loop has neither breakpoint tests nor hook calls, they cost nothing while unused
+static inline __attribute__((always_inline)) eCpuStepStatus runSlice(T6502 cpu, int check_breakpoints, int hooked, uint64_t first)
+{
+    while (cpu->cycles < cpu->slice_end)
     {
-        //branch taken, add signed offset to jump to current position + offset, which is in [-128, 127]
-        cpu->PC = (address) ((int) cpu->PC + operand);
-    }
-}
+        //breakpoints and BRK with stop_on_brk stop before anything records or instruments the instruction
+        if (check_breakpoints && cpu->instructions != first)
+        {
+            if (cpuIsBreakpoint(cpu, cpu->PC) && cpuStop(cpu, CPU_STOP_BREAKPOINT, cpu->PC)) return CPU_STEP_BREAK;
+            if (cpu->stop_on_brk && peekOpcode(cpu) == BRK_IMPL && cpuStop(cpu, CPU_STOP_BRK, cpu->PC)) return CPU_STEP_BREAK;
+        }
 
-//branch to PC+operand if C is 1
-//2 bytes long, no flags affected
-void bcs(sword operand)
-{    
-    if (getC() == 1)
-    {
-        //branch taken, add signed offset to jump to current position + offset, which is in [-128, 127]
-        cpu->PC = (address) ((int) cpu->PC + operand);
-    }
-}
+        COV_TRACE(cpu);
+        BIN_TRACE(cpu);
+        PROF_ENTER(cpu);
+        if (hooked) hookInstruction(cpu, HOOK_PRE);
 
-//branch to PC+operand if Z is 1
-//2 bytes long, no flags affected
-void beq(sword operand)
-{    
-    if (getZ() == 1)
-    {
-        //branch taken, add signed offset to jump to current position + offset, which is in [-128, 127]
-        cpu->PC = (address) ((int) cpu->PC + operand);
-    }
-}
+        eCpuStepStatus status = cpuStep(cpu);
+        if (status != CPU_STEP_OK) return status;
 
-//branch to PC+operand if N is 1
-//2 bytes long, no flags affected
-void bmi(sword operand)
-{    
-    if (getN() == 1)
-    {
-        //branch taken, add signed offset to jump to current position + offset, which is in [-128, 127]
-        cpu->PC = (address) ((int) cpu->PC + operand);
+        if (hooked) hookInstruction(cpu, HOOK_POST);
+        PROF_LEAVE(cpu);
     }
+    return CPU_STEP_OK;
 }
 
-//branch to PC+operand if Z is 0
-//2 bytes long, no flags affected
-void bne(sword operand)
-{
-    if (getZ() == 0)
-    {
-        //branch taken, add signed offset to jump to current position + offset, which is in [-128, 127]
-        cpu->PC = (address) ((int) cpu->PC + operand);
-    }    
-}
-
-//branch to PC+operand if N is 0
-//2 bytes long, no flags affected
-void bpl(sword operand)
+//loop variant with hooks, kept out of line so the hook calls do not get in the way of the plain loop
+static __attribute__((noinline)) eCpuStepStatus runHookedSlice(T6502 cpu, uint64_t first)
 {
-    if (getN() == 0)
-    {
-        //branch taken, add signed offset to jump to current position + offset, which is in [-128, 127]
-        cpu->PC = (address) ((int) cpu->PC + operand);
-    }    
+    return runSlice(cpu, 1, 1, first);
 }
 
-//branch to PC+operand if V is 0
-//2 bytes long, no flags affected
-void bvc(sword operand)
+eCpuStepStatus cpuRun(T6502 cpu, uint64_t cycles)
 {
-    if (getV() == 0)
-    {
-        //branch taken, add signed offset to jump to current position + offset, which is in [-128, 127]
-        cpu->PC = (address) ((int) cpu->PC + operand);
-    }    
-}
+    uint64_t end = cpu->cycles + cycles;
+    //running on from a breakpoint or BRK stop: the instruction there is executed, its stop is skipped
+    int resume = ((cpu->stop == CPU_STOP_BREAKPOINT || cpu->stop == CPU_STOP_BRK) && cpu->stop_addr == cpu->PC);
+    uint64_t first = resume ? cpu->instructions : UINT64_MAX;
+    cpu->stop = CPU_STOP_NONE;
 
-//branch to PC+operand if V is 1
-//2 bytes long, no flags affected
-void bvs(sword operand)
-{
-    if (getV() == 1)
+    while (cpu->cycles < end)
     {
-        //branch taken, add signed offset to jump to current position + offset, which is in [-128, 127]
-        cpu->PC = (address) ((int) cpu->PC + operand);
-    }    
-}
+        //a JSR to a routine with a native handler ended the last slice
+        if (cpu->hle != NULL && cpu->hle->pending >= 0) hleCall(cpu);
+
+        //slice boundary: the only place where events and interrupts are looked at,
+        //events first because they may raise an interrupt
+        schedDispatch(&cpu->sched, cpu->cycles);
+        if (cpuInterrupt(cpu)) first = UINT64_MAX;  //the handler's first instruction may stop
+
+        uint64_t next = schedNext(&cpu->sched);
+        cpu->slice_end = (next < end) ? next : end;
+
+        eCpuStepStatus status;
+        if (cpu->hooks != NULL) status = runHookedSlice(cpu, first);
+        else if (cpu->breakpoint_count == 0 && !cpu->stop_on_brk) status = runSlice(cpu, 0, 0, first);
+        else status = runSlice(cpu, 1, 0, first);
+        if (status != CPU_STEP_OK) return status;
+        if (cpu->stop) return CPU_STEP_BREAK;
+    }
 
-//push A to stack, i.e. mem[SP] <- A
-//no flags affected
-void pha(void)
-{
-    memWrite(mem, cpu->A, cpu->SP);     //push A to stack
-    cpu->SP--;           //point to next free stack location
-    
-    warnStackOverflow("PHA", cpu->PC-1); //pushing beyond MAX?
+    return CPU_STEP_OK;
 }
 
-//pull value from stack into A, i.e. A <- mem[SP+1]
-//affects N and Z
-void pla(void)
+int cpuStop(T6502 cpu, eCpuStop reason, address a)
 {
-    cpu->SP++;           //target value on top of the stack
+    if (cpu->break_fn != NULL && !cpu->break_fn(cpu->break_ctx, reason, a)) return 0;
 
-    cpu->A = memRead(mem, cpu->SP);    //copy value from stack into A, value in SP is free to be overwritten by next push operation
-
-    //set flags
-    setNByWord(cpu->A);
-    setZByWord(cpu->A); 
-
-    warnStackUnderflow("PLP", cpu->PC-1); //pushing beyond MIN?
+    cpu->stop = reason;
+    cpu->stop_addr = a;
+    cpu->slice_end = cpu->cycles;   //cpuRun looks at it after the current instruction
+    return 1;
 }
 
-//push P to stack, i.e. mem[SP] <- P
-//no flags affected
-void php(void)
+void cpuSetBreakHandler(T6502 cpu, TBreakFn fn, void* ctx)
 {
-    memWrite(mem, cpu->P, cpu->SP); //push P to stack
-    cpu->SP--;       //point to next free stack location
-
-    warnStackOverflow("PHP", cpu->PC-1); //pushing beyond MAX?
+    cpu->break_fn = fn;
+    cpu->break_ctx = ctx;
 }
 
-//pull value from stack into P, i.e. P <- mem[SP+1]
-//affects all bits in P, because a new value is fetched into P
-void plp(void)
+void cpuSetBreakpoint(T6502 cpu, address pc, int set)
 {
-    cpu->SP++;        //target value on top of the stack
-
-    cpu->P = memRead(mem, cpu->SP); //copy value from stack into P, value in cpu->cpu->cpu->SP is free to be overwritten by next push operation
-
-    warnStackUnderflow("PLP", cpu->PC-1); //pushing beyond MIN?
+    word bit = 1 << (pc & 7);
+    if (set && !(cpu->breakpoints[pc >> 3] & bit))
+    {
+        cpu->breakpoints[pc >> 3] |= bit;
+        cpu->breakpoint_count++;
+    }
+    else if (!set && (cpu->breakpoints[pc >> 3] & bit))
+    {
+        cpu->breakpoints[pc >> 3] &= ~bit;
+        cpu->breakpoint_count--;
+    }
 }
-                 
-
-
-#endif
\ No newline at end of file
@@ -4,8 +4,41 @@
 
 #include "types.h"
 #include "mem.h"
+#include "sched.h"
+#include "variant.h"
 
 
+#define CPU_ENGINE "switch"  //dispatch engine of cpuStep/cpuRun, reported by the measurement tools together with CPU_VARIANT
+
+#define FLIGHT_SIZE 4096    //flight recorder length in instructions, must be a power of 2
+
+//flight recorder entry: an executed instruction and the registers before it ran, 8 bytes
+typedef struct
+{
+    address pc;
+    word    opcode;
+    word    a;
+    word    x;
+    word    y;
+    word    p;
+    word    sp;     //lo byte of the stack pointer
+} TFlightEntry;
+
+//why cpuRun stopped with CPU_STEP_BREAK
+typedef enum
+{
+    CPU_STOP_NONE = 0,
+    CPU_STOP_BREAKPOINT,    //PC breakpoint, the instruction at stop_addr (= PC) was not executed
+    CPU_STOP_WATCH_READ,    //read of watched address stop_addr, the instruction has completed
+    CPU_STOP_WATCH_WRITE,   //write of watched address stop_addr, the instruction has completed
+    CPU_STOP_REQUEST,       //cpuStop called without a specific reason, e.g. by a debugger front end
+    CPU_STOP_BRK,           //BRK at stop_addr (= PC) with stop_on_brk set, it was not executed (like a breakpoint)
+    CPU_STOP_HALT           //jump-to-self or branch-to-self at stop_addr with halt_check set and no interrupt to come
+} eCpuStop;
+
+//break handler: called on every breakpoint and watchpoint hit, returns 1 to stop cpuRun, 0 to run on
+typedef int (*TBreakFn)(void* ctx, eCpuStop reason, address a);
+
 typedef struct 
 {
     word 	X;      //X indexing register
@@ -15,7 +48,26 @@ typedef struct
     word 	IR;     //instruction register, contains instruction to be decoded, i.e. IR == mrd(PC)
     address SP;     //6502's stack has a range of 256 and is hard wired to 2nd memory page 0100 to 01FF (9 bit address)
     address PC;     //program counter, NOTE: PC contains always the instruction to be fetched next !!!
+    uint64_t cycles;        //elapsed clock cycles since reset
+    uint64_t instructions;  //executed instructions since reset
+    uint64_t slice_end;     //cpuRun checks interrupts when cycles reach this, set to cycles to end a slice early
+    word    irq;            //IRQ line, bitmask of the sources currently asserting it (level triggered)
+    word    nmi;            //NMI line, 1 while asserted
+    word    nmi_pending;    //NMI line got asserted (edge), interrupt not taken yet
     TMemory mem;
+    SchedStruct sched;      //device and timer events, see cpuSchedule
+    eCpuStop stop;          //cpuRun returns CPU_STEP_BREAK at the end of the instruction if set, see cpuStop
+    address stop_addr;      //address of the breakpoint or watchpoint hit
+    TBreakFn break_fn;      //break handler, NULL: every hit stops
+    void*   break_ctx;
+    dword   breakpoint_count;               //cpuRun looks at breakpoints only if there are any
+    word    breakpoints[MEMSIZE / 8];       //PC breakpoint bitmap, bit (pc & 7) of byte pc >> 3
+    struct HooksStruct* hooks;              //instrumentation hooks (hooks.h), NULL while none are registered
+    struct HleStruct* hle;                  //native handlers for known routines (hle.h), NULL while none are registered
+    word    stop_on_brk;    //BRK stops the run instead of taking the IRQ vector (CPU_STOP_BRK)
+    word    halt_check;     //a loop on itself stops the run when nothing can interrupt it (CPU_STOP_HALT)
+    word    stack_dumped;   //a stack wrap wrote its crash dump since the last reset, later wraps only warn
+    TFlightEntry flight[FLIGHT_SIZE];   //last executed instructions, entry of instruction n is flight[n % FLIGHT_SIZE]
 } CpuStruct;
 
 typedef CpuStruct* T6502; 
@@ -23,15 +75,62 @@ typedef CpuStruct* T6502;
 typedef enum 
 {
     CPU_STEP_OK = 0, 
-    CPU_STEP_ERROR = 1
+    CPU_STEP_ERROR = 1,
+    CPU_STEP_BREAK = 2      //cpuRun stopped at a breakpoint or watchpoint, cpu->stop and cpu->stop_addr tell which
 } eCpuStepStatus;
 
 T6502 cpuInit(TMemory mem);
 
+void cpuReset(T6502 cpu);
+
 //void cpuConnectMemory(TMemory _mem);
 
 eCpuStepStatus cpuStep(T6502 cpu);
 
+//execute instructions until at least the given number of cycles has elapsed
+//due events and pending interrupts are handled at slice boundaries, i.e. before the first instruction, at
+//the next event deadline and whenever the interrupt state changed (cpuSetIrq, cpuSetNmi, I flag cleared
+//while IRQ is asserted)
+eCpuStepStatus cpuRun(T6502 cpu, uint64_t cycles);
+
+//set (1) or clear (0) a breakpoint: cpuRun stops with CPU_STEP_BREAK before executing an instruction at pc,
+//also on the first instruction of a call; only a call that runs on from a stop at this very breakpoint
+//(cpu->stop still CPU_STOP_BREAKPOINT at PC) executes the instruction
+void cpuSetBreakpoint(T6502 cpu, address pc, int set);
+
+//1 if there is a breakpoint at pc
+static inline int cpuIsBreakpoint(T6502 cpu, address pc)
+{
+    return (cpu->breakpoints[pc >> 3] >> (pc & 7)) & 1;
+}
+
+//report a breakpoint or watchpoint hit (or request a stop): unless the break handler lets the run go on,
+//cpuRun returns CPU_STEP_BREAK after the current instruction; returns 1 if the CPU stops
+int cpuStop(T6502 cpu, eCpuStop reason, address a);
+
+//set break handler fn(ctx, reason, address), NULL to stop on every hit
+void cpuSetBreakHandler(T6502 cpu, TBreakFn fn, void* ctx);
+
+//call fn(ctx, when) once cycles reach when (absolute), returns 0 on success
+//may be called from event callbacks and while an instruction executes: the current slice ends early if needed
+int cpuSchedule(T6502 cpu, uint64_t when, TEventFn fn, void* ctx);
+
+//remove all scheduled events with the given callback and context
+void cpuUnschedule(T6502 cpu, TEventFn fn, void* ctx);
+
+//take a pending NMI, or IRQ if not masked by I, returns 1 if an interrupt was taken (cpuStep users call it in between steps)
+int cpuInterrupt(T6502 cpu);
+
+//assert (1) or release (0) the IRQ line for a source, a bit in the range 0x01..0x80
+void cpuSetIrq(T6502 cpu, word source, int asserted);
+
+//assert (1) or release (0) the NMI line, an interrupt is triggered on assertion only
+void cpuSetNmi(T6502 cpu, int asserted);
+
+#define VECTOR_NMI   0xFFFA
+#define VECTOR_RESET 0xFFFC
+#define VECTOR_IRQ   0xFFFE  //IRQ and BRK
+
 //TODO MOVE THE STUFF BELOW TO C FILE !!!!!!!!!!!!!!!!!!!!!!!!!!!
 //!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!! ???
 
@@ -218,7 +317,7 @@ eCpuStepStatus cpuStep(T6502 cpu);
                  
 #define RTS_IMPL    0x60
                 
-#define RTI_IMPL    0x40
+#define RTI_IMPL    0x40    //done
                 
 //BRANCH INSTRUCTIONS
 #define BCC_REL     0x90    //done
@@ -249,129 +348,167 @@ eCpuStepStatus cpuStep(T6502 cpu);
 //MISC INSTRUCTIONS
 #define NOP_IMPL    0xEA	//done
                 
-#define BRK_IMPL    0x00
+#define BRK_IMPL    0x00    //done
+
+//65C02 INSTRUCTIONS (CPU_CMOS builds only)
+#define BRA_REL     0x80    //branch always
+#define PHX_IMPL    0xDA
+#define PHY_IMPL    0x5A
+#define PLX_IMPL    0xFA
+#define PLY_IMPL    0x7A
+#define STZ_ZRP     0x64    //store zero
+#define STZ_ZRPX    0x74
+#define STZ_ABS     0x9C
+#define STZ_ABSX    0x9E
+#define TSB_ZRP     0x04    //test and set bits of A in M
+#define TSB_ABS     0x0C
+#define TRB_ZRP     0x14    //test and reset bits of A in M
+#define TRB_ABS     0x1C
+#define INC_ACCU    0x1A
+#define DEC_ACCU    0x3A
+#define BIT_IMMD    0x89    //affects Z only
+#define BIT_ZRPX    0x34
+#define BIT_ABSX    0x3C
+#define JMP_AXIND   0x7C    //JMP ($xxxx,X)
+#define ORA_ZIND    0x12    //(zp) indirect, like (zp),Y without Y
+#define AND_ZIND    0x32
+#define EOR_ZIND    0x52
+#define ADC_ZIND    0x72
+#define STA_ZIND    0x92
+#define LDA_ZIND    0xB2
+#define CMP_ZIND    0xD2
+#define SBC_ZIND    0xF2
 
 
 //TRANSFER INSTRUCTIONS (single byte instructions, operand addr is implied by opcode)
-void tax(T6502 cpu);		//transfer A to X
-void txa(void);    	//transfer X to A              
-void tay(void);    	//transfer A to Y
-void tya(void);    	//transfer Y to A                
-void tsx(void);    	//(tansfer stack pointer to X) 
-void txs(void);    	//(tansfer X to stack pointer) NOTE: Although many instructions modify the value of the Stack Pointer, TXS is the only way to set it to a specified value.             
+void tax(T6502 cpu);    //transfer A to X
+void txa(T6502 cpu);    //transfer X to A              
+void tay(T6502 cpu);    //transfer A to Y
+void tya(T6502 cpu);    //transfer Y to A                
+void tsx(T6502 cpu);    //(tansfer stack pointer to X) 
+void txs(T6502 cpu);    //(tansfer X to stack pointer) NOTE: Although many instructions modify the value of the Stack Pointer, TXS is the only way to set it to a specified value.             
 
 //STORAGE INSTRUCTIONS
-void lda(word operand);
-void ldx(word operand);
-void ldy(word operand);
-void sta(address a);
-void stx(address a);
-void sty(address a);
+void lda(T6502 cpu, word operand);
+void ldx(T6502 cpu, word operand);
+void ldy(T6502 cpu, word operand);
+void sta(T6502 cpu, address a);
+void stx(T6502 cpu, address a);
+void sty(T6502 cpu, address a);
                 						
 //ARITHMETIC INSTRUCTIONS
-void adc(word operand);
-void sbc(word operand);
+void adc(T6502 cpu, word operand);
+void sbc(T6502 cpu, word operand);
                 
-void inc(address a);  
+void inc(T6502 cpu, address a);  
                 
-void inx    (void);  
+void inx(T6502 cpu);  
                 
-void iny    (void);  
+void iny(T6502 cpu);  
                 
-void dec(address a);  
+void dec(T6502 cpu, address a);  
                 
-void dex    (void);  
+void dex(T6502 cpu);  
                                 
-void dey    (void);  
+void dey(T6502 cpu);  
                 
                 
 //SHIFT & ROTATE INSTRUCTIONS
-void asl_accu(void); //done                 
-void asl(address a); //done
+void asl_accu(T6502 cpu); //done                 
+void asl(T6502 cpu, address a); //done
                  
-void lsr_accu(void); //done                
-void lsr(address a); //done
+void lsr_accu(T6502 cpu); //done                
+void lsr(T6502 cpu, address a); //done
 
-void rol_accu(void); //done              
-void rol(address a); //done
+void rol_accu(T6502 cpu); //done              
+void rol(T6502 cpu, address a); //done
                 
-void ror_accu (void);//done               
-void ror(address a); //done
+void ror_accu(T6502 cpu); //done               
+void ror(T6502 cpu, address a); //done
                 
 //LOGIC INSTRUCTIONS
-void and(word operand);    
+void and(T6502 cpu, word operand);    
                 
-void ora(word operand);
+void ora(T6502 cpu, word operand);
                                 
-void eor(word operand);
+void eor(T6502 cpu, word operand);
                 
 //COMPARE AND TEST BIT INSTRUCTIONS
-void cmp (word operand);                                  
+void cmp(T6502 cpu, word operand);                                  
                
-void cpx_immd    (void);                                  
-void cpx_zrp     (void);                                  
-void cpx_abs     (void);                                  
+void cpx(T6502 cpu, word operand);                                  
                 
-void cpy_immd    (void);                                  
-void cpy_zrp     (void);                                  
-void cpy_abs     (void);                                  
+void cpy(T6502 cpu, word operand);                                  
                 
-void bit_zrp     (void);                                  
-void bit_abs     (void);  
+void bit(T6502 cpu, word operand);                                  
             
 //SET AND CLEAR INSTRUCTIONS
-void sec    (void);  
+void sec(T6502 cpu);  
                
-void sed    (void);  
+void sed(T6502 cpu);  
                
-void sei	(void);  
+void sei(T6502 cpu);  
                 
-void clc    (void);
+void clc(T6502 cpu);
                 
-void cld    (void);  
+void cld(T6502 cpu);  
                 
-void cli    (void);  
+void cli(T6502 cpu);  
                 
-void clv    (void);  
+void clv(T6502 cpu);  
                 
 //JUMP AND SUBROUTINE INSTRUCTIONS
-void jmp(address a);  
+void jmp(T6502 cpu, address a);  
                 
-void jsr (address a);  
+void jsr(T6502 cpu, address a);  
               
-void rts (void);  
+void rts(T6502 cpu);  
                 
-void rti_impl    (void);  
+void rti_impl(T6502 cpu);  
+
+#ifdef CPU_CMOS
+//65C02 INSTRUCTIONS
+void phx(T6502 cpu);
+void phy(T6502 cpu);
+void plx(T6502 cpu);
+void ply(T6502 cpu);
+void stz(T6502 cpu, address a);
+void tsb(T6502 cpu, address a);
+void trb(T6502 cpu, address a);
+void inc_accu(T6502 cpu);
+void dec_accu(T6502 cpu);
+void bit_immd(T6502 cpu, word operand);
+#endif
                 
 //BRANCH INSTRUCTIONS
-void bcc(sword operand);    //done
+void bcc(T6502 cpu, sword operand);    //done
                 
-void bcs(sword operand);    //done
+void bcs(T6502 cpu, sword operand);    //done
                 
-void beq(sword operand);    //done
+void beq(T6502 cpu, sword operand);    //done
                 
-void bmi(sword operand);    //done
+void bmi(T6502 cpu, sword operand);    //done
                 
-void bne(sword operand);    //done
+void bne(T6502 cpu, sword operand);    //done
                  
-void bpl(sword operand);    //done
+void bpl(T6502 cpu, sword operand);    //done
                  
-void bvc(sword operand);    //done
+void bvc(T6502 cpu, sword operand);    //done
                 
-void bvs(sword operand);    //done
+void bvs(T6502 cpu, sword operand);    //done
                 
 //STACK INSTRUCTIONS
-void pha(void);  //done
+void pha(T6502 cpu);  //done
                  
-void pla(void);  //done
+void pla(T6502 cpu);  //done
                  
-void php(void);  //done
+void php(T6502 cpu);  //done
                 
-void plp(void);  //done
+void plp(T6502 cpu);  //done
                 
 //MISC INSTRUCTIONS
 //void nop_impl    (void); //no function needed, just don't do anything on NOP_IMPL (0xEA)  
                 
-void brk_impl    (void);  
+void brk_impl(T6502 cpu);  
                 
 #endif
\ No newline at end of file
@@ -0,0 +1,738 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "apu.h"
+#include "mem.h"
+#include "utils.h"
+
+
+#define CPU_HZ 1789773.0
+
+//linear approximation of the 2A03 mixer
+#define WEIGHT_PULSE    0.00752f
+#define WEIGHT_TRIANGLE 0.00851f
+#define WEIGHT_NOISE    0.00494f
+#define WEIGHT_DMC      0.00335f
+
+#define HIGHPASS 0.9996f            //DC blocker pole
+#define OUTPUT_SCALE 32000.0f
+
+
+typedef float v4f __attribute__((vector_size(16)));    //GCC vector extension, SSE on x86, NEON on ARM
+
+//band-limited step: kernel[phase] is added (scaled by the level change) to the delta buffer
+static v4f kernel[APU_PHASES + 1][APU_TAPS / 4];
+static pthread_once_t kernelOnce = PTHREAD_ONCE_INIT;   //APUs may be created on several threads at once
+
+static const word lengthTable[32] =
+{
+    10, 254, 20, 2, 40, 4, 80, 6, 160, 8, 60, 10, 14, 12, 26, 14,
+    12, 16, 24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30
+};
+
+static const word dutyTable[4][8] =
+{
+    { 0, 1, 0, 0, 0, 0, 0, 0 },
+    { 0, 1, 1, 0, 0, 0, 0, 0 },
+    { 0, 1, 1, 1, 1, 0, 0, 0 },
+    { 1, 0, 0, 1, 1, 1, 1, 1 }
+};
+
+static const word triangleTable[32] =
+{
+    15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+static const dword noisePeriods[16] = { 4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068 };
+
+static const dword dmcPeriods[16] = { 428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54 };
+
+//NTSC frame sequencer steps in CPU cycles after the start of the sequence
+static const dword frameSteps[2][5] =
+{
+    { 7457, 14913, 22371, 29829, 0 },
+    { 7457, 14913, 22371, 29829, 37281 }
+};
+static const dword frameLength[2] = { 29830, 37282 };
+static const word frameStepCount[2] = { 4, 5 };
+
+
+//windowed sinc, normalized per phase so a step of 1 adds up to exactly 1
+static void initKernel(void)
+{
+    for (int p = 0; p <= APU_PHASES; p++)
+    {
+        float taps[APU_TAPS];
+        float sum = 0;
+
+        for (int k = 0; k < APU_TAPS; k++)
+        {
+            double x = k - APU_TAPS / 2 + 1 - (double)p / APU_PHASES;
+            double s = (fabs(x) < 1e-9) ? 1.0 : sin(M_PI * 0.9 * x) / (M_PI * 0.9 * x);
+            double w = 0.42 + 0.5 * cos(M_PI * x / (APU_TAPS / 2)) + 0.08 * cos(2 * M_PI * x / (APU_TAPS / 2)); //Blackman
+            taps[k] = (float)(s * ((fabs(x) < APU_TAPS / 2) ? w : 0));
+            sum += taps[k];
+        }
+        for (int k = 0; k < APU_TAPS; k++) kernel[p][k / 4][k % 4] = taps[k] / sum;
+    }
+}
+
+//add band-limited step of height delta at cycle t to the delta buffer
+static void addStep(TApu apu, uint64_t t, float delta)
+{
+    double pos = (t - apu->buf_time) * apu->ratio;
+    if (pos < 0) pos = 0;
+
+    uint32_t i = (uint32_t)pos;
+    uint32_t phase = (uint32_t)((pos - i) * APU_PHASES);
+    v4f d = { delta, delta, delta, delta };
+
+    for (int k = 0; k < APU_TAPS / 4; k++)
+    {
+        v4f b;
+        memcpy(&b, &apu->buf[i + 4 * k], sizeof(b));
+        b += kernel[phase][k] * d;
+        memcpy(&apu->buf[i + 4 * k], &b, sizeof(b));
+    }
+}
+
+//channel output changed to level at cycle t
+static void setLevel(TApu apu, TApuTimer* timer, int level, uint64_t t)
+{
+    if (level == timer->level) return;
+    addStep(apu, t, (level - timer->level) * timer->weight);
+    timer->level = level;
+}
+
+static word envelopeVolume(const TApuEnvelope* env)
+{
+    return env->constant ? env->volume : env->decay;
+}
+
+static void clockEnvelope(TApuEnvelope* env)
+{
+    if (env->start)
+    {
+        env->start = 0;
+        env->decay = 15;
+        env->divider = env->volume;
+    }
+    else if (env->divider == 0)
+    {
+        env->divider = env->volume;
+        if (env->decay > 0) env->decay--;
+        else if (env->loop) env->decay = 15;
+    }
+    else env->divider--;
+}
+
+//############################# CHANNELS #############################
+
+static dword sweepTarget(const TApuPulse* p)
+{
+    dword change = p->timer >> p->sweep_shift;
+    if (!p->sweep_negate) return p->timer + change;
+    if (change + p->ones_complement > p->timer) return 0;
+    return p->timer - change - p->ones_complement;
+}
+
+static int pulseLevel(const TApuPulse* p)
+{
+    if (p->length == 0 || p->timer < 8 || sweepTarget(p) > 0x7FF) return 0;
+    return dutyTable[p->duty][p->step] ? envelopeVolume(&p->env) : 0;
+}
+
+static int triangleLevel(const TApuTriangle* tr)
+{
+    return triangleTable[tr->step];
+}
+
+static int noiseLevel(const TApuNoise* n)
+{
+    if (n->length == 0 || (n->lfsr & 1)) return 0;
+    return envelopeVolume(&n->env);
+}
+
+//refill DMC sample buffer from memory
+static void dmcFetch(TApu apu)
+{
+    TApuDmc* d = &apu->dmc;
+    if (d->buffer_full || d->remaining == 0) return;
+
+    d->buffer = memPeek(apu->cpu->mem, d->address);
+    d->buffer_full = 1;
+    d->address = (d->address == 0xFFFF) ? 0x8000 : d->address + 1;
+    d->remaining--;
+
+    if (d->remaining == 0)
+    {
+        if (d->loop)
+        {
+            d->address = d->sample_address;
+            d->remaining = d->sample_length;
+        }
+        else if (d->irq_enabled)
+        {
+            //raised when synthesis gets here, i.e. at block granularity
+            apu->dmc_irq = 1;
+            cpuSetIrq(apu->cpu, APU_IRQ_DMC, 1);
+        }
+    }
+}
+
+//skip n timer clocks of a channel whose output does not change meanwhile
+static uint64_t skipClocks(TApuTimer* t, uint64_t until)
+{
+    uint64_t n = (until - t->next) / t->period + 1;
+    t->next += n * t->period;
+    return n;
+}
+
+//run the channel timers up to (including) cycle until
+static void runTimers(TApu apu, uint64_t until)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        TApuPulse* p = &apu->pulse[i];
+        if (p->t.next > until) continue;
+
+        //silent: only the sequencer position matters
+        if (p->length == 0 || envelopeVolume(&p->env) == 0 || p->timer < 8 || sweepTarget(p) > 0x7FF)
+        {
+            p->step = (p->step + skipClocks(&p->t, until)) & 7;
+            continue;
+        }
+        while (p->t.next <= until)
+        {
+            p->step = (p->step + 1) & 7;
+            setLevel(apu, &p->t, pulseLevel(p), p->t.next);
+            p->t.next += p->t.period;
+        }
+    }
+
+    TApuTriangle* tr = &apu->triangle;
+    if (tr->t.next <= until)
+    {
+        //halted (or ultrasonic, which real programs use to mute it): the level stays where it is
+        if (tr->length == 0 || tr->linear == 0 || tr->timer < 2) skipClocks(&tr->t, until);
+        else while (tr->t.next <= until)
+        {
+            tr->step = (tr->step + 1) & 31;
+            setLevel(apu, &tr->t, triangleLevel(tr), tr->t.next);
+            tr->t.next += tr->t.period;
+        }
+    }
+
+    TApuNoise* n = &apu->noise;
+    if (n->t.next <= until)
+    {
+        if (n->length == 0 || envelopeVolume(&n->env) == 0) skipClocks(&n->t, until);
+        else while (n->t.next <= until)
+        {
+            dword feedback = (n->lfsr ^ (n->lfsr >> (n->mode ? 6 : 1))) & 1;
+            n->lfsr = (n->lfsr >> 1) | (feedback << 14);
+            setLevel(apu, &n->t, noiseLevel(n), n->t.next);
+            n->t.next += n->t.period;
+        }
+    }
+
+    TApuDmc* d = &apu->dmc;
+    if (d->t.next <= until)
+    {
+        if (d->silence && !d->buffer_full && d->remaining == 0) skipClocks(&d->t, until);
+        else while (d->t.next <= until)
+        {
+            if (!d->silence)
+            {
+                int level = d->t.level;
+                if (d->shift & 1) { if (level <= 125) level += 2; }
+                else if (level >= 2) level -= 2;
+                setLevel(apu, &d->t, level, d->t.next);
+                d->shift >>= 1;
+            }
+            if (--d->bits == 0)
+            {
+                d->bits = 8;
+                d->silence = !d->buffer_full;
+                if (d->buffer_full)
+                {
+                    d->shift = d->buffer;
+                    d->buffer_full = 0;
+                    dmcFetch(apu);
+                }
+            }
+            d->t.next += d->t.period;
+        }
+    }
+}
+
+//levels may have changed by a register write or the frame sequencer
+static void updateLevels(TApu apu, uint64_t t)
+{
+    setLevel(apu, &apu->pulse[0].t, pulseLevel(&apu->pulse[0]), t);
+    setLevel(apu, &apu->pulse[1].t, pulseLevel(&apu->pulse[1]), t);
+    setLevel(apu, &apu->noise.t, noiseLevel(&apu->noise), t);
+}
+
+//############################# FRAME SEQUENCER #############################
+
+static void quarterFrame(TApu apu)
+{
+    clockEnvelope(&apu->pulse[0].env);
+    clockEnvelope(&apu->pulse[1].env);
+    clockEnvelope(&apu->noise.env);
+
+    TApuTriangle* tr = &apu->triangle;
+    if (tr->linear_reload) tr->linear = tr->linear_reload_value;
+    else if (tr->linear > 0) tr->linear--;
+    if (!tr->control) tr->linear_reload = 0;
+}
+
+static void halfFrame(TApu apu)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        TApuPulse* p = &apu->pulse[i];
+        if (p->length > 0 && !p->env.loop) p->length--;
+
+        if (p->sweep_divider == 0 && p->sweep_enabled && p->sweep_shift > 0 && p->timer >= 8 && sweepTarget(p) <= 0x7FF)
+        {
+            p->timer = sweepTarget(p);
+            p->t.period = (p->timer + 1) * 2;
+        }
+        if (p->sweep_divider == 0 || p->sweep_reload)
+        {
+            p->sweep_divider = p->sweep_period;
+            p->sweep_reload = 0;
+        }
+        else p->sweep_divider--;
+    }
+
+    if (apu->triangle.length > 0 && !apu->triangle.control) apu->triangle.length--;
+    if (apu->noise.length > 0 && !apu->noise.env.loop) apu->noise.length--;
+}
+
+//sequencer step at apu->frame_next
+static void frameStep(TApu apu)
+{
+    word mode = apu->frame_mode;
+    word step = apu->frame_step;
+
+    //5-step sequence: step 4 (index 3) does nothing
+    if (!(mode == 1 && step == 3))
+    {
+        quarterFrame(apu);
+        if (step == 1 || step == frameStepCount[mode] - 1) halfFrame(apu);
+    }
+
+    if (mode == 0 && step == 3 && !apu->frame_inhibit)
+    {
+        apu->frame_irq = 1;
+        cpuSetIrq(apu->cpu, APU_IRQ_FRAME, 1);
+    }
+
+    updateLevels(apu, apu->frame_next);
+
+    if (++apu->frame_step >= frameStepCount[mode])
+    {
+        apu->frame_step = 0;
+        apu->frame_base += frameLength[mode];
+    }
+    apu->frame_next = apu->frame_base + frameSteps[mode][apu->frame_step];
+}
+
+//############################# REGISTERS #############################
+
+static void writeRegister(TApu apu, address reg, word w, uint64_t t)
+{
+    TApuPulse* p = &apu->pulse[(reg >> 2) & 1];
+
+    switch (reg)
+    {
+        case 0x4000: case 0x4004:
+            p->duty = w >> 6;
+            p->env.loop = (w >> 5) & 1;
+            p->env.constant = (w >> 4) & 1;
+            p->env.volume = w & 0x0F;
+            break;
+        case 0x4001: case 0x4005:
+            p->sweep_enabled = w >> 7;
+            p->sweep_period = (w >> 4) & 7;
+            p->sweep_negate = (w >> 3) & 1;
+            p->sweep_shift = w & 7;
+            p->sweep_reload = 1;
+            break;
+        case 0x4002: case 0x4006:
+            p->timer = (p->timer & 0x700) | w;
+            p->t.period = (p->timer + 1) * 2;
+            break;
+        case 0x4003: case 0x4007:
+            p->timer = (p->timer & 0xFF) | ((w & 7) << 8);
+            p->t.period = (p->timer + 1) * 2;
+            if (p->enabled) p->length = lengthTable[w >> 3];
+            p->step = 0;
+            p->env.start = 1;
+            break;
+
+        case 0x4008:
+            apu->triangle.control = w >> 7;
+            apu->triangle.linear_reload_value = w & 0x7F;
+            break;
+        case 0x400A:
+            apu->triangle.timer = (apu->triangle.timer & 0x700) | w;
+            apu->triangle.t.period = apu->triangle.timer + 1;
+            break;
+        case 0x400B:
+            apu->triangle.timer = (apu->triangle.timer & 0xFF) | ((w & 7) << 8);
+            apu->triangle.t.period = apu->triangle.timer + 1;
+            if (apu->triangle.enabled) apu->triangle.length = lengthTable[w >> 3];
+            apu->triangle.linear_reload = 1;
+            break;
+
+        case 0x400C:
+            apu->noise.env.loop = (w >> 5) & 1;
+            apu->noise.env.constant = (w >> 4) & 1;
+            apu->noise.env.volume = w & 0x0F;
+            break;
+        case 0x400E:
+            apu->noise.mode = w >> 7;
+            apu->noise.t.period = noisePeriods[w & 0x0F];
+            break;
+        case 0x400F:
+            if (apu->noise.enabled) apu->noise.length = lengthTable[w >> 3];
+            apu->noise.env.start = 1;
+            break;
+
+        case 0x4010:
+            apu->dmc.irq_enabled = w >> 7;
+            apu->dmc.loop = (w >> 6) & 1;
+            apu->dmc.t.period = dmcPeriods[w & 0x0F];
+            if (!apu->dmc.irq_enabled && apu->dmc_irq)
+            {
+                apu->dmc_irq = 0;
+                cpuSetIrq(apu->cpu, APU_IRQ_DMC, 0);
+            }
+            break;
+        case 0x4011:
+            setLevel(apu, &apu->dmc.t, w & 0x7F, t);
+            break;
+        case 0x4012:
+            apu->dmc.sample_address = 0xC000 + w * 64;
+            break;
+        case 0x4013:
+            apu->dmc.sample_length = w * 16 + 1;
+            break;
+
+        case 0x4015:
+            apu->pulse[0].enabled = w & 1;
+            apu->pulse[1].enabled = (w >> 1) & 1;
+            apu->triangle.enabled = (w >> 2) & 1;
+            apu->noise.enabled = (w >> 3) & 1;
+            if (!apu->pulse[0].enabled) apu->pulse[0].length = 0;
+            if (!apu->pulse[1].enabled) apu->pulse[1].length = 0;
+            if (!apu->triangle.enabled) apu->triangle.length = 0;
+            if (!apu->noise.enabled) apu->noise.length = 0;
+
+            if (!(w & 0x10)) apu->dmc.remaining = 0;
+            else if (apu->dmc.remaining == 0)
+            {
+                apu->dmc.address = apu->dmc.sample_address;
+                apu->dmc.remaining = apu->dmc.sample_length;
+                dmcFetch(apu);
+            }
+            apu->dmc_irq = 0;
+            cpuSetIrq(apu->cpu, APU_IRQ_DMC, 0);
+            break;
+
+        default: break;
+    }
+
+    updateLevels(apu, t);
+}
+
+//############################# SYNTHESIS #############################
+
+//integrate complete samples up to cycle end and hand them out
+static void flush(TApu apu, uint64_t end)
+{
+    static int16_t out[APU_BUF_SAMPLES];
+    uint32_t n = (uint32_t)((end - apu->buf_time) * apu->ratio);
+    if (n == 0) return;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        apu->acc += apu->buf[i];
+
+        //remove DC, the 2A03 output is all positive
+        apu->hp_out = apu->acc - apu->hp_in + HIGHPASS * apu->hp_out;
+        apu->hp_in = apu->acc;
+
+        float s = apu->hp_out * OUTPUT_SCALE;
+        out[i] = (s > 32767) ? 32767 : (s < -32768) ? -32768 : (int16_t)s;
+    }
+
+    //unfinished kernel tails move to the front
+    memmove(apu->buf, apu->buf + n, (APU_TAPS + 4) * sizeof(float));
+    memset(apu->buf + APU_TAPS + 4, 0, n * sizeof(float));
+    apu->buf_time += n / apu->ratio;
+
+    if (apu->wav != NULL)
+    {
+        fwrite(out, sizeof(int16_t), n, apu->wav);
+        apu->wav_samples += n;
+        return;
+    }
+
+    uint32_t head = apu->ring_head;
+    uint32_t tail = __atomic_load_n(&apu->ring_tail, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (head - tail >= APU_RING_SIZE)
+        {
+            apu->overruns += n - i;
+            break;
+        }
+        apu->ring[head++ & (APU_RING_SIZE - 1)] = out[i];
+    }
+    __atomic_store_n(&apu->ring_head, head, __ATOMIC_RELEASE);
+}
+
+//synthesize from apu->cycle to until, applying queued writes and sequencer steps at their cycles
+static void synthesize(TApu apu, uint64_t until)
+{
+    dword w = 0;
+
+    while (1)
+    {
+        uint64_t t = until;
+        int what = 0;       //0: end, 1: write, 2: frame step
+
+        if (w < apu->queued && apu->queue[w].cycle <= t) { t = apu->queue[w].cycle; what = 1; }
+        if (apu->frame_next <= t && (what == 0 || apu->frame_next < t)) { t = apu->frame_next; what = 2; }
+
+        if (t > apu->cycle) runTimers(apu, t);
+        apu->cycle = (t > apu->cycle) ? t : apu->cycle;
+
+        if (what == 0) break;
+        if (what == 1)
+        {
+            writeRegister(apu, apu->queue[w].reg, apu->queue[w].value, apu->cycle);
+            w++;
+        }
+        else frameStep(apu);
+    }
+
+    //writes after until stay queued
+    memmove(apu->queue, apu->queue + w, (apu->queued - w) * sizeof(TApuWrite));
+    apu->queued -= w;
+}
+
+//synthesize up to cycle until in chunks that fit into the delta buffer
+static void run(TApu apu, uint64_t until)
+{
+    while (apu->cycle < until)
+    {
+        uint64_t end = (until - apu->cycle > APU_MAX_CHUNK) ? apu->cycle + APU_MAX_CHUNK : until;
+        synthesize(apu, end);
+        flush(apu, end);
+    }
+}
+
+//one block per sequencer step, which also raises the frame IRQ on time
+static void frameEvent(void* ctx, uint64_t when)
+{
+    TApu apu = (TApu)ctx;
+    run(apu, when);
+    cpuSchedule(apu->cpu, apu->frame_next, frameEvent, apu);
+}
+
+//############################# BUS #############################
+
+static word apuRead(void* dev, address a)
+{
+    TApu apu = (TApu)dev;
+    if (a != 0x4015) return memIoPassRead(apu->cpu->mem, &apu->io, a);
+
+    //status: length counters, DMC active and the IRQ flags; reading acknowledges the frame IRQ
+    apuSync(apu);
+    word w = (apu->pulse[0].length > 0) | ((apu->pulse[1].length > 0) << 1) | ((apu->triangle.length > 0) << 2) |
+             ((apu->noise.length > 0) << 3) | ((apu->dmc.remaining > 0) << 4) | (apu->frame_irq << 6) | (apu->dmc_irq << 7);
+
+    apu->frame_irq = 0;
+    cpuSetIrq(apu->cpu, APU_IRQ_FRAME, 0);
+    return w;
+}
+
+static word apuPeek(void* dev, address a)
+{
+    TApu apu = (TApu)dev;
+    if (a != 0x4015) return memIoPassPeek(apu->cpu->mem, &apu->io, a);
+    return apu->cpu->mem->ram[a];
+}
+
+static void apuWrite(void* dev, word w, address a)
+{
+    TApu apu = (TApu)dev;
+    uint64_t now = apu->cpu->cycles;
+
+    if (a > 0x4017 || a == 0x4014 || a == 0x4016)
+    {
+        memIoPassWrite(apu->cpu->mem, &apu->io, w, a);  //not an APU register
+        return;
+    }
+
+    if (a == 0x4017)
+    {
+        //restarts the sequencer, which moves the block event: apply right away
+        apuSync(apu);
+        apu->frame_mode = w >> 7;
+        apu->frame_inhibit = (w >> 6) & 1;
+        if (apu->frame_inhibit && apu->frame_irq)
+        {
+            apu->frame_irq = 0;
+            cpuSetIrq(apu->cpu, APU_IRQ_FRAME, 0);
+        }
+        if (apu->frame_mode)
+        {
+            quarterFrame(apu);
+            halfFrame(apu);
+            updateLevels(apu, now);
+        }
+        apu->frame_step = 0;
+        apu->frame_base = now;
+        apu->frame_next = now + frameSteps[apu->frame_mode][0];
+
+        cpuUnschedule(apu->cpu, frameEvent, apu);
+        cpuSchedule(apu->cpu, apu->frame_next, frameEvent, apu);
+        return;
+    }
+
+    if (apu->queued >= APU_QUEUE_SIZE) apuSync(apu);
+
+    TApuWrite* q = &apu->queue[apu->queued++];
+    q->cycle = now;
+    q->reg = a;
+    q->value = w;
+}
+
+//############################# API #############################
+
+//create APU, map it at $4000-$40FF and start the frame sequencer, call after cpuReset
+TApu apuInit(T6502 cpu)
+{
+    pthread_once(&kernelOnce, initKernel);
+
+    TApu apu = (TApu)calloc(1, sizeof(ApuStruct));
+    apu->cpu = cpu;
+    apu->cycle = cpu->cycles;
+    apu->buf_time = cpu->cycles;
+    apu->ratio = APU_SAMPLE_RATE / CPU_HZ;
+
+    apu->pulse[0].ones_complement = 1;
+    apu->pulse[0].t.weight = WEIGHT_PULSE;
+    apu->pulse[1].t.weight = WEIGHT_PULSE;
+    apu->triangle.t.weight = WEIGHT_TRIANGLE;
+    apu->noise.t.weight = WEIGHT_NOISE;
+    apu->dmc.t.weight = WEIGHT_DMC;
+
+    apu->pulse[0].t.period = apu->pulse[1].t.period = 2;
+    apu->triangle.t.period = 1;
+    apu->noise.t.period = noisePeriods[0];
+    apu->dmc.t.period = dmcPeriods[0];
+    apu->noise.lfsr = 1;
+    apu->dmc.bits = 8;
+    apu->dmc.silence = 1;
+
+    TApuTimer* timers[] = { &apu->pulse[0].t, &apu->pulse[1].t, &apu->triangle.t, &apu->noise.t, &apu->dmc.t };
+    for (int i = 0; i < 5; i++) timers[i]->next = cpu->cycles + timers[i]->period;
+
+    apu->frame_base = cpu->cycles;
+    apu->frame_next = cpu->cycles + frameSteps[0][0];
+    cpuSchedule(cpu, apu->frame_next, frameEvent, apu);
+
+    apu->io.dev = apu;
+    apu->io.read = apuRead;
+    apu->io.write = apuWrite;
+    apu->io.peek = apuPeek;
+    apu->io.catchUp = NULL;     //writes are queued, only a $4015 read needs the APU to be up to date
+    memMapIo(cpu->mem, 0x40, 0x40, &apu->io);
+
+    return apu;
+}
+
+//write samples to a 16 bit mono WAV file instead of the ring buffer, returns 0 on success
+int apuOpenWav(TApu apu, const char* file)
+{
+    apu->wav = fopen(file, "wb");
+    if (apu->wav == NULL)
+    {
+        logMessage("IO error: could not open file %s \n", file);
+        return -1;
+    }
+
+    //header, sizes are filled in by apuClose
+    uint32_t rate = APU_SAMPLE_RATE;
+    uint32_t bytes_per_sec = APU_SAMPLE_RATE * 2;
+    uint32_t zero = 0;
+    uint32_t fmt_size = 16;
+    uint16_t format = 1, channels = 1, align = 2, bits = 16;
+
+    fwrite("RIFF", 1, 4, apu->wav);
+    fwrite(&zero, 4, 1, apu->wav);
+    fwrite("WAVEfmt ", 1, 8, apu->wav);
+    fwrite(&fmt_size, 4, 1, apu->wav);
+    fwrite(&format, 2, 1, apu->wav);
+    fwrite(&channels, 2, 1, apu->wav);
+    fwrite(&rate, 4, 1, apu->wav);
+    fwrite(&bytes_per_sec, 4, 1, apu->wav);
+    fwrite(&align, 2, 1, apu->wav);
+    fwrite(&bits, 2, 1, apu->wav);
+    fwrite("data", 1, 4, apu->wav);
+    fwrite(&zero, 4, 1, apu->wav);
+
+    apu->wav_samples = 0;
+    return 0;
+}
+
+//synthesize up to the current cycle
+void apuSync(TApu apu)
+{
+    run(apu, apu->cpu->cycles);
+}
+
+//take up to max samples from the ring buffer, returns the number of samples (may be called from another thread)
+uint32_t apuSamples(TApu apu, int16_t* out, uint32_t max)
+{
+    uint32_t tail = apu->ring_tail;
+    uint32_t head = __atomic_load_n(&apu->ring_head, __ATOMIC_ACQUIRE);
+    uint32_t n = 0;
+
+    while (tail != head && n < max) out[n++] = apu->ring[tail++ & (APU_RING_SIZE - 1)];
+
+    __atomic_store_n(&apu->ring_tail, tail, __ATOMIC_RELEASE);
+    return n;
+}
+
+//synthesize what is left, finish WAV file and free APU
+void apuClose(TApu apu)
+{
+    apuSync(apu);
+    cpuUnschedule(apu->cpu, frameEvent, apu);
+
+    if (apu->wav != NULL)
+    {
+        uint32_t data = apu->wav_samples * 2;
+        uint32_t riff = data + 36;
+        fseek(apu->wav, 4, SEEK_SET);
+        fwrite(&riff, 4, 1, apu->wav);
+        fseek(apu->wav, 40, SEEK_SET);
+        fwrite(&data, 4, 1, apu->wav);
+        fclose(apu->wav);
+    }
+
+    memUnmapIo(apu->cpu->mem, &apu->io);
+    free(apu);
+}
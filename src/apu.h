@@ -0,0 +1,161 @@
+#ifndef APU_H
+#define APU_H
+
+#include "types.h"
+#include "6502.h"
+
+//2A03 APU: two pulse channels, triangle, noise and DMC at $4000-$4017.
+//The APU is a device on the memory bus (page $40). Register writes are not executed right away but queued
+//with their cycle; audio is synthesized in blocks, one per frame sequencer step (~4 ms), or when something
+//reads $4015. Within a block every channel only does work when its timer changes the output level: the
+//level change is added as band-limited step (windowed sinc, 32 phases) directly into a 48 kHz delta buffer,
+//which mixes and resamples in one go. Integrating that buffer gives the samples, which go to a WAV file
+//or a ring buffer for an audio thread.
+
+#define APU_SAMPLE_RATE 48000
+#define APU_TAPS        16              //band-limited step kernel length in samples
+#define APU_PHASES      32              //kernel phases per sample
+#define APU_BUF_SAMPLES 4096            //delta buffer length
+#define APU_MAX_CHUNK   65536           //cycles synthesized at once, must fit into the delta buffer
+#define APU_QUEUE_SIZE  1024            //queued register writes, a full queue is synthesized early
+#define APU_RING_SIZE   (1 << 16)       //output ring buffer in samples, must be a power of 2
+
+#define APU_IRQ_FRAME   0x01            //IRQ sources, see cpuSetIrq
+#define APU_IRQ_DMC     0x02
+
+typedef struct
+{
+    word start;         //restart on next quarter frame
+    word divider;
+    word decay;         //decay level 15..0
+    word constant;      //1: volume is the constant volume
+    word loop;
+    word volume;        //constant volume / envelope period
+} TApuEnvelope;
+
+typedef struct
+{
+    uint64_t next;      //cycle of the next timer clock
+    uint32_t period;    //timer period in CPU cycles
+    int      level;     //current output level
+    float    weight;    //linear mixer weight of this channel
+} TApuTimer;
+
+typedef struct
+{
+    TApuTimer    t;
+    TApuEnvelope env;
+    word         enabled;
+    word         length;
+    word         duty;
+    word         step;          //duty sequencer position 0..7
+    dword        timer;         //11 bit timer value from the registers
+    word         sweep_enabled;
+    word         sweep_period;
+    word         sweep_negate;
+    word         sweep_shift;
+    word         sweep_divider;
+    word         sweep_reload;
+    word         ones_complement;   //pulse 1 negates with one's complement
+} TApuPulse;
+
+typedef struct
+{
+    TApuTimer t;
+    word      enabled;
+    word      length;
+    word      control;          //length counter halt and linear counter control
+    word      linear;
+    word      linear_reload_value;
+    word      linear_reload;
+    word      step;             //sequencer position 0..31
+    dword     timer;
+} TApuTriangle;
+
+typedef struct
+{
+    TApuTimer    t;
+    TApuEnvelope env;
+    word         enabled;
+    word         length;
+    word         mode;          //1: short sequence (feedback from bit 6)
+    dword        lfsr;
+} TApuNoise;
+
+typedef struct
+{
+    TApuTimer t;
+    word      irq_enabled;
+    word      loop;
+    address   sample_address;
+    dword     sample_length;
+    address   address;          //current sample byte
+    dword     remaining;        //bytes left
+    word      buffer;
+    word      buffer_full;
+    word      shift;
+    word      bits;             //bits left in shift
+    word      silence;
+} TApuDmc;
+
+typedef struct
+{
+    uint64_t cycle;
+    address  reg;
+    word     value;
+} TApuWrite;
+
+typedef struct
+{
+    T6502        cpu;
+    TIoHandler   io;
+    TApuPulse    pulse[2];
+    TApuTriangle triangle;
+    TApuNoise    noise;
+    TApuDmc      dmc;
+
+    uint64_t     cycle;             //synthesized up to this cycle
+    word         frame_mode;        //0: 4-step, 1: 5-step sequence
+    word         frame_inhibit;     //frame IRQ disabled
+    word         frame_irq;
+    word         dmc_irq;
+    word         frame_step;
+    uint64_t     frame_base;        //cycle the current sequence started
+    uint64_t     frame_next;        //cycle of the next sequencer step
+
+    TApuWrite    queue[APU_QUEUE_SIZE];
+    dword        queued;
+
+    float        buf[APU_BUF_SAMPLES + APU_TAPS + 4];  //delta buffer, mixed channel steps
+    double       buf_time;          //cycle of buf[0]
+    double       ratio;             //samples per cycle
+    float        acc;               //integrator
+    float        hp_in;             //DC blocker state
+    float        hp_out;
+
+    int16_t      ring[APU_RING_SIZE];
+    uint32_t     ring_head;         //written by the emulation thread
+    uint32_t     ring_tail;         //written by the consumer (apuSamples)
+    uint64_t     overruns;          //samples dropped because the ring was full
+    FILE*        wav;
+    uint32_t     wav_samples;
+} ApuStruct;
+
+typedef ApuStruct* TApu;
+
+//create APU, map it at $4000-$40FF and start the frame sequencer, call after cpuReset
+TApu apuInit(T6502 cpu);
+
+//synthesize what is left, finish WAV file and free APU
+void apuClose(TApu apu);
+
+//write samples to a 16 bit mono WAV file instead of the ring buffer, returns 0 on success
+int apuOpenWav(TApu apu, const char* file);
+
+//synthesize up to the current cycle
+void apuSync(TApu apu);
+
+//take up to max samples from the ring buffer, returns the number of samples (may be called from another thread)
+uint32_t apuSamples(TApu apu, int16_t* out, uint32_t max);
+
+#endif
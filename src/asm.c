@@ -0,0 +1,579 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include "asm.h"
+#include "opcodes.h"
+
+
+#define MAX_MNEMONICS 64
+
+//state of one assembly run
+typedef struct
+{
+    TAsm     as;
+    TMemory  mem;
+    int      pass;          //1: define symbols and sizes, 2: emit
+    uint32_t line;
+    address  pc;
+    int      written;       //something was written in pass 2
+} TAsmState;
+
+//operand syntax, before it is mapped to an addressing mode of the mnemonic
+typedef enum
+{
+    OPERAND_NONE,
+    OPERAND_ACCU,           //A
+    OPERAND_IMMD,           //#e
+    OPERAND_DIRECT,         //e
+    OPERAND_DIRECT_X,       //e,X
+    OPERAND_DIRECT_Y,       //e,Y
+    OPERAND_IND,            //(e)
+    OPERAND_IND_X,          //(e,X)
+    OPERAND_IND_Y,          //(e),Y
+    OPERAND_INVALID         //(e,Y), (e),X
+} eOperand;
+
+//opcode per mnemonic and addressing mode, -1 if the combination does not exist
+static uint32_t mnemonicKeys[MAX_MNEMONICS];
+static int16_t  opcodeOf[MAX_MNEMONICS][MODE_COUNT];
+static dword    mnemonicCount = 0;
+static pthread_once_t lookupOnce = PTHREAD_ONCE_INIT;   //runners may assemble on several threads at once
+
+//3 letter mnemonic as number, case insensitive
+static uint32_t mnemonicKey(const char* m)
+{
+    return ((uint32_t)toupper((unsigned char)m[0]) << 16) | ((uint32_t)toupper((unsigned char)m[1]) << 8) | (uint32_t)toupper((unsigned char)m[2]);
+}
+
+static void initLookup(void)
+{
+    for (dword op = 0; op < 256; op++)
+    {
+        const TOpcodeInfo* info = &opcodeTable[op];
+        if (info->mnemonic == NULL) continue;
+
+        uint32_t key = mnemonicKey(info->mnemonic);
+        dword i;
+        for (i = 0; i < mnemonicCount; i++)
+            if (mnemonicKeys[i] == key) break;
+        if (i == mnemonicCount)
+        {
+            mnemonicKeys[mnemonicCount++] = key;
+            for (dword m = 0; m < MODE_COUNT; m++) opcodeOf[i][m] = -1;
+        }
+        opcodeOf[i][info->mode] = op;
+    }
+}
+
+//index of mnemonic m (len characters), -1 if it is none
+static int findMnemonic(const char* m, size_t len)
+{
+    if (len != 3) return -1;
+    uint32_t key = mnemonicKey(m);
+    for (dword i = 0; i < mnemonicCount; i++)
+        if (mnemonicKeys[i] == key) return i;
+    return -1;
+}
+
+static int fail(TAsmState* s, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(s->as->error, sizeof(s->as->error), format, args);
+    va_end(args);
+    s->as->error_line = s->line;
+    return -1;
+}
+
+//############################# SYMBOLS #############################
+
+static TAsmSymbol* findSymbol(TAsm as, const char* name, size_t len)
+{
+    for (dword i = 0; i < as->symbol_count; i++)
+        if (strncmp(as->symbols[i].name, name, len) == 0 && as->symbols[i].name[len] == '\0') return &as->symbols[i];
+    return NULL;
+}
+
+static int defineSymbol(TAsmState* s, const char* name, size_t len, address value)
+{
+    if (len >= ASM_MAX_NAME) return fail(s, "symbol name too long");
+
+    TAsmSymbol* sym = findSymbol(s->as, name, len);
+    if (s->pass == 2)
+    {
+        if (sym->value != value) return fail(s, "value of %s differs between passes", sym->name);
+        return 0;
+    }
+    if (sym != NULL) return fail(s, "symbol %s defined twice", sym->name);
+    if (s->as->symbol_count >= ASM_MAX_SYMBOLS) return fail(s, "too many symbols");
+
+    sym = &s->as->symbols[s->as->symbol_count++];
+    memcpy(sym->name, name, len);
+    sym->name[len] = '\0';
+    sym->value = value;
+    sym->line = s->line;
+    return 0;
+}
+
+//############################# EXPRESSIONS #############################
+
+static const char* skipSpace(const char* p)
+{
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+static int isSymbolChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+//number, character, * or symbol; *early is cleared if the value is not known in pass 1 at this line
+static int evalTerm(TAsmState* s, const char** text, int32_t* value, int* early)
+{
+    const char* p = skipSpace(*text);
+    int32_t v = 0;
+
+    if (*p == '$' || *p == '%')
+    {
+        int base = (*p == '$') ? 16 : 2;
+        char* end;
+        v = strtol(p + 1, &end, base);
+        if (end == p + 1) return fail(s, "number expected");
+        p = end;
+    }
+    else if (isdigit((unsigned char)*p))
+    {
+        char* end;
+        v = strtol(p, &end, 10);
+        p = end;
+    }
+    else if (*p == '\'' && p[1] != '\0' && p[2] == '\'')
+    {
+        v = (unsigned char)p[1];
+        p += 3;
+    }
+    else if (*p == '*')
+    {
+        v = s->pc;
+        p++;
+    }
+    else if (isalpha((unsigned char)*p) || *p == '_')
+    {
+        const char* name = p;
+        while (isSymbolChar(*p)) p++;
+        TAsmSymbol* sym = findSymbol(s->as, name, p - name);
+        if (sym == NULL)
+        {
+            if (s->pass == 2) return fail(s, "undefined symbol %.*s", (int)(p - name), name);
+            *early = 0;
+        }
+        else
+        {
+            v = sym->value;
+            if (sym->line > s->line) *early = 0;
+        }
+    }
+    else return fail(s, "expression expected");
+
+    *value = v;
+    *text = p;
+    return 0;
+}
+
+//[<|>] [-] term {+|- term}, the text has to end behind the expression
+static int evalExpr(TAsmState* s, const char* text, int32_t* value, int* early)
+{
+    const char* p = skipSpace(text);
+    char part = 0;
+    int32_t sum = 0;
+    int sign = 1;
+
+    *early = 1;
+    if (*p == '<' || *p == '>') part = *p++;
+    p = skipSpace(p);
+    if (*p == '-')
+    {
+        sign = -1;
+        p++;
+    }
+
+    for (;;)
+    {
+        int32_t v = 0;
+        if (evalTerm(s, &p, &v, early) != 0) return -1;
+        sum += sign * v;
+
+        p = skipSpace(p);
+        if (*p == '+') sign = 1;
+        else if (*p == '-') sign = -1;
+        else break;
+        p++;
+    }
+    if (*p != '\0') return fail(s, "unexpected '%s'", p);
+
+    if (part == '<') sum &= 0xFF;
+    if (part == '>') sum = (sum >> 8) & 0xFF;
+    *value = sum;
+    return 0;
+}
+
+//############################# EMITTING #############################
+
+static void emit(TAsmState* s, word w)
+{
+    if (s->pass == 2)
+    {
+        if (!s->written) s->as->start = s->pc;
+        memWrite(s->mem, w, s->pc);
+        s->written = 1;
+        s->as->size++;
+        s->as->end = s->pc + 1;
+    }
+    s->pc++;
+}
+
+static int emitByte(TAsmState* s, int32_t v)
+{
+    if (s->pass == 2 && (v < -128 || v > 255)) return fail(s, "value $%X does not fit into a byte", v);
+    emit(s, v & 0xFF);
+    return 0;
+}
+
+static void emitWord(TAsmState* s, int32_t v)
+{
+    emit(s, v & 0xFF);
+    emit(s, (v >> 8) & 0xFF);
+}
+
+//split a comma separated list in place, quotes are respected; returns the number of items
+static int splitList(char* text, char** items, int max)
+{
+    int n = 0;
+    int quoted = 0;
+    char* p = text;
+
+    items[n++] = p;
+    for (; *p != '\0'; p++)
+    {
+        if (*p == '"') quoted = !quoted;
+        else if (*p == ',' && !quoted)
+        {
+            *p = '\0';
+            if (n == max) return -1;
+            items[n++] = p + 1;
+        }
+    }
+    return n;
+}
+
+//remove blanks at both ends, in place
+static char* trim(char* p)
+{
+    p = (char*)skipSpace(p);
+    size_t len = strlen(p);
+    while (len > 0 && (p[len - 1] == ' ' || p[len - 1] == '\t' || p[len - 1] == '\r')) p[--len] = '\0';
+    return p;
+}
+
+//############################# STATEMENTS #############################
+
+static int directive(TAsmState* s, const char* name, size_t len, char* args)
+{
+    char* items[64];
+    int32_t v;
+    int early;
+
+    #define IS(d) (len == strlen(d) && strncasecmp(name, d, len) == 0)
+
+    if (IS(".org"))
+    {
+        if (evalExpr(s, args, &v, &early) != 0) return -1;
+        if (!early) return fail(s, "origin must be known in the first pass");
+        s->pc = v;
+        return 0;
+    }
+
+    int n = splitList(args, items, 64);
+    if (n < 0) return fail(s, "too many items");
+
+    if (IS(".byt") || IS(".byte") || IS(".db") || IS(".asc") || IS(".text"))
+    {
+        for (int i = 0; i < n; i++)
+        {
+            char* item = trim(items[i]);
+            size_t ilen = strlen(item);
+            if (item[0] == '"')
+            {
+                if (ilen < 2 || item[ilen - 1] != '"') return fail(s, "unterminated string");
+                for (size_t j = 1; j < ilen - 1; j++) emit(s, (word)item[j]);
+                continue;
+            }
+            if (evalExpr(s, item, &v, &early) != 0 || emitByte(s, v) != 0) return -1;
+        }
+        return 0;
+    }
+
+    if (IS(".word") || IS(".dw"))
+    {
+        for (int i = 0; i < n; i++)
+        {
+            if (evalExpr(s, items[i], &v, &early) != 0) return -1;
+            emitWord(s, v);
+        }
+        return 0;
+    }
+
+    if (IS(".dsb") || IS(".res"))
+    {
+        int32_t fill = 0;
+        if (evalExpr(s, items[0], &v, &early) != 0) return -1;
+        if (!early || v < 0) return fail(s, "count must be known in the first pass and positive");
+        if (n > 1 && evalExpr(s, items[1], &fill, &early) != 0) return -1;
+        for (int32_t i = 0; i < v; i++)
+            if (emitByte(s, fill) != 0) return -1;
+        return 0;
+    }
+
+    #undef IS
+    return fail(s, "unknown directive %.*s", (int)len, name);
+}
+
+//strip ",X" / ",Y" (blanks allowed) from the end of p, returns the register or 0
+static char cutIndex(char* p)
+{
+    char* comma = strrchr(p, ',');
+    if (comma == NULL) return 0;
+
+    char* reg = trim(comma + 1);
+    char r = toupper((unsigned char)reg[0]);
+    if (reg[1] != '\0' || (r != 'X' && r != 'Y')) return 0;
+    *comma = '\0';
+    return r;
+}
+
+//classify operand text and cut it down to the expression
+static eOperand parseOperand(char* text, char** expr)
+{
+    char* p = trim(text);
+    size_t len = strlen(p);
+    *expr = p;
+
+    if (len == 0) return OPERAND_NONE;
+    if (len == 1 && toupper((unsigned char)p[0]) == 'A') return OPERAND_ACCU;
+    if (p[0] == '#')
+    {
+        *expr = p + 1;
+        return OPERAND_IMMD;
+    }
+
+    //(e,X) / (e)
+    if (p[0] == '(' && p[len - 1] == ')')
+    {
+        p[len - 1] = '\0';
+        *expr = trim(p + 1);
+        char index = cutIndex(*expr);
+        if (index == 'Y') return OPERAND_INVALID;
+        return (index == 'X') ? OPERAND_IND_X : OPERAND_IND;
+    }
+
+    char index = cutIndex(p);
+    p = trim(p);
+    len = strlen(p);
+    *expr = p;
+
+    //(e),Y
+    if (p[0] == '(' && p[len - 1] == ')')
+    {
+        if (index != 'Y') return OPERAND_INVALID;
+        p[len - 1] = '\0';
+        *expr = p + 1;
+        return OPERAND_IND_Y;
+    }
+    if (index == 'X') return OPERAND_DIRECT_X;
+    if (index == 'Y') return OPERAND_DIRECT_Y;
+    return OPERAND_DIRECT;
+}
+
+static int instruction(TAsmState* s, int mnemonic, const char* name, char* args)
+{
+    const int16_t* ops = opcodeOf[mnemonic];
+    char* expr;
+    eOperand kind = parseOperand(args, &expr);
+    int32_t v = 0;
+    int early = 1;
+    int mode = -1;
+
+    if (kind == OPERAND_INVALID) return fail(s, "invalid operand");
+    if (kind != OPERAND_NONE && kind != OPERAND_ACCU && evalExpr(s, expr, &v, &early) != 0) return -1;
+
+    int zp = early && v >= 0 && v < 0x100;
+    switch (kind)
+    {
+        case OPERAND_NONE:     mode = (ops[MODE_IMPL] >= 0) ? MODE_IMPL : MODE_ACCU; break;
+        case OPERAND_ACCU:     mode = MODE_ACCU; break;
+        case OPERAND_IMMD:     mode = MODE_IMMD; break;
+        case OPERAND_DIRECT:   mode = (ops[MODE_REL] >= 0) ? MODE_REL : ((zp && ops[MODE_ZRP] >= 0) ? MODE_ZRP : MODE_ABS); break;
+        case OPERAND_DIRECT_X: mode = (zp && ops[MODE_ZRPX] >= 0) ? MODE_ZRPX : MODE_ABSX; break;
+        case OPERAND_DIRECT_Y: mode = (zp && ops[MODE_ZRPY] >= 0) ? MODE_ZRPY : MODE_ABSY; break;
+        case OPERAND_IND:      mode = (ops[MODE_IND] >= 0) ? MODE_IND : MODE_ZIND; break;
+        case OPERAND_IND_X:    mode = (ops[MODE_XIND] >= 0) ? MODE_XIND : MODE_AXIND; break;
+        case OPERAND_IND_Y:    mode = MODE_INDY; break;
+        default:               break;
+    }
+
+    int op = ops[mode];
+    if (op < 0) return fail(s, "%.3s does not support addressing mode %s", name, addrModeNames[mode]);
+
+    address at = s->pc;
+    emit(s, (word)op);
+    switch (opcodeTable[op].length)
+    {
+        case 2:
+            if (mode == MODE_REL)
+            {
+                int32_t offset = v - (int32_t)(address)(at + 2);
+                if (s->pass == 2 && (offset < -128 || offset > 127)) return fail(s, "branch target out of range (%d)", offset);
+                emit(s, offset & 0xFF);
+            }
+            else if (emitByte(s, v) != 0) return -1;
+            break;
+        case 3:
+            emitWord(s, v);
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+//one source line, already without comment
+static int statement(TAsmState* s, char* text)
+{
+    char* p = (char*)skipSpace(text);
+    if (*p == '\0' || *p == '\r') return 0;
+
+    //*= origin
+    if (*p == '*')
+    {
+        const char* q = skipSpace(p + 1);
+        if (*q != '=') return fail(s, "= expected");
+        int32_t v;
+        int early;
+        if (evalExpr(s, q + 1, &v, &early) != 0) return -1;
+        if (!early) return fail(s, "origin must be known in the first pass");
+        s->pc = v;
+        return 0;
+    }
+
+    //directive
+    if (*p == '.')
+    {
+        char* name = p;
+        p++;
+        while (isSymbolChar(*p)) p++;
+        size_t len = p - name;
+        char* args = p;
+        return directive(s, name, len, args);
+    }
+
+    if (!isalpha((unsigned char)*p) && *p != '_') return fail(s, "unexpected '%s'", p);
+
+    char* name = p;
+    while (isSymbolChar(*p)) p++;
+    size_t len = p - name;
+
+    //mnemonic
+    int m = findMnemonic(name, len);
+    if (m >= 0) return instruction(s, m, name, p);
+
+    //constant
+    const char* q = skipSpace(p);
+    if (*q == '=')
+    {
+        int32_t v;
+        int early;
+        if (evalExpr(s, q + 1, &v, &early) != 0) return -1;
+        if (s->pass == 1 && !early) return fail(s, "constant must be known in the first pass");
+        return defineSymbol(s, name, len, (address)v);
+    }
+
+    //label, the rest of the line is a statement of its own
+    if (*p == ':') p++;
+    if (defineSymbol(s, name, len, s->pc) != 0) return -1;
+    return statement(s, p);
+}
+
+static int pass(TAsmState* s, const char* source, address origin)
+{
+    char line[ASM_MAX_LINE];
+    const char* p = source;
+
+    s->pc = origin;
+    s->line = 0;
+
+    while (*p != '\0')
+    {
+        const char* eol = strchr(p, '\n');
+        size_t len = (eol != NULL) ? (size_t)(eol - p) : strlen(p);
+        s->line++;
+        if (len >= ASM_MAX_LINE) return fail(s, "line too long");
+
+        //copy without comment, a ; in a string or character does not count
+        int quoted = 0;
+        size_t n = 0;
+        for (size_t i = 0; i < len; i++)
+        {
+            if (p[i] == '\'' && !quoted && i + 2 < len && p[i + 2] == '\'')
+            {
+                memcpy(&line[n], &p[i], 3);
+                n += 3;
+                i += 2;
+                continue;
+            }
+            if (p[i] == '"') quoted = !quoted;
+            if (p[i] == ';' && !quoted) break;
+            line[n++] = p[i];
+        }
+        line[n] = '\0';
+
+        if (statement(s, line) != 0) return -1;
+
+        p += len;
+        if (*p == '\n') p++;
+    }
+    return 0;
+}
+
+int asmAssemble(TAsm as, TMemory mem, const char* source, address origin)
+{
+    pthread_once(&lookupOnce, initLookup);
+
+    TAsmState s;
+    memset(&s, 0, sizeof(s));
+    s.as = as;
+    s.mem = mem;
+
+    as->symbol_count = 0;
+    as->start = origin;
+    as->end = origin;
+    as->size = 0;
+    as->error_line = 0;
+    as->error[0] = '\0';
+
+    s.pass = 1;
+    if (pass(&s, source, origin) != 0) return -1;
+    s.pass = 2;
+    return pass(&s, source, origin);
+}
+
+int asmSymbol(TAsm as, const char* name, address* value)
+{
+    TAsmSymbol* sym = findSymbol(as, name, strlen(name));
+    if (sym == NULL) return -1;
+    *value = sym->value;
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef ASM_H
+#define ASM_H
+
+#include "types.h"
+#include "mem.h"
+
+//In-process 6502 assembler, xa compatible for what the test and mini programs use.
+//Source is assembled in two passes straight into a TMemory, nothing is printed and no files are involved.
+//- one statement per line, comments start with ;
+//- labels at the start of a line, with or without colon; constants with name = expression
+//- mnemonics and addressing modes of the variant being built (opcodeTable), case insensitive:
+//  ASL / ASL A, #imm, zp, zp,X, zp,Y, abs, abs,X, abs,Y, (ind), (zp,X), (zp),Y and on the 65C02 (zp), (abs,X)
+//- zeropage modes are used when the operand is below $100 and known when the statement is reached in the
+//  first pass, i.e. literals and symbols defined above; forward references are always absolute
+//- expressions: $hex, %binary, decimal, 'c', symbols, * (address of the statement), + and -, < (lo byte)
+//  and > (hi byte) in front of the whole expression; branches take any address, e.g. BNE *-3
+//- directives: *= / .org, .byt / .byte / .db, .asc / .text, .word / .dw, .dsb / .res count[,fill]
+
+#define ASM_MAX_SYMBOLS 512
+#define ASM_MAX_NAME    32
+#define ASM_MAX_LINE    256     //characters per source line
+
+typedef struct
+{
+    char     name[ASM_MAX_NAME];
+    address  value;
+    uint32_t line;              //source line that defined the symbol
+} TAsmSymbol;
+
+typedef struct
+{
+    TAsmSymbol symbols[ASM_MAX_SYMBOLS];
+    dword      symbol_count;
+    address    start;           //address of the first byte written
+    address    end;             //address behind the last byte written
+    uint32_t   size;            //bytes written
+    uint32_t   error_line;      //line of the first error, 0 if there was none
+    char       error[128];      //error message
+} AsmStruct;
+
+typedef AsmStruct* TAsm;
+
+//assemble source into mem, starting at origin unless the source sets one; returns 0 on success,
+//-1 on error (see as->error_line and as->error, memory may be partially written)
+int asmAssemble(TAsm as, TMemory mem, const char* source, address origin);
+
+//look up a label or constant of the last assembly, returns 0 if it exists
+int asmSymbol(TAsm as, const char* name, address* value);
+
+#endif
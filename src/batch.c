@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "batch.h"
+#include "mem.h"
+#include "utils.h"
+
+
+//work shared by the worker threads of one batchRun
+typedef struct
+{
+    TBatchEntry*  entries;
+    TBatchResult* results;
+    word*         done;         //result i is complete
+    uint32_t      count;
+    uint32_t      next;         //next entry to pick up
+    uint32_t      emitted;      //results written so far, in manifest order
+    uint32_t      load_errors;
+    FILE*         out;
+    pthread_mutex_t lock;
+} TBatchRun;
+
+
+//############################# MANIFEST #############################
+
+//decimal, 0x hex or $ hex
+static int parseNumber(const char* s, uint64_t* value)
+{
+    char* end;
+    if (s[0] == '$') *value = strtoull(s + 1, &end, 16);
+    else *value = strtoull(s, &end, 0);
+    return (end != s && *end == '\0') ? 0 : -1;
+}
+
+static int parseEntry(TBatchEntry* e, char* line, uint64_t default_cycles, const char* manifest, uint32_t line_no)
+{
+    char* rest;
+    char* file = strtok_r(line, " \t\r\n", &rest);
+
+    e->file = strdup(file);
+    e->load = 0;
+    e->entry = -1;
+    budgetInit(&e->limits);
+    e->limits.cycles = default_cycles;
+
+    for (char* t = strtok_r(NULL, " \t\r\n", &rest); t != NULL; t = strtok_r(NULL, " \t\r\n", &rest))
+    {
+        char* eq = strchr(t, '=');
+        char* end = NULL;
+        uint64_t v = 0;
+        int valid = (eq != NULL);
+        if (valid && strncmp(t, "timeout=", 8) == 0)
+        {
+            e->limits.timeout = strtod(eq + 1, &end);
+            valid = (end != eq + 1 && *end == '\0' && e->limits.timeout >= 0);
+        }
+        else if (valid) valid = (parseNumber(eq + 1, &v) == 0);
+        if (!valid)
+        {
+            logMessage("Input error: %s:%u: expected key=number, got %s \n", manifest, line_no, t);
+            return -1;
+        }
+        *eq = '\0';
+
+        if (strcmp(t, "timeout") == 0) continue;
+        else if (strcmp(t, "load") == 0 && v < MEMSIZE) e->load = (address)v;
+        else if (strcmp(t, "entry") == 0 && v < MEMSIZE) e->entry = (int32_t)v;
+        else if (strcmp(t, "cycles") == 0) e->limits.cycles = v;
+        else if (strcmp(t, "instructions") == 0) e->limits.instructions = v;
+        else if (strcmp(t, "until") == 0 && v < MEMSIZE) e->limits.until = (int32_t)v;
+        else if (strcmp(t, "brk") == 0 && v <= 1) e->limits.brk = (word)v;
+        else if (strcmp(t, "halt") == 0 && v <= 1) e->limits.halt = (word)v;
+        else
+        {
+            logMessage("Input error: %s:%u: unknown key or value out of range: %s=%s \n", manifest, line_no, t, eq + 1);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+//read all entries, returns their number or -1
+static int readManifest(TBatchRun* run, const char* manifest, uint64_t default_cycles)
+{
+    FILE* f = stdin;
+    if (manifest != NULL && strcmp(manifest, "-") != 0) f = fopen(manifest, "r");
+    else manifest = "stdin";
+
+    if (f == NULL)
+    {
+        logMessage("IO error: could not open file %s \n", manifest);
+        return -1;
+    }
+
+    uint32_t capacity = 0;
+    uint32_t line_no = 0;
+    char* line = NULL;
+    size_t size = 0;
+    int failed = 0;
+
+    while (getline(&line, &size, f) != -1)
+    {
+        line_no++;
+        char* hash = strchr(line, '#');
+        if (hash != NULL) *hash = '\0';
+        if (line[strspn(line, " \t\r\n")] == '\0') continue;
+
+        if (run->count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            run->entries = (TBatchEntry*)realloc(run->entries, capacity * sizeof(TBatchEntry));
+        }
+        if (parseEntry(&run->entries[run->count++], line, default_cycles, manifest, line_no) != 0)
+        {
+            failed = 1;
+            break;
+        }
+    }
+
+    free(line);
+    if (f != stdin) fclose(f);
+    return failed ? -1 : (int)run->count;
+}
+
+
+//############################# RUN #############################
+
+static void runEntry(TMachine m, word* image, const TBatchEntry* e, TBatchResult* r)
+{
+    memset(r, 0, sizeof(TBatchResult));
+
+    FILE* f = fopen(e->file, "rb");
+    if (f == NULL)
+    {
+        r->load_error = 1;
+        return;
+    }
+    uint32_t length = fread(image, 1, MEMSIZE + 1, f);
+    fclose(f);
+
+    machineReset(m);
+    if (machineLoad(m, image, length, e->load) != 0)
+    {
+        r->load_error = 1;
+        return;
+    }
+
+    //start at the reset vector of the loaded binary unless the entry point is given
+    cpuReset(m->cpu);
+    if (e->entry >= 0) m->cpu->PC = (address)e->entry;
+
+    BudgetStruct limits = e->limits;
+    budgetStart(&limits, m->cpu);
+    r->stop = budgetRun(&limits, m->cpu);
+    r->cpu_stop = m->cpu->stop;
+    budgetEnd(&limits, m->cpu);
+    machineGetRegs(m, &r->regs);
+}
+
+static void writeString(FILE* out, const char* s)
+{
+    fputc('"', out);
+    for (; *s != '\0'; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%.4x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void writeResult(FILE* out, const TBatchEntry* e, const TBatchResult* r)
+{
+    fprintf(out, "{\"file\":");
+    writeString(out, e->file);
+    fprintf(out, ",\"stop\":\"%s\"", r->load_error ? "load_error" : budgetStopName(r->stop, r->cpu_stop));
+    if (!r->load_error)
+    {
+        const TMachineRegs* regs = &r->regs;
+        fprintf(out, ",\"cycles\":%llu,\"instructions\":%llu,\"pc\":%u,\"a\":%u,\"x\":%u,\"y\":%u,\"p\":%u,\"sp\":%u",
+                (unsigned long long)regs->cycles, (unsigned long long)regs->instructions, regs->PC, regs->A, regs->X, regs->Y, regs->P, regs->SP);
+    }
+    fprintf(out, "}\n");
+}
+
+//worker: pick next entry until all are done, write out all results that are complete in manifest order
+static void* worker(void* arg)
+{
+    TBatchRun* run = (TBatchRun*)arg;
+    TMachine m = machineCreate();
+    word* image = (word*)malloc(MEMSIZE + 1);    //one byte more to tell a binary that is too large
+
+    while (1)
+    {
+        uint32_t i = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED);
+        if (i >= run->count) break;
+        runEntry(m, image, &run->entries[i], &run->results[i]);
+
+        pthread_mutex_lock(&run->lock);
+        run->done[i] = 1;
+        if (run->results[i].load_error) run->load_errors++;
+        while (run->emitted < run->count && run->done[run->emitted])
+        {
+            writeResult(run->out, &run->entries[run->emitted], &run->results[run->emitted]);
+            run->emitted++;
+        }
+        pthread_mutex_unlock(&run->lock);
+    }
+
+    free(image);
+    machineDestroy(m);
+    return NULL;
+}
+
+int batchRun(const char* manifest, FILE* out, int threads, uint64_t default_cycles)
+{
+    TBatchRun run;
+    memset(&run, 0, sizeof(run));
+    run.out = out;
+
+    int count = readManifest(&run, manifest, default_cycles);
+    if (count >= 0)
+    {
+        run.results = (TBatchResult*)calloc(count + 1, sizeof(TBatchResult));
+        run.done = (word*)calloc(count + 1, sizeof(word));
+        pthread_mutex_init(&run.lock, NULL);
+
+        if (threads < 1) threads = 1;
+        if (threads > BATCH_MAX_THREADS) threads = BATCH_MAX_THREADS;
+        if (threads > count) threads = count;
+
+        pthread_t tid[BATCH_MAX_THREADS];
+        for (int i = 0; i < threads; i++) pthread_create(&tid[i], NULL, worker, &run);
+        for (int i = 0; i < threads; i++) pthread_join(tid[i], NULL);
+
+        pthread_mutex_destroy(&run.lock);
+        fflush(out);
+    }
+
+    for (uint32_t i = 0; i < run.count; i++) free(run.entries[i].file);
+    free(run.entries);
+    free(run.results);
+    free(run.done);
+    return (count >= 0) ? (int)run.load_errors : -1;
+}
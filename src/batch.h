@@ -0,0 +1,44 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include "types.h"
+#include "machine.h"
+#include "budget.h"
+
+//Batch mode: run many raw 6502 binaries in one process. The manifest lists one binary per line, followed by
+//optional key=value settings (numbers decimal, 0x or $ hex), '#' starts a comment:
+//    path/to/program.bin  load=$0200  entry=$0200  cycles=1000000  brk=1
+//- load:   address the binary is copied to, default $0000
+//- entry:  start address, default the reset vector at $FFFC after loading
+//- limits (budget.h): cycles (default given to batchRun), instructions, timeout (seconds, may be
+//  fractional), until (stop when PC gets there), brk (1: stop at BRK), halt (0: no halt detection)
+//Worker threads each own a machine (machine.h) and reuse it for every entry they pick up, with RAM cleared in
+//between. For every entry one JSON line is written, in manifest order:
+//    {"file":"a.bin","stop":"halt","cycles":1002,"instructions":334,"pc":516,"a":0,"x":0,"y":0,"p":36,"sp":253}
+//stop is a budgetStopName, or "load_error" if the binary is missing or too large for its load address.
+
+#define BATCH_MAX_THREADS    64
+#define BATCH_DEFAULT_CYCLES 100000000ULL  //about a minute of 2A03 time
+
+typedef struct
+{
+    char*    file;
+    address  load;
+    int32_t  entry;             //-1: reset vector
+    BudgetStruct limits;
+} TBatchEntry;
+
+typedef struct
+{
+    word         load_error;
+    eBudgetStop  stop;
+    eCpuStop     cpu_stop;      //for BUDGET_BREAK
+    TMachineRegs regs;
+} TBatchResult;
+
+//run all entries of manifest (NULL or "-": stdin) on up to threads machines, JSON lines go to out;
+//returns the number of entries that could not be loaded, -1 if the manifest could not be read
+int batchRun(const char* manifest, FILE* out, int threads, uint64_t default_cycles);
+
+#endif
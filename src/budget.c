@@ -0,0 +1,105 @@
+#include "budget.h"
+
+
+void budgetInit(TBudget b)
+{
+    b->cycles = 0;
+    b->instructions = 0;
+    b->timeout = 0;
+    b->until = -1;
+    b->brk = 0;
+    b->halt = 1;
+}
+
+void budgetStart(TBudget b, T6502 cpu)
+{
+    b->end_cycles = cpu->cycles + b->cycles;
+    b->end_instructions = cpu->instructions + b->instructions;
+
+    clock_gettime(CLOCK_MONOTONIC, &b->deadline);
+    long long ns = b->deadline.tv_nsec + (long long)(b->timeout * 1e9);
+    b->deadline.tv_sec += ns / 1000000000LL;
+    b->deadline.tv_nsec = ns % 1000000000LL;
+
+    if (b->until >= 0)
+    {
+        b->had_breakpoint = cpuIsBreakpoint(cpu, b->until);
+        cpuSetBreakpoint(cpu, b->until, 1);
+    }
+    cpu->stop_on_brk = b->brk;
+    cpu->halt_check = b->halt;
+}
+
+static int timeUp(TBudget b)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > b->deadline.tv_sec || (now.tv_sec == b->deadline.tv_sec && now.tv_nsec >= b->deadline.tv_nsec);
+}
+
+eBudgetStop budgetStep(TBudget b, T6502 cpu, uint64_t slice)
+{
+    if (b->cycles)
+    {
+        if (cpu->cycles >= b->end_cycles) return BUDGET_CYCLES;
+        if (slice > b->end_cycles - cpu->cycles) slice = b->end_cycles - cpu->cycles;
+    }
+    if (b->instructions)
+    {
+        if (cpu->instructions >= b->end_instructions) return BUDGET_INSTRUCTIONS;
+        if (slice > 2 * (b->end_instructions - cpu->instructions)) slice = 2 * (b->end_instructions - cpu->instructions);
+    }
+
+    switch (cpuRun(cpu, slice))
+    {
+        case CPU_STEP_OK:
+            break;
+        case CPU_STEP_ERROR:
+            return BUDGET_ERROR;
+        case CPU_STEP_BREAK:
+            if (cpu->stop == CPU_STOP_BRK) return BUDGET_BRK;
+            if (cpu->stop == CPU_STOP_HALT) return BUDGET_HALT;
+            if (cpu->stop == CPU_STOP_BREAKPOINT && cpu->stop_addr == b->until) return BUDGET_PC;
+            return BUDGET_BREAK;
+    }
+
+    if (b->cycles && cpu->cycles >= b->end_cycles) return BUDGET_CYCLES;
+    if (b->instructions && cpu->instructions >= b->end_instructions) return BUDGET_INSTRUCTIONS;
+    if (b->timeout > 0 && timeUp(b)) return BUDGET_TIMEOUT;
+    return BUDGET_RUN;
+}
+
+eBudgetStop budgetRun(TBudget b, T6502 cpu)
+{
+    //without a timeout there is nothing to look at in between, the budgets cut the slices anyway
+    uint64_t slice = (b->timeout > 0) ? BUDGET_SLICE : UINT64_MAX / 2;
+    eBudgetStop stop;
+    while ((stop = budgetStep(b, cpu, slice)) == BUDGET_RUN);
+    return stop;
+}
+
+void budgetEnd(TBudget b, T6502 cpu)
+{
+    if (b->until >= 0 && !b->had_breakpoint) cpuSetBreakpoint(cpu, b->until, 0);
+    cpu->stop_on_brk = 0;
+    cpu->halt_check = 0;
+}
+
+const char* budgetStopName(eBudgetStop stop, eCpuStop cpu_stop)
+{
+    static const char* cpu_stops[] = { "none", "breakpoint", "watch_read", "watch_write", "request", "brk", "halt" };
+
+    switch (stop)
+    {
+        case BUDGET_RUN:          return "none";
+        case BUDGET_CYCLES:       return "cycles";
+        case BUDGET_INSTRUCTIONS: return "instructions";
+        case BUDGET_TIMEOUT:      return "timeout";
+        case BUDGET_BRK:          return "brk";
+        case BUDGET_PC:           return "pc";
+        case BUDGET_HALT:         return "halt";
+        case BUDGET_BREAK:        return cpu_stops[cpu_stop];
+        case BUDGET_ERROR:        return "unknown_opcode";
+    }
+    return "unknown";
+}
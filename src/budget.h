@@ -0,0 +1,67 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <time.h>
+#include "types.h"
+#include "6502.h"
+
+//Termination conditions for a run. Cycle and instruction budgets shorten the cpuRun slices so the run ends
+//exactly there (an instruction takes at least 2 cycles, so a slice of 2n cycles cannot run more than n of
+//them); the wall clock is looked at between slices. Stopping at BRK, at an address and on a halt are done by
+//the CPU itself (stop_on_brk, a breakpoint, halt_check), at the exact instruction: BRK and the address are
+//looked at by the breakpoint loop of cpuRun before the instruction runs, the halt test sits in JMP and taken
+//branches and only looks further for a jump to itself.
+
+#define BUDGET_SLICE 100000     //cycles between two looks at the wall clock
+
+typedef enum
+{
+    BUDGET_RUN = 0,             //no limit reached, run on
+    BUDGET_CYCLES,              //cycle budget used up
+    BUDGET_INSTRUCTIONS,        //instruction budget used up
+    BUDGET_TIMEOUT,             //wall-clock time is up
+    BUDGET_BRK,                 //BRK at PC, not executed
+    BUDGET_PC,                  //PC reached the until address, the instruction there was not executed
+    BUDGET_HALT,                //jump-to-self or branch-to-self with no interrupt to come
+    BUDGET_BREAK,               //another breakpoint, watchpoint or cpuStop, cpu->stop tells which
+    BUDGET_ERROR                //execution error, e.g. an unknown opcode
+} eBudgetStop;
+
+typedef struct
+{
+    //limits, set before budgetStart; 0 (until: -1) means none
+    uint64_t cycles;
+    uint64_t instructions;
+    double   timeout;           //seconds
+    int32_t  until;             //address
+    word     brk;               //stop at BRK
+    word     halt;              //stop on a halt
+
+    //set by budgetStart
+    uint64_t end_cycles;
+    uint64_t end_instructions;
+    struct timespec deadline;
+    word     had_breakpoint;    //until was a breakpoint before, budgetEnd keeps it
+} BudgetStruct;
+
+typedef BudgetStruct* TBudget;
+
+//no limits, but halt detection
+void budgetInit(TBudget b);
+
+//arm the limits for a run starting at the current state of cpu
+void budgetStart(TBudget b, T6502 cpu);
+
+//run at most slice cycles within the limits, returns the limit reached or BUDGET_RUN
+eBudgetStop budgetStep(TBudget b, T6502 cpu, uint64_t slice);
+
+//run until a limit is reached (run forever without any)
+eBudgetStop budgetRun(TBudget b, T6502 cpu);
+
+//disarm: remove until's breakpoint and the CPU's BRK and halt settings
+void budgetEnd(TBudget b, T6502 cpu);
+
+//name for reports, e.g. "cycles" or "halt"; BUDGET_BREAK is named after the CPU's stop reason
+const char* budgetStopName(eBudgetStop stop, eCpuStop cpu_stop);
+
+#endif
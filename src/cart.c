@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cart.h"
+#include "mem.h"
+#include "utils.h"
+
+
+#define NROM  0
+#define MMC1  1
+#define UXROM 2
+#define CNROM 3
+#define AXROM 7
+
+static const word magic[4] = { 'N', 'E', 'S', 0x1A };
+
+
+//############################# HEADER #############################
+
+//ROM size in bytes: LSB count of units, or with the MSB nibble set to $F 2^E * (MM*2+1) (NES 2.0 only)
+static uint64_t romSize(word lsb, word msb, uint32_t unit)
+{
+    if (msb != 0x0F) return (((uint64_t)msb << 8) | lsb) * unit;
+    if ((lsb >> 2) > 32) return UINT64_MAX;
+    return ((uint64_t)1 << (lsb >> 2)) * ((lsb & 3) * 2 + 1);
+}
+
+static int parseHeader(TCart cart, const char* file)
+{
+    const word* h = cart->image;
+    if (cart->image_size < CART_HEADER_SIZE || memcmp(h, magic, sizeof(magic)) != 0)
+    {
+        logMessage("Error: %s is not an iNES image \n", file);
+        return -1;
+    }
+
+    cart->nes2 = (h[7] & 0x0C) == 0x08;
+    cart->battery = (h[6] & 0x02) != 0;
+    if (h[6] & 0x08) cart->mirroring = PPU_MIRROR_FOUR;
+    else cart->mirroring = (h[6] & 0x01) ? PPU_MIRROR_VERTICAL : PPU_MIRROR_HORIZONTAL;
+
+    uint64_t prg_size, chr_size;
+    cart->mapper = (h[6] >> 4) | (h[7] & 0xF0);
+    if (cart->nes2)
+    {
+        cart->mapper |= (h[8] & 0x0F) << 8;
+        cart->submapper = h[8] >> 4;
+        prg_size = romSize(h[4], h[9] & 0x0F, 0x4000);
+        chr_size = romSize(h[5], h[9] >> 4, 0x2000);
+    }
+    else
+    {
+        //old dumps have garbage like "DiskDude!" in bytes 7-15, the mapper's high nibble is not to be trusted then
+        if (h[12] | h[13] | h[14] | h[15]) cart->mapper &= 0x0F;
+        prg_size = (uint64_t)h[4] * 0x4000;
+        chr_size = (uint64_t)h[5] * 0x2000;
+    }
+
+    uint64_t offset = CART_HEADER_SIZE + ((h[6] & 0x04) ? CART_TRAINER_SIZE : 0);
+    if (prg_size > cart->image_size || chr_size > cart->image_size || offset + prg_size + chr_size > cart->image_size)
+    {
+        logMessage("Error: %s is truncated, header announces %llu bytes PRG and %llu bytes CHR ROM \n", file, (unsigned long long)prg_size, (unsigned long long)chr_size);
+        return -1;
+    }
+    if (prg_size == 0 || prg_size % CART_PRG_BANK != 0 || chr_size % CART_CHR_BANK != 0)
+    {
+        logMessage("Error: %s has ROM sizes that are no multiple of the bank size \n", file);
+        return -1;
+    }
+
+    cart->prg = cart->image + offset;
+    cart->prg_size = (uint32_t)prg_size;
+    cart->chr = (chr_size > 0) ? cart->prg + prg_size : NULL;
+    cart->chr_size = (uint32_t)chr_size;
+    return 0;
+}
+
+
+//############################# BANKS #############################
+
+//8K bank of PRG ROM, numbers wrap around like the unconnected high address lines of the board
+static inline const word* prgBank(TCart cart, uint32_t bank)
+{
+    return cart->prg + (bank % (cart->prg_size / CART_PRG_BANK)) * CART_PRG_BANK;
+}
+
+//16K bank to $8000 (window 0) or $C000 (window 1)
+static void mapPrg16(TCart cart, dword window, uint32_t bank)
+{
+    cart->prg_bank[window * 2] = prgBank(cart, bank * 2);
+    cart->prg_bank[window * 2 + 1] = prgBank(cart, bank * 2 + 1);
+}
+
+static void mapPrg32(TCart cart, uint32_t bank)
+{
+    for (dword i = 0; i < 4; i++) cart->prg_bank[i] = prgBank(cart, bank * 4 + i);
+}
+
+//4K bank of CHR ROM, NULL for CHR RAM
+static inline const word* chrBank(TCart cart, uint32_t bank)
+{
+    if (cart->chr == NULL) return NULL;
+    return cart->chr + (bank % (cart->chr_size / CART_CHR_BANK)) * CART_CHR_BANK;
+}
+
+static void mapChr8(TCart cart, uint32_t bank)
+{
+    cart->chr_bank[0] = chrBank(cart, bank * 2);
+    cart->chr_bank[1] = chrBank(cart, bank * 2 + 1);
+}
+
+//hand the current CHR banks and mirroring to the PPU
+static void updatePpu(TCart cart)
+{
+    if (cart->ppu == NULL) return;
+    //CHR ROM is mapped read only, the PPU never writes it as it is not marked writable
+    if (cart->chr == NULL) ppuSetCartridge(cart->ppu, cart->bank_mirroring, NULL, 1);
+    else ppuSetBanks(cart->ppu, cart->bank_mirroring, (word*)cart->chr_bank[0], (word*)cart->chr_bank[1]);
+}
+
+//set the banks from the mapper registers
+static void mapBanks(TCart cart)
+{
+    cart->bank_mirroring = cart->mirroring;
+
+    switch (cart->mapper)
+    {
+        case NROM:
+            mapPrg32(cart, 0);
+            mapChr8(cart, 0);
+            break;
+
+        case MMC1:
+        {
+            static const ePpuMirroring mirroring[4] = { PPU_MIRROR_SINGLE0, PPU_MIRROR_SINGLE1, PPU_MIRROR_VERTICAL, PPU_MIRROR_HORIZONTAL };
+            word control = cart->reg[0];
+            word prg = cart->reg[3] & 0x0F;
+
+            cart->bank_mirroring = mirroring[control & 3];
+            switch ((control >> 2) & 3)
+            {
+                case 0:
+                case 1: mapPrg32(cart, prg >> 1); break;
+                case 2: mapPrg16(cart, 0, 0); mapPrg16(cart, 1, prg); break;
+                case 3: mapPrg16(cart, 0, prg); mapPrg16(cart, 1, cart->prg_size / 0x4000 - 1); break;
+            }
+            if (control & 0x10)
+            {
+                cart->chr_bank[0] = chrBank(cart, cart->reg[1]);
+                cart->chr_bank[1] = chrBank(cart, cart->reg[2]);
+            }
+            else mapChr8(cart, cart->reg[1] >> 1);
+            break;
+        }
+
+        case UXROM:
+            mapPrg16(cart, 0, cart->reg[0]);
+            mapPrg16(cart, 1, cart->prg_size / 0x4000 - 1);
+            mapChr8(cart, 0);
+            break;
+
+        case CNROM:
+            mapPrg32(cart, 0);
+            mapChr8(cart, cart->reg[0]);
+            break;
+
+        case AXROM:
+            mapPrg32(cart, cart->reg[0] & 0x07);
+            mapChr8(cart, 0);
+            cart->bank_mirroring = (cart->reg[0] & 0x10) ? PPU_MIRROR_SINGLE1 : PPU_MIRROR_SINGLE0;
+            break;
+    }
+}
+
+
+//############################# BUS #############################
+
+//memRead takes PRG ROM straight from the current banks, the read callback is left for memPeek/memIoPass*
+static void mapReadPages(TCart cart)
+{
+    for (dword page = 0x80; page <= 0xFF; page++)
+        memSetReadPage(cart->cpu->mem, &cart->io, page, cart->prg_bank[(page >> 5) & 3] + (page & 0x1F) * PAGESIZE);
+}
+
+static word cartRead(void* dev, address a)
+{
+    TCart cart = (TCart)dev;
+    return cart->prg_bank[(a >> 13) & 3][a & (CART_PRG_BANK - 1)];
+}
+
+//writes to ROM go to the mapper's registers
+static void cartWrite(void* dev, word w, address a)
+{
+    TCart cart = (TCart)dev;
+
+    switch (cart->mapper)
+    {
+        case NROM:
+            return;
+
+        case MMC1:
+            //serial port: 5 writes shift in a register value LSB first, the last one's address selects the register
+            if (w & 0x80)
+            {
+                cart->shift = 0;
+                cart->shift_count = 0;
+                cart->reg[0] |= 0x0C;
+                break;
+            }
+            cart->shift |= (w & 1) << cart->shift_count;
+            if (++cart->shift_count < 5) return;
+            cart->reg[(a >> 13) & 3] = cart->shift;
+            cart->shift = 0;
+            cart->shift_count = 0;
+            break;
+
+        default:
+            cart->reg[0] = w;
+            break;
+    }
+
+    ePpuMirroring mirroring = cart->bank_mirroring;
+    const word* chr0 = cart->chr_bank[0];
+    const word* chr1 = cart->chr_bank[1];
+    const word* prg[4];
+    memcpy(prg, cart->prg_bank, sizeof(prg));
+    mapBanks(cart);
+
+    //PRG switches only move the read pages, the PPU only needs to catch up when its side changes
+    if (memcmp(prg, cart->prg_bank, sizeof(prg)) != 0) mapReadPages(cart);
+    if (cart->bank_mirroring != mirroring || cart->chr_bank[0] != chr0 || cart->chr_bank[1] != chr1) updatePpu(cart);
+}
+
+
+//############################# CARTRIDGE #############################
+
+int cartProbe(const char* file)
+{
+    FILE* f = fopen(file, "rb");
+    if (f == NULL) return 0;
+
+    word h[sizeof(magic)];
+    int is_ines = fread(h, 1, sizeof(h), f) == sizeof(h) && memcmp(h, magic, sizeof(magic)) == 0;
+    fclose(f);
+    return is_ines;
+}
+
+TCart cartOpen(T6502 cpu, const char* file)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        logMessage("IO error: could not open file %s \n", file);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        logMessage("IO error: could not read file %s \n", file);
+        close(fd);
+        return NULL;
+    }
+
+    //read only and shared with the page cache: nothing is copied, banks are paged in when first read
+    void* image = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+    {
+        logMessage("IO error: could not map file %s \n", file);
+        return NULL;
+    }
+
+    TCart cart = (TCart)calloc(1, sizeof(CartStruct));
+    cart->cpu = cpu;
+    cart->image = (const word*)image;
+    cart->image_size = st.st_size;
+
+    if (parseHeader(cart, file) != 0)
+    {
+        cartClose(cart);
+        return NULL;
+    }
+    if (cart->mapper != NROM && cart->mapper != MMC1 && cart->mapper != UXROM && cart->mapper != CNROM && cart->mapper != AXROM)
+    {
+        logMessage("Error: %s needs mapper %u, which is not supported \n", file, cart->mapper);
+        cartClose(cart);
+        return NULL;
+    }
+
+    //MMC1 powers up with the last PRG bank fixed at $C000, so the reset vector is found
+    if (cart->mapper == MMC1) cart->reg[0] = 0x0C | ((cart->mirroring == PPU_MIRROR_VERTICAL) ? 2 : 3);
+    mapBanks(cart);
+
+    cart->io.dev = cart;
+    cart->io.read = cartRead;
+    cart->io.write = cartWrite;
+    cart->io.peek = cartRead;       //ROM reads have no side effects
+    cart->io.catchUp = NULL;
+    if (memMapIo(cpu->mem, 0x80, 0xFF, &cart->io) != 0)
+    {
+        cartClose(cart);
+        return NULL;
+    }
+    mapReadPages(cart);
+    return cart;
+}
+
+void cartSetPpu(TCart cart, TPpu ppu)
+{
+    cart->ppu = ppu;
+    updatePpu(cart);
+}
+
+void cartClose(TCart cart)
+{
+    memUnmapIo(cart->cpu->mem, &cart->io);
+    munmap((void*)cart->image, cart->image_size);
+    free(cart);
+}
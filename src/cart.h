@@ -0,0 +1,67 @@
+#ifndef CART_H
+#define CART_H
+
+#include <stddef.h>
+#include "types.h"
+#include "6502.h"
+#include "ppu.h"
+
+//NES cartridge from an iNES or NES 2.0 (.nes) file. The file is mmapped read only and never copied: PRG ROM
+//is a device on $8000-$FFFF whose pages memRead reads directly from the four current 8K banks of the
+//mapping (memSetReadPage, updated on bank switches), CHR ROM banks are handed to the PPU as pointers into
+//it as well. Only the banks a program touches are ever paged in.
+//$6000-$7FFF (PRG RAM) is left to plain RAM. Mapper and mirroring come from the header; supported mappers:
+//0 NROM, 1 MMC1 (SxROM), 2 UxROM, 3 CNROM and 7 AxROM.
+
+#define CART_HEADER_SIZE  16
+#define CART_TRAINER_SIZE 512
+#define CART_PRG_BANK     0x2000          //CPU window granularity
+#define CART_CHR_BANK     0x1000          //PPU window granularity
+
+typedef struct CartStruct
+{
+    T6502       cpu;
+    TPpu        ppu;                //NULL until cartSetPpu: CHR and mirroring are not emulated
+    TIoHandler  io;                 //$8000-$FFFF
+
+    const word* image;              //mmapped file
+    size_t      image_size;
+    const word* prg;                //PRG ROM in image
+    uint32_t    prg_size;
+    const word* chr;                //CHR ROM in image, NULL for CHR RAM
+    uint32_t    chr_size;
+
+    //from the header
+    dword       mapper;
+    word        submapper;
+    word        nes2;               //NES 2.0 header
+    word        battery;            //battery backed PRG RAM
+    ePpuMirroring mirroring;        //initial mirroring
+
+    //current banks
+    const word* prg_bank[4];        //$8000, $A000, $C000, $E000
+    const word* chr_bank[2];        //$0000, $1000 in the PPU's address space, NULL for CHR RAM
+    ePpuMirroring bank_mirroring;
+
+    //mapper registers
+    word        reg[4];             //MMC1: control, CHR 0, CHR 1, PRG; others: reg[0] is the bank select
+    word        shift;              //MMC1 serial port
+    word        shift_count;
+} CartStruct;
+
+typedef CartStruct* TCart;
+
+//1 if file starts with an iNES header
+int cartProbe(const char* file);
+
+//map cartridge file to $8000-$FFFF, before cpuReset so it sees the reset vector; NULL if the file is not a
+//valid iNES/NES 2.0 image or its mapper is not supported
+TCart cartOpen(T6502 cpu, const char* file);
+
+//hand CHR ROM and mirroring to ppu, and the banks switched from now on
+void cartSetPpu(TCart cart, TPpu ppu);
+
+//unmap from the bus, release the file and free cart; close the PPU first, it points into the file
+void cartClose(TCart cart);
+
+#endif
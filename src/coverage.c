@@ -0,0 +1,26 @@
+#include <string.h>
+#include "coverage.h"
+
+word covLocalMap[COV_MAP_SIZE];
+word* covMap = covLocalMap;
+address covPrevLoc = 0;
+
+//clear map and edge history before the next run
+void covReset(void)
+{
+    memset(covMap, 0, COV_MAP_SIZE);
+    covPrevLoc = 0;
+}
+
+//number of non-zero edge and opcode entries in the map
+void covCount(uint32_t* edges, uint32_t* opcodes)
+{
+    *edges = 0;
+    *opcodes = 0;
+
+    for (uint32_t i = 0; i <= COV_EDGE_MASK; i++)
+        if (covMap[i]) (*edges)++;
+
+    for (uint32_t i = 0; i < 256; i++)
+        if (covMap[COV_OPCODE_BASE + i]) (*opcodes)++;
+}
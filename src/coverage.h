@@ -0,0 +1,33 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include "types.h"
+
+//Guest coverage for coverage-guided fuzzing, compiled into the run loop only with -DENABLE_COVERAGE.
+//The map has the AFL layout (64K byte hit counters), so it can be shared with a fuzzer as it is:
+//[0x0000, 0x7FFF] PC edges (previous PC -> PC), hashed
+//[0x8000, 0x80FF] executed opcodes, i.e. opcode x addressing mode since the opcode implies the mode
+#define COV_MAP_SIZE    0x10000
+#define COV_EDGE_MASK   0x7FFF
+#define COV_OPCODE_BASE 0x8000
+
+extern word* covMap;        //current map, points to covLocalMap unless a fuzzer provides its own
+extern word covLocalMap[COV_MAP_SIZE];
+extern address covPrevLoc;  //hashed location of the previous instruction
+
+//record execution of opcode at pc
+static inline void covTrace(address pc, word opcode)
+{
+    address loc = (address)(pc * 0x9E37);           //scatter neighbouring PCs over the map
+    covMap[(loc ^ covPrevLoc) & COV_EDGE_MASK]++;
+    covMap[COV_OPCODE_BASE + opcode]++;
+    covPrevLoc = loc >> 1;                          //shift, so A->B and B->A are different edges
+}
+
+//clear map and edge history before the next run
+void covReset(void);
+
+//number of non-zero edge and opcode entries in the map
+void covCount(uint32_t* edges, uint32_t* opcodes);
+
+#endif
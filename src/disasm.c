@@ -0,0 +1,75 @@
+#include <string.h>
+#include "disasm.h"
+#include "opcodes.h"
+
+
+//how an addressing mode is written: prefix, operand digits (0, 2 or 4), suffix
+typedef struct
+{
+    const char* prefix;
+    word        prefix_len;
+    word        digits;
+    const char* suffix;
+    word        suffix_len;
+} TModeFormat;
+
+#define FORMAT(prefix, digits, suffix) { prefix, sizeof(prefix) - 1, digits, suffix, sizeof(suffix) - 1 }
+
+static const TModeFormat modeFormats[MODE_COUNT] =
+{
+    [MODE_IMPL]  = FORMAT("",     0, ""),
+    [MODE_ACCU]  = FORMAT(" A",   0, ""),
+    [MODE_IMMD]  = FORMAT(" #$",  2, ""),
+    [MODE_ZRP]   = FORMAT(" $",   2, ""),
+    [MODE_ZRPX]  = FORMAT(" $",   2, ",X"),
+    [MODE_ZRPY]  = FORMAT(" $",   2, ",Y"),
+    [MODE_ABS]   = FORMAT(" $",   4, ""),
+    [MODE_ABSX]  = FORMAT(" $",   4, ",X"),
+    [MODE_ABSY]  = FORMAT(" $",   4, ",Y"),
+    [MODE_IND]   = FORMAT(" ($",  4, ")"),
+    [MODE_XIND]  = FORMAT(" ($",  2, ",X)"),
+    [MODE_INDY]  = FORMAT(" ($",  2, "),Y"),
+    [MODE_REL]   = FORMAT(" $",   4, ""),       //operand is the branch target
+    [MODE_ZIND]  = FORMAT(" ($",  2, ")"),
+    [MODE_AXIND] = FORMAT(" ($",  4, ",X)")
+};
+
+
+uint32_t disasmFormat(char* text, address pc, word opcode, word op1, word op2)
+{
+    const TOpcodeInfo* info = &opcodeTable[opcode];
+    char* p = text;
+
+    if (info->mnemonic == NULL)
+    {
+        memcpy(p, ".byt $", 6);
+        p = disasmHex8(p + 6, opcode);
+        *p = '\0';
+        return p - text;
+    }
+
+    const TModeFormat* f = &modeFormats[info->mode];
+    memcpy(p, info->mnemonic, 3);
+    memcpy(p + 3, f->prefix, f->prefix_len);
+    p += 3 + f->prefix_len;
+
+    if (info->mode == MODE_REL) p = disasmHex16(p, (address)(pc + 2 + (sword)op1));
+    else if (f->digits == 4) p = disasmHex16(p, (address)(op2 << 8 | op1));
+    else if (f->digits == 2) p = disasmHex8(p, op1);
+
+    memcpy(p, f->suffix, f->suffix_len);
+    p += f->suffix_len;
+    *p = '\0';
+    return p - text;
+}
+
+word disasmMemory(TMemory mem, address pc, char* text)
+{
+    word opcode = memPeek(mem, pc);
+    word length = opcodeTable[opcode].length;
+    word op1 = (length > 1) ? memPeek(mem, pc + 1) : 0;
+    word op2 = (length > 2) ? memPeek(mem, pc + 2) : 0;
+
+    disasmFormat(text, pc, opcode, op1, op2);
+    return (length > 0) ? length : 1;
+}
@@ -0,0 +1,35 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include "types.h"
+#include "mem.h"
+
+//Disassembler driven by opcodeTable (the X macro list in opcodes.h), so it knows exactly the opcodes of the
+//variant being built; bcdtest checks that cpuStep dispatches the same set. Formatting goes into a caller buffer without printf or allocation:
+//mnemonic, then the addressing mode's prefix, hex operand and suffix, e.g. "LDA ($12),Y".
+//Branch targets are printed as absolute address, undocumented opcodes as ".byt $xx" (1 byte).
+
+#define DISASM_TEXT_MAX 16      //longest text incl. terminating 0, "JMP ($1234,X)"
+
+//format the instruction opcode, op1, op2 located at pc into text (DISASM_TEXT_MAX chars),
+//returns the length of the text; the instruction length is opcodeTable[opcode].length (1 if undocumented)
+uint32_t disasmFormat(char* text, address pc, word opcode, word op1, word op2);
+
+//disassemble the instruction at pc without side effects on I/O, returns its length in bytes
+word disasmMemory(TMemory mem, address pc, char* text);
+
+//write v as 2 / 4 uppercase hex digits to p, returns p behind them (no terminating 0)
+static inline char* disasmHex8(char* p, word v)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    p[0] = digits[v >> 4];
+    p[1] = digits[v & 0xF];
+    return p + 2;
+}
+
+static inline char* disasmHex16(char* p, address v)
+{
+    return disasmHex8(disasmHex8(p, v >> 8), v & 0xFF);
+}
+
+#endif
@@ -0,0 +1,167 @@
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include "flight.h"
+#include "mem.h"
+#include "disasm.h"
+
+
+const char* flightDumpFile = NULL;
+
+#define DUMP_BUFFER 4096
+
+//dump output: formatted into buf by hand and written with write(2), nothing that is unsafe in a signal handler
+typedef struct
+{
+    int      fd;
+    int      failed;
+    uint32_t length;
+    char     buf[DUMP_BUFFER];
+} TDumpOut;
+
+
+//############################# OUTPUT #############################
+
+static void dumpFlush(TDumpOut* out)
+{
+    const char* p = out->buf;
+    while (out->length > 0 && !out->failed)
+    {
+        ssize_t n = write(out->fd, p, out->length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) out->failed = 1;
+        else
+        {
+            p += n;
+            out->length -= n;
+        }
+    }
+    out->length = 0;
+}
+
+static void dumpChars(TDumpOut* out, const char* s, uint32_t length)
+{
+    if (out->length + length > DUMP_BUFFER) dumpFlush(out);
+    memcpy(out->buf + out->length, s, length);
+    out->length += length;
+}
+
+static void dumpString(TDumpOut* out, const char* s)
+{
+    dumpChars(out, s, strlen(s));
+}
+
+static void dumpHex8(TDumpOut* out, word v)
+{
+    char text[2];
+    disasmHex8(text, v);
+    dumpChars(out, text, 2);
+}
+
+static void dumpHex16(TDumpOut* out, address v)
+{
+    char text[4];
+    disasmHex16(text, v);
+    dumpChars(out, text, 4);
+}
+
+//v in decimal, right aligned in width characters (0: no padding)
+static void dumpDecimal(TDumpOut* out, uint64_t v, uint32_t width)
+{
+    char text[24];
+    uint32_t n = sizeof(text);
+    do
+    {
+        text[--n] = '0' + v % 10;
+        v /= 10;
+    } while (v != 0);
+    while (sizeof(text) - n < width && n > 0) text[--n] = ' ';
+    dumpChars(out, text + n, sizeof(text) - n);
+}
+
+//" A=xx X=xx Y=xx P=xx SP=xx", SP as its low byte like the 8-bit register
+static void dumpRegs(TDumpOut* out, word a, word x, word y, word p, word sp)
+{
+    dumpString(out, "A=");
+    dumpHex8(out, a);
+    dumpString(out, " X=");
+    dumpHex8(out, x);
+    dumpString(out, " Y=");
+    dumpHex8(out, y);
+    dumpString(out, " P=");
+    dumpHex8(out, p);
+    dumpString(out, " SP=");
+    dumpHex8(out, sp);
+}
+
+
+//############################# DUMP #############################
+
+//append crash dump (reason, registers, recorded instructions, memory) to flightDumpFile
+int flightDump(T6502 cpu, const char* reason)
+{
+    if (flightDumpFile == NULL || cpu == NULL) return 0;
+
+    TDumpOut out;
+    out.fd = open(flightDumpFile, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    out.failed = 0;
+    out.length = 0;
+    if (out.fd < 0) return -1;
+
+    dumpString(&out, "*** 6502 crash dump: ");
+    dumpString(&out, reason);
+    dumpString(&out, " ***\ncycles: ");
+    dumpDecimal(&out, cpu->cycles, 0);
+    dumpString(&out, ", instructions: ");
+    dumpDecimal(&out, cpu->instructions, 0);
+    dumpString(&out, "\nPC=");
+    dumpHex16(&out, cpu->PC);
+    dumpString(&out, " IR=");
+    dumpHex8(&out, cpu->IR);
+    dumpString(&out, " ");
+    dumpRegs(&out, cpu->A, cpu->X, cpu->Y, cpu->P, cpu->SP & 0xFF);
+    dumpString(&out, "\n\n");
+
+    //recorded instructions, oldest first; registers are the ones before the instruction ran,
+    //operands are read from memory now as only the opcode is recorded
+    uint64_t count = (cpu->instructions < FLIGHT_SIZE) ? cpu->instructions : FLIGHT_SIZE;
+    dumpString(&out, "last ");
+    dumpDecimal(&out, count, 0);
+    dumpString(&out, " instructions:\n");
+    for (uint64_t n = cpu->instructions - count; n < cpu->instructions; n++)
+    {
+        const TFlightEntry* e = &cpu->flight[n & (FLIGHT_SIZE - 1)];
+        char text[DISASM_TEXT_MAX];
+        uint32_t length = disasmFormat(text, e->pc, e->opcode, memPeek(cpu->mem, e->pc + 1), memPeek(cpu->mem, e->pc + 2));
+
+        dumpDecimal(&out, n, 12);
+        dumpString(&out, "  ");
+        dumpHex16(&out, e->pc);
+        dumpString(&out, "  ");
+        dumpHex8(&out, e->opcode);
+        dumpString(&out, " ");
+        dumpChars(&out, text, length);
+        dumpChars(&out, "              ", 15 - length);    //column of 13 characters, then 2 spaces
+        dumpRegs(&out, e->a, e->x, e->y, e->p, e->sp);
+        dumpString(&out, "\n");
+    }
+
+    dumpString(&out, "\nmemory:");
+    for (uint32_t a = 0; a < MEMSIZE; a++)
+    {
+        if (a % 16 == 0)
+        {
+            dumpString(&out, "\n");
+            dumpHex16(&out, a);
+            dumpString(&out, ":");
+        }
+        dumpString(&out, " ");
+        dumpHex8(&out, memPeek(cpu->mem, a));
+    }
+    dumpString(&out, "\n\n");
+
+    dumpFlush(&out);
+    close(out.fd);
+    return out.failed ? -1 : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef FLIGHT_H
+#define FLIGHT_H
+
+#include "types.h"
+#include "6502.h"
+
+//Flight recorder: cpuStep stores every fetched instruction together with the registers before execution
+//in cpu->flight, a ring of the last FLIGHT_SIZE instructions. That costs one 8 byte store per instruction,
+//so it is always on (build with -DDISABLE_FLIGHT_RECORDER to remove it).
+//On an error or a signal the ring is written out as crash dump, together with a snapshot of registers and
+//memory. The dump is formatted by hand and written with write(2), so it may be taken from a signal handler.
+
+extern const char* flightDumpFile;  //crash dumps are appended to this file, NULL: no dumps
+
+//remember the instruction just fetched into cpu->IR, cpu->instructions is its number
+static inline void flightRecord(T6502 cpu)
+{
+    TFlightEntry* e = &cpu->flight[cpu->instructions & (FLIGHT_SIZE - 1)];
+    e->pc = cpu->PC;
+    e->opcode = cpu->IR;
+    e->a = cpu->A;
+    e->x = cpu->X;
+    e->y = cpu->Y;
+    e->p = cpu->P;
+    e->sp = cpu->SP & 0xFF;
+}
+
+//append crash dump (reason, registers, recorded instructions, memory) to flightDumpFile, async-signal-safe;
+//returns -1 if the file could not be opened or written
+int flightDump(T6502 cpu, const char* reason);
+
+#endif
@@ -0,0 +1,522 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "gdb.h"
+#include "mem.h"
+#include "watch.h"
+#include "utils.h"
+
+
+#define GDB_SLICE 100000    //cycles per cpuRun call while continuing, the debugger's Ctrl-C is looked for in between
+#define GDB_CTRL_C 0x03
+
+//Z packet types
+typedef enum
+{
+    GDB_BREAK_SW = 0,
+    GDB_BREAK_HW = 1,
+    GDB_WATCH_WRITE = 2,
+    GDB_WATCH_READ = 3,
+    GDB_WATCH_ACCESS = 4
+} eGdbPoint;
+
+//watchpoint as set by the debugger, the engine only knows per address counters
+typedef struct
+{
+    word       used;
+    word       type;            //eGdbPoint
+    address    addr;
+    dword      len;
+} TGdbWatch;
+
+typedef struct
+{
+    T6502     cpu;
+    int       fd;
+    word      no_ack;
+    char      in[GDB_PACKET_SIZE];
+    size_t    in_len;
+    size_t    in_pos;
+    word      ctrl_c;           //0x03 arrived while the CPU was running
+    word      closed;           //connection closed while the CPU was running
+    TWatch    watch;
+    TGdbWatch watches[GDB_MAX_WATCHPOINTS];
+} GdbStruct;
+
+typedef GdbStruct* TGdb;
+
+static const char hexDigits[] = "0123456789abcdef";
+
+
+//############################# WATCHPOINTS #############################
+
+static word watchKind(word type)
+{
+    if (type == GDB_WATCH_WRITE) return WATCH_WRITE;
+    if (type == GDB_WATCH_READ) return WATCH_READ;
+    return WATCH_READ | WATCH_WRITE;
+}
+
+static int addWatch(TGdb gdb, word type, address addr, dword len)
+{
+    if (len == 0 || len > MEMSIZE) return -1;
+
+    for (int i = 0; i < GDB_MAX_WATCHPOINTS; i++)
+    {
+        TGdbWatch* w = &gdb->watches[i];
+        if (w->used) continue;
+        if (watchAdd(gdb->watch, addr, addr + len - 1, watchKind(type)) != 0) return -1;
+
+        w->used = 1;
+        w->type = type;
+        w->addr = addr;
+        w->len = len;
+        return 0;
+    }
+    return -1;
+}
+
+static int removeWatch(TGdb gdb, word type, address addr, dword len)
+{
+    for (int i = 0; i < GDB_MAX_WATCHPOINTS; i++)
+    {
+        TGdbWatch* w = &gdb->watches[i];
+        if (!w->used || w->type != type || w->addr != addr || w->len != len) continue;
+
+        watchRemove(gdb->watch, addr, addr + len - 1, watchKind(type));
+        w->used = 0;
+        return 0;
+    }
+    return -1;
+}
+
+//stop reply prefix for a watchpoint hit: "" (write), "r" or "a", the kind of watchpoint that caught it
+static const char* watchPrefix(TGdb gdb, eCpuStop reason, address a)
+{
+    word exact = (reason == CPU_STOP_WATCH_WRITE) ? GDB_WATCH_WRITE : GDB_WATCH_READ;
+    const char* prefix = "a";
+
+    for (int i = 0; i < GDB_MAX_WATCHPOINTS; i++)
+    {
+        TGdbWatch* w = &gdb->watches[i];
+        if (w->used && w->type == exact && (address)(a - w->addr) < w->len) prefix = (exact == GDB_WATCH_WRITE) ? "" : "r";
+    }
+    return prefix;
+}
+
+//############################# PACKETS #############################
+
+//next byte from the debugger, -1 if the connection is closed
+static int getByte(TGdb gdb)
+{
+    if (gdb->in_pos == gdb->in_len)
+    {
+        ssize_t n = read(gdb->fd, gdb->in, sizeof(gdb->in));
+        if (n <= 0) return -1;
+        gdb->in_len = n;
+        gdb->in_pos = 0;
+    }
+    return (unsigned char)gdb->in[gdb->in_pos++];
+}
+
+static int hexValue(int c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static uint32_t parseHex(const char** text)
+{
+    uint32_t v = 0;
+    while (hexValue(**text) >= 0) v = (v << 4) | hexValue(*(*text)++);
+    return v;
+}
+
+//read one packet into buf (0 terminated), acknowledged unless in no-ack mode; returns its length, -1 if closed
+static int readPacket(TGdb gdb, char* buf)
+{
+    for (;;)
+    {
+        int c;
+        do
+        {
+            c = getByte(gdb);
+            if (c < 0) return -1;
+        } while (c != '$');     //acks, and Ctrl-C while stopped
+
+        int len = 0;
+        word sum = 0;
+        while ((c = getByte(gdb)) != '#')
+        {
+            if (c < 0) return -1;
+            if (len < GDB_PACKET_SIZE - 1) buf[len++] = c;
+            sum += c;
+        }
+        buf[len] = '\0';
+
+        int hi = hexValue(getByte(gdb));
+        int lo = hexValue(getByte(gdb));
+        int ok = (hi >= 0 && lo >= 0 && (word)(hi << 4 | lo) == sum);
+        if (!gdb->no_ack && write(gdb->fd, ok ? "+" : "-", 1) != 1) return -1;
+        if (ok || gdb->no_ack) return len;
+    }
+}
+
+static int sendPacket(TGdb gdb, const char* data)
+{
+    static char out[GDB_PACKET_SIZE * 2 + 4];
+    size_t len = strlen(data);
+    word sum = 0;
+
+    out[0] = '$';
+    for (size_t i = 0; i < len; i++) sum += (unsigned char)data[i];
+    memcpy(out + 1, data, len);
+    out[len + 1] = '#';
+    out[len + 2] = hexDigits[sum >> 4];
+    out[len + 3] = hexDigits[sum & 0xF];
+
+    return (write(gdb->fd, out, len + 4) == (ssize_t)(len + 4)) ? 0 : -1;
+}
+
+//look for Ctrl-C from the debugger while the CPU runs, returns 1 if the CPU has to stop
+static int pollDebugger(TGdb gdb)
+{
+    struct pollfd p = { gdb->fd, POLLIN, 0 };
+    while (gdb->in_pos < gdb->in_len || poll(&p, 1, 0) > 0)
+    {
+        if (gdb->in_pos < gdb->in_len && gdb->in[gdb->in_pos] == '$') break;   //a packet, left for readPacket
+        int c = getByte(gdb);
+        if (c < 0)
+        {
+            gdb->closed = 1;
+            return 1;
+        }
+        if (c == GDB_CTRL_C) gdb->ctrl_c = 1;
+    }
+    return gdb->ctrl_c;
+}
+
+//############################# COMMANDS #############################
+
+static char* putHex8(char* p, word v)
+{
+    *p++ = hexDigits[v >> 4];
+    *p++ = hexDigits[v & 0xF];
+    return p;
+}
+
+//register n as little endian hex, A X Y P SP PC
+static char* putRegister(char* p, T6502 cpu, int n)
+{
+    switch (n)
+    {
+        case 0: return putHex8(p, cpu->A);
+        case 1: return putHex8(p, cpu->X);
+        case 2: return putHex8(p, cpu->Y);
+        case 3: return putHex8(p, cpu->P);
+        case 4: return putHex8(p, cpu->SP & 0xFF);
+        default: return putHex8(putHex8(p, cpu->PC & 0xFF), cpu->PC >> 8);
+    }
+}
+
+//set register n from little endian hex, returns the number of characters used
+static int setRegister(T6502 cpu, int n, const char* hex)
+{
+    int digits = (n == 5) ? 4 : 2;
+    uint32_t v = 0;
+    for (int i = 0; i < digits; i++)
+    {
+        int d = hexValue(hex[i]);
+        if (d < 0) return -1;
+        v |= d << (((i & 1) ? 0 : 4) + (i / 2) * 8);   //bytes little endian, digits of a byte big endian
+    }
+    switch (n)
+    {
+        case 0: cpu->A = v; break;
+        case 1: cpu->X = v; break;
+        case 2: cpu->Y = v; break;
+        case 3: cpu->P = v; break;
+        case 4: cpu->SP = 0x100 | v; break;
+        default: cpu->PC = v; break;
+    }
+    return digits;
+}
+
+//stop reply for the status of the last cpuRun
+static void stopReply(TGdb gdb, eCpuStepStatus status, char* reply)
+{
+    if (gdb->ctrl_c)
+    {
+        gdb->ctrl_c = 0;
+        strcpy(reply, "S02");
+        return;
+    }
+    if (status == CPU_STEP_ERROR)
+    {
+        strcpy(reply, "S04");   //SIGILL
+        return;
+    }
+    eCpuStop reason = gdb->cpu->stop;
+    if (status == CPU_STEP_BREAK && (reason == CPU_STOP_WATCH_READ || reason == CPU_STOP_WATCH_WRITE))
+    {
+        sprintf(reply, "T05%swatch:%x;", watchPrefix(gdb, reason, gdb->cpu->stop_addr), gdb->cpu->stop_addr);
+        return;
+    }
+    strcpy(reply, "S05");       //SIGTRAP: breakpoint or single step
+}
+
+static eCpuStepStatus resume(TGdb gdb, int step)
+{
+    //one instruction, plus the events and the interrupt due before it
+    if (step) return cpuRun(gdb->cpu, 1);
+
+    for (;;)
+    {
+        eCpuStepStatus status = cpuRun(gdb->cpu, GDB_SLICE);
+        if (status != CPU_STEP_OK) return status;
+        if (pollDebugger(gdb)) return CPU_STEP_BREAK;
+    }
+}
+
+//handle one packet, reply holds the answer; returns 1 to go on, 0 after detach, -1 after kill
+static int command(TGdb gdb, char* packet, char* reply)
+{
+    T6502 cpu = gdb->cpu;
+    const char* p = packet + 1;
+    reply[0] = '\0';
+
+    switch (packet[0])
+    {
+        case '?':
+            strcpy(reply, "S05");
+            break;
+
+        case 'g':
+        {
+            char* r = reply;
+            for (int n = 0; n < 6; n++) r = putRegister(r, cpu, n);
+            *r = '\0';
+            break;
+        }
+
+        case 'G':
+            for (int n = 0; n < 6; n++)
+            {
+                int used = setRegister(cpu, n, p);
+                if (used < 0) break;
+                p += used;
+            }
+            strcpy(reply, "OK");
+            break;
+
+        case 'p':
+        {
+            uint32_t n = parseHex(&p);
+            if (n > 5) strcpy(reply, "E01");
+            else *putRegister(reply, cpu, n) = '\0';
+            break;
+        }
+
+        case 'P':
+        {
+            uint32_t n = parseHex(&p);
+            if (n > 5 || *p++ != '=' || setRegister(cpu, n, p) < 0) strcpy(reply, "E01");
+            else strcpy(reply, "OK");
+            break;
+        }
+
+        case 'm':
+        {
+            address a = parseHex(&p);
+            uint32_t len = (*p == ',') ? (p++, parseHex(&p)) : 0;
+            if (len > GDB_PACKET_SIZE / 2 - 1) len = GDB_PACKET_SIZE / 2 - 1;
+            char* r = reply;
+            for (uint32_t i = 0; i < len; i++) r = putHex8(r, memPeek(cpu->mem, a + i));
+            *r = '\0';
+            break;
+        }
+
+        case 'M':
+        {
+            address a = parseHex(&p);
+            uint32_t len = (*p == ',') ? (p++, parseHex(&p)) : 0;
+            if (*p++ != ':')
+            {
+                strcpy(reply, "E01");
+                break;
+            }
+            for (uint32_t i = 0; i < len; i++)
+            {
+                int hi = hexValue(p[2 * i]);
+                int lo = hexValue(p[2 * i + 1]);
+                if (hi < 0 || lo < 0) break;
+                memWrite(cpu->mem, hi << 4 | lo, a + i);
+            }
+            strcpy(reply, "OK");
+            break;
+        }
+
+        case 'c':
+        case 's':
+        {
+            if (*p != '\0') cpu->PC = parseHex(&p);
+            eCpuStepStatus status = resume(gdb, packet[0] == 's');
+            if (gdb->closed) return -1;
+            stopReply(gdb, status, reply);
+            break;
+        }
+
+        case 'Z':
+        case 'z':
+        {
+            word type = parseHex(&p);
+            address a = (*p == ',') ? (p++, parseHex(&p)) : 0;
+            dword len = (*p == ',') ? (p++, parseHex(&p)) : 1;
+            int set = (packet[0] == 'Z');
+            int ok = 0;
+
+            if (type == GDB_BREAK_SW || type == GDB_BREAK_HW) cpuSetBreakpoint(cpu, a, set);
+            else if (type <= GDB_WATCH_ACCESS) ok = set ? addWatch(gdb, type, a, len) : removeWatch(gdb, type, a, len);
+            else break;     //unsupported: empty reply
+            strcpy(reply, (ok == 0) ? "OK" : "E01");
+            break;
+        }
+
+        case 'H':
+        case 'T':
+            strcpy(reply, "OK");
+            break;
+
+        case 'q':
+            if (strncmp(packet, "qSupported", 10) == 0) sprintf(reply, "PacketSize=%x;QStartNoAckMode+", GDB_PACKET_SIZE);
+            else if (strcmp(packet, "qAttached") == 0) strcpy(reply, "1");
+            break;
+
+        case 'Q':
+            if (strcmp(packet, "QStartNoAckMode") == 0) strcpy(reply, "OK");
+            break;
+
+        case 'D':
+            strcpy(reply, "OK");
+            return 0;
+
+        case 'k':
+            return -1;
+
+        default:
+            break;      //unsupported: empty reply
+    }
+    return 1;
+}
+
+//############################# CONNECTION #############################
+
+//listen on 127.0.0.1:port or a Unix socket, wait for the debugger and return its connection
+static int acceptDebugger(const char* where)
+{
+    char* end;
+    long port = strtol(where, &end, 10);
+    int tcp = (*where != '\0' && *end == '\0');
+    int fd;
+
+    if (tcp)
+    {
+        struct sockaddr_in sa;
+        int on = 1;
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_port = htons(port);
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_un sa;
+        if (strlen(where) >= sizeof(sa.sun_path)) return -1;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        strcpy(sa.sun_path, where);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        unlink(where);
+        if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (listen(fd, 1) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    logMessage("Waiting for debugger on %s%s \n", tcp ? "127.0.0.1:" : "", where);
+
+    int conn = accept(fd, NULL, NULL);
+    close(fd);
+    if (!tcp) unlink(where);
+    if (conn < 0) return -1;
+
+    if (tcp)
+    {
+        int on = 1;
+        setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));   //one small packet per command
+    }
+    return conn;
+}
+
+int gdbServe(T6502 cpu, const char* where)
+{
+    static GdbStruct gdb;
+    static char packet[GDB_PACKET_SIZE];
+    static char reply[GDB_PACKET_SIZE];
+
+    memset(&gdb, 0, sizeof(gdb));
+    gdb.cpu = cpu;
+    gdb.fd = acceptDebugger(where);
+    if (gdb.fd < 0)
+    {
+        logMessage("IO error: could not open debugger socket %s \n", where);
+        return -1;
+    }
+    gdb.watch = watchInit(cpu);
+
+    int result = 1;
+    while (readPacket(&gdb, packet) >= 0)
+    {
+        int r = command(&gdb, packet, reply);
+        if (r < 0) break;
+        if (sendPacket(&gdb, reply) != 0) break;
+        if (strcmp(packet, "QStartNoAckMode") == 0) gdb.no_ack = 1;
+        if (r == 0)
+        {
+            result = 0;
+            break;
+        }
+    }
+
+    //leave the CPU without debugger hooks, so a detached run is at full speed again
+    watchClose(gdb.watch);
+    for (dword pc = 0; pc < MEMSIZE; pc++) cpuSetBreakpoint(cpu, pc, 0);
+    close(gdb.fd);
+    return result;
+}
@@ -0,0 +1,24 @@
+#ifndef GDB_H
+#define GDB_H
+
+#include "6502.h"
+
+//GDB remote serial protocol stub: a debugger (gdb, or any RSP client) connects to a localhost TCP port or a
+//Unix socket and controls the CPU while the emulator waits for it.
+//- registers (g/G, p/P) in this order: A, X, Y, P, SP (8 bit each) and PC (16 bit, little endian)
+//- memory read (m) without side effects on devices, write (M) through the bus
+//- single step (s) runs one instruction, continue (c) runs in cpuRun slices until a breakpoint, a watchpoint,
+//  an execution error or Ctrl-C (0x03) from the debugger
+//- breakpoints (Z0/Z1) are the CPU's PC bitmap: cpuRun only looks at it while it is not empty
+//- watchpoints (Z2 write, Z3 read, Z4 access; instruction fetches count as reads) go to the watchpoint
+//  engine (watch.h), which puts a handler on the watched pages only
+//- D (detach) lets the emulation run on, k (kill) ends it
+
+#define GDB_MAX_WATCHPOINTS 64
+#define GDB_PACKET_SIZE     4096
+
+//serve one debugger connection on where: a port number (127.0.0.1:port) or the path of a Unix socket;
+//returns 0 after a detach, 1 after a kill or a closed connection, -1 if the socket could not be set up
+int gdbServe(T6502 cpu, const char* where);
+
+#endif
@@ -0,0 +1,241 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hle.h"
+#include "mem.h"
+#ifdef ENABLE_PROFILER
+    #include "profile.h"
+#endif
+
+
+uint32_t hleChecksum(TMemory mem, address a, uint32_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        crc ^= memPeek(mem, (address)(a + i));
+        for (dword bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static THleRoutine* findRoutine(THle h, address entry)
+{
+    for (dword i = 0; i < h->count; i++)
+        if (h->routines[i].entry == entry) return &h->routines[i];
+    return NULL;
+}
+
+
+//############################# WRITE GUARDS #############################
+
+//a write into a routine makes its next call check the code again
+static void guardWrite(void* dev, word w, address a)
+{
+    THle h = (THle)dev;
+    for (dword i = 0; i < h->count; i++)
+    {
+        THleRoutine* r = &h->routines[i];
+        if ((address)(a - r->entry) < r->length) r->checked = 0;
+    }
+    memIoPassWrite(h->cpu->mem, &h->guard[a >> 8], w, a);
+}
+
+static word guardRead(void* dev, address a)
+{
+    THle h = (THle)dev;
+    return memIoPassRead(h->cpu->mem, &h->guard[a >> 8], a);
+}
+
+static word guardPeek(void* dev, address a)
+{
+    THle h = (THle)dev;
+    return memIoPassPeek(h->cpu->mem, &h->guard[a >> 8], a);
+}
+
+//first and last page of r, the code may wrap around at $FFFF
+static void routinePages(const THleRoutine* r, word* first, word* last)
+{
+    *first = r->entry >> 8;
+    *last = (address)(r->entry + r->length - 1) >> 8;
+}
+
+//count the routine r on its pages by delta, maps or unmaps the guards as needed; returns -1 if a guard
+//could not be mapped
+static int guardRoutine(THle h, const THleRoutine* r, int delta)
+{
+    TMemory mem = h->cpu->mem;
+    word pages[2];
+    routinePages(r, &pages[0], &pages[1]);
+
+    for (dword i = 0; i < 2; i++)
+    {
+        word page = pages[i];
+        if (i == 1 && page == pages[0]) break;
+
+        if (delta > 0 && h->guarded[page]++ == 0)
+        {
+            //on plain RAM the guard lets memRead read RAM directly, only writes go through it
+            int ram = (mem->io[page] == NULL);
+            if (memMapIo(mem, page, page, &h->guard[page]) != 0)
+            {
+                h->guarded[page]--;
+                if (i == 1 && --h->guarded[pages[0]] == 0) memUnmapIo(mem, &h->guard[pages[0]]);
+                return -1;
+            }
+            if (ram) memSetReadPage(mem, &h->guard[page], page, &mem->ram[page * PAGESIZE]);
+        }
+        if (delta < 0 && --h->guarded[page] == 0) memUnmapIo(mem, &h->guard[page]);
+    }
+    return 0;
+}
+
+//1 if every write into r goes through its guards: the guards are the only device on its pages
+static int isGuarded(THle h, const THleRoutine* r)
+{
+    TMemory mem = h->cpu->mem;
+    word first, last;
+    routinePages(r, &first, &last);
+    return mem->io[first] == &h->guard[first] && mem->read[first] == &mem->ram[first * PAGESIZE] &&
+           mem->io[last] == &h->guard[last] && mem->read[last] == &mem->ram[last * PAGESIZE];
+}
+
+
+//############################# ROUTINES #############################
+
+//take r out of the table, its guards are already gone; frees the state with the last routine
+static void dropRoutine(T6502 cpu, THleRoutine* r)
+{
+    THle h = cpu->hle;
+    h->entries[r->entry >> 3] &= ~(1 << (r->entry & 7));
+    *r = h->routines[--h->count];
+
+    if (h->count == 0)
+    {
+        cpu->hle = NULL;
+        free(h);
+    }
+}
+
+int hleAdd(T6502 cpu, address entry, uint32_t length, uint32_t crc, THleFn fn, void* ctx)
+{
+    if (length == 0 || length > HLE_MAX_CODE) return -1;
+
+    THle h = cpu->hle;
+    if (h == NULL)
+    {
+        h = (THle)calloc(1, sizeof(HleStruct));
+        if (h == NULL) return -1;
+        h->cpu = cpu;
+        h->pending = -1;
+        for (dword page = 0; page < PAGECOUNT; page++)
+        {
+            h->guard[page].dev = h;
+            h->guard[page].read = guardRead;
+            h->guard[page].write = guardWrite;
+            h->guard[page].peek = guardPeek;
+        }
+        cpu->hle = h;
+    }
+
+    THleRoutine* r = findRoutine(h, entry);
+    if (r == NULL)
+    {
+        if (h->count >= HLE_MAX) return -1;
+        r = &h->routines[h->count++];
+    }
+    else guardRoutine(h, r, -1);
+
+    memset(r, 0, sizeof(THleRoutine));
+    r->entry = entry;
+    r->length = length;
+    r->crc = crc;
+    r->fn = fn;
+    r->ctx = ctx;
+    h->entries[entry >> 3] |= 1 << (entry & 7);
+
+    if (guardRoutine(h, r, 1) != 0)
+    {
+        dropRoutine(cpu, r);
+        return -1;
+    }
+    return 0;
+}
+
+void hleRemove(T6502 cpu, address entry)
+{
+    THle h = cpu->hle;
+    if (h == NULL) return;
+
+    THleRoutine* r = findRoutine(h, entry);
+    if (r == NULL) return;
+    guardRoutine(h, r, -1);
+    dropRoutine(cpu, r);
+}
+
+void hleReset(THle h)
+{
+    h->pending = -1;
+    for (dword i = 0; i < h->count; i++) h->routines[i].checked = 0;
+}
+
+//code bytes of r as they are now: straight from RAM unless a device is mapped on its (at most two) pages
+static const word* currentCode(TMemory mem, const THleRoutine* r, word* buf)
+{
+    address last = r->entry + r->length - 1;
+    if (last >= r->entry && mem->read[r->entry >> 8] == &mem->ram[r->entry & 0xFF00] && mem->read[last >> 8] == &mem->ram[last & 0xFF00])
+        return &mem->ram[r->entry];
+
+    for (uint32_t i = 0; i < r->length; i++) buf[i] = memPeek(mem, (address)(r->entry + i));
+    return buf;
+}
+
+//1 if the code of r still has its CRC; in guarded RAM the result of the last check is kept until a write
+//into the routine, elsewhere the code is compared with the bytes last checked
+static int codeValid(THle h, THleRoutine* r)
+{
+    TMemory mem = h->cpu->mem;
+    if (r->checked && r->guarded && isGuarded(h, r)) return r->valid;
+
+    word buf[HLE_MAX_CODE];
+    const word* code = currentCode(mem, r, buf);
+    if (!r->checked || memcmp(code, r->code, r->length) != 0)
+    {
+        memcpy(r->code, code, r->length);
+        r->checked = 1;
+        r->valid = (hleChecksum(mem, r->entry, r->length) == r->crc);
+    }
+    r->guarded = isGuarded(h, r);   //from now on writes clear checked
+    return r->valid;
+}
+
+int hleCall(T6502 cpu)
+{
+    THle h = cpu->hle;
+    int32_t entry = h->pending;
+    h->pending = -1;
+
+    //the return address is on the stack only right after the JSR
+    if (entry != cpu->PC || h->pending_instructions != cpu->instructions) return 0;
+
+    THleRoutine* r = findRoutine(h, cpu->PC);
+    if (r == NULL || cpuIsBreakpoint(cpu, cpu->PC) || !codeValid(h, r)) return 0;
+
+    int cycles = r->fn(r->ctx, cpu);
+    if (cycles < 0) return 0;
+    r->calls++;
+    cpu->cycles += cycles;
+
+#ifdef ENABLE_PROFILER
+    //the JSR opened the routine's frame, the RTS that was not executed has to close it
+    if (profEnabled)
+    {
+        *profFrameCycles += cycles;
+        profReturn();
+    }
+#endif
+
+    //return like RTS: pull the address pushed by JSR, which points at JSR's last byte
+    rts(cpu);
+    cpu->PC++;
+    return 1;
+}
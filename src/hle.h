@@ -0,0 +1,88 @@
+#ifndef HLE_H
+#define HLE_H
+
+#include "types.h"
+#include "6502.h"
+#include "mem.h"
+
+//High-level emulation of known routines (memcpy/memset loops, multiply/divide, CRC, ...): a native handler
+//registered for a routine takes over when a JSR calls it. A routine is identified by its entry address and
+//the CRC-32 of its code bytes (hleChecksum). The JSR ends the slice when its target is a registered entry,
+//and at the slice boundary, with the return address on the stack and PC at the entry, the handler applies
+//the routine's effect on registers and memory and returns its cost in cycles; the CPU adds them and returns
+//like the routine's RTS would. Instructions inside the routine are not counted, hooks do not see them.
+//Only the JSR hands over: it leaves the entry in pending, and cpuRun calls the handler only if no other
+//instruction ran since. Getting to the entry any other way (JMP, branch, fall-through, RTI) runs the 6502 code.
+//The CRC is computed on the first call and kept: the pages of a routine in RAM get a write guard (a device
+//whose reads go straight to RAM), and a write into the routine (another program loaded, self-modifying
+//code) makes the next call compute it again. If it no longer matches, the 6502 code runs instead, until
+//the original bytes are back. Routines on pages of other devices (ROM) are compared with the bytes last
+//checked on every call. Memory changed without memWrite (memReset) is noticed after cpuReset.
+//The 6502 code also runs if a breakpoint is set at the entry.
+
+#define HLE_MAX      32         //registered routines
+#define HLE_MAX_CODE 256        //bytes checked per routine
+
+//apply the routine's effect with PC at its entry; returns the cycles from its first instruction up to and
+//including its RTS, or -1 to let the 6502 code run (e.g. for arguments the handler does not cover)
+typedef int (*THleFn)(void* ctx, T6502 cpu);
+
+typedef struct
+{
+    address  entry;
+    uint32_t length;            //code bytes covered by crc
+    uint32_t crc;
+    THleFn   fn;
+    void*    ctx;
+    word     code[HLE_MAX_CODE];    //bytes found at the last check, compared for routines not in guarded RAM
+    word     checked;           //valid is up to date, cleared by writes into the routine
+    word     valid;             //code matched crc
+    word     guarded;           //the guards saw all writes since the last check
+    uint64_t calls;             //calls taken over by fn
+} THleRoutine;
+
+typedef struct HleStruct
+{
+    T6502       cpu;
+    dword       count;
+    word        entries[MEMSIZE / 8];   //entry bitmap, bit (a & 7) of byte a >> 3
+    THleRoutine routines[HLE_MAX];
+    int32_t     pending;            //entry a JSR just called, -1: none
+    uint64_t    pending_instructions;   //cpu->instructions right after that JSR
+    TIoHandler  guard[PAGECOUNT];   //write guards on the pages of routines
+    word        guarded[PAGECOUNT]; //routines on the page
+} HleStruct;
+
+typedef HleStruct* THle;
+
+//CRC-32 (as zlib, cksum -a crc32b) of length bytes at a, read without side effects
+uint32_t hleChecksum(TMemory mem, address a, uint32_t length);
+
+//register fn(ctx, cpu) for the routine at entry whose first length bytes have the CRC-32 crc, replaces a
+//handler at the same entry; returns 0 on success, -1 if length is 0 or above HLE_MAX_CODE or all slots are used
+int hleAdd(T6502 cpu, address entry, uint32_t length, uint32_t crc, THleFn fn, void* ctx);
+
+//remove the handler at entry, JSR no longer looks for handlers once the last one is gone
+void hleRemove(T6502 cpu, address entry);
+
+//1 if a handler is registered at a
+static inline int hleIsEntry(THle h, address a)
+{
+    return (h->entries[a >> 3] >> (a & 7)) & 1;
+}
+
+//remember the call of the routine at entry by the JSR that just ran, for cpuRun
+static inline void hleJsr(T6502 cpu, address entry)
+{
+    cpu->hle->pending = entry;
+    cpu->hle->pending_instructions = cpu->instructions;
+}
+
+//run the handler of the pending call if PC is still at its entry and the code is unchanged, for cpuRun;
+//clears the pending call, returns 1 if the handler ran
+int hleCall(T6502 cpu);
+
+//forget a pending call and the checked code, cpuReset calls it
+void hleReset(THle h);
+
+#endif
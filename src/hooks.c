@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <string.h>
+#include "hooks.h"
+
+
+static void callMemHooks(THooks h, eHookKind kind, address a, word value)
+{
+    for (dword i = 0; i < h->count[kind]; i++) ((THookMemFn)h->hooks[kind][i].fn)(h->hooks[kind][i].ctx, a, value);
+}
+
+static word hookRead(void* dev, address a)
+{
+    THooks h = (THooks)dev;
+    word value = memIoPassRead(h->cpu->mem, &h->io[a >> 8], a);
+    callMemHooks(h, HOOK_READ, a, value);
+    return value;
+}
+
+static void hookWrite(void* dev, word value, address a)
+{
+    THooks h = (THooks)dev;
+    callMemHooks(h, HOOK_WRITE, a, value);
+    memIoPassWrite(h->cpu->mem, &h->io[a >> 8], value, a);
+}
+
+static word hookPeek(void* dev, address a)
+{
+    THooks h = (THooks)dev;
+    return memIoPassPeek(h->cpu->mem, &h->io[a >> 8], a);
+}
+
+//map the memory handler while there are memory hooks, unmap it after the last one
+static int updateMapping(THooks h)
+{
+    TMemory mem = h->cpu->mem;
+    word wanted = (h->count[HOOK_READ] + h->count[HOOK_WRITE]) > 0;
+
+    if (wanted && !h->mapped)
+    {
+        for (dword page = 0; page < PAGECOUNT; page++)
+        {
+            if (memMapIo(mem, page, page, &h->io[page]) != 0)
+            {
+                for (dword p = 0; p < page; p++) memUnmapIo(mem, &h->io[p]);
+                return -1;
+            }
+        }
+    }
+    if (!wanted && h->mapped)
+        for (dword page = 0; page < PAGECOUNT; page++) memUnmapIo(mem, &h->io[page]);
+
+    h->mapped = wanted;
+    return 0;
+}
+
+int hookAdd(T6502 cpu, eHookKind kind, void* fn, void* ctx)
+{
+    THooks h = cpu->hooks;
+    if (h == NULL)
+    {
+        h = (THooks)malloc(sizeof(HooksStruct));
+        memset(h, 0, sizeof(HooksStruct));
+        h->cpu = cpu;
+        for (dword page = 0; page < PAGECOUNT; page++)
+        {
+            h->io[page].dev = h;
+            h->io[page].read = hookRead;
+            h->io[page].write = hookWrite;
+            h->io[page].peek = hookPeek;
+        }
+        cpu->hooks = h;
+    }
+
+    if (h->count[kind] >= HOOK_MAX) return -1;
+    h->hooks[kind][h->count[kind]].fn = fn;
+    h->hooks[kind][h->count[kind]].ctx = ctx;
+    h->count[kind]++;
+
+    if (updateMapping(h) != 0)
+    {
+        hookRemove(cpu, kind, fn, ctx);
+        return -1;
+    }
+    return 0;
+}
+
+void hookRemove(T6502 cpu, eHookKind kind, void* fn, void* ctx)
+{
+    THooks h = cpu->hooks;
+    if (h == NULL) return;
+
+    for (dword i = 0; i < h->count[kind]; i++)
+    {
+        if (h->hooks[kind][i].fn != fn || h->hooks[kind][i].ctx != ctx) continue;
+        memmove(&h->hooks[kind][i], &h->hooks[kind][i + 1], (h->count[kind] - i - 1) * sizeof(THook));
+        h->count[kind]--;
+        break;
+    }
+    updateMapping(h);
+
+    //no hooks left: back to the plain loop
+    for (dword k = 0; k < HOOK_KINDS; k++)
+        if (h->count[k] > 0) return;
+    cpu->hooks = NULL;
+    free(h);
+}
@@ -0,0 +1,60 @@
+#ifndef HOOKS_H
+#define HOOKS_H
+
+#include "types.h"
+#include "6502.h"
+
+//Instrumentation hooks for analyses outside the core (taint tracking, custom counters, ...).
+//- instruction hooks run before each instruction (PC and IR not fetched yet: PC points at it) and after it
+//- memory hooks see every CPU read and write with its value; they are a handler on all pages of the memory
+//  bus, mapped only while a memory hook is registered (devices mapped later hide their pages from it)
+//While any hook is registered, cpuRun runs its hooked loop variant; without hooks the plain loop is used,
+//which has no hook code at all. Hooks run from cpuRun only, direct cpuStep calls do not call them.
+//hookAdd and hookRemove must not be called from within a hook.
+
+#define HOOK_MAX 8      //hooks per kind
+
+typedef void (*THookFn)(void* ctx, T6502 cpu);
+typedef void (*THookMemFn)(void* ctx, address a, word value);
+
+typedef enum
+{
+    HOOK_PRE = 0,       //before an instruction, THookFn
+    HOOK_POST,          //after an instruction, THookFn
+    HOOK_READ,          //memory read, THookMemFn, value is the one read
+    HOOK_WRITE,         //memory write, THookMemFn, value is the one written
+    HOOK_KINDS
+} eHookKind;
+
+typedef struct
+{
+    void*    fn;
+    void*    ctx;
+} THook;
+
+typedef struct HooksStruct
+{
+    T6502      cpu;
+    THook      hooks[HOOK_KINDS][HOOK_MAX];
+    dword      count[HOOK_KINDS];
+    word       mapped;                  //memory handler is on the bus
+    TIoHandler io[PAGECOUNT];
+} HooksStruct;
+
+typedef HooksStruct* THooks;
+
+//register hook fn(ctx, ...) of kind (a THookFn for HOOK_PRE/POST, a THookMemFn for HOOK_READ/WRITE),
+//returns 0 on success, -1 if there are HOOK_MAX hooks of that kind already
+int hookAdd(T6502 cpu, eHookKind kind, void* fn, void* ctx);
+
+//remove hook fn with ctx from kind, cpuRun goes back to the plain loop once the last hook is gone
+void hookRemove(T6502 cpu, eHookKind kind, void* fn, void* ctx);
+
+//call the instruction hooks of kind HOOK_PRE or HOOK_POST, for the hooked loop of cpuRun
+static inline void hookInstruction(T6502 cpu, eHookKind kind)
+{
+    THooks h = cpu->hooks;
+    for (dword i = 0; i < h->count[kind]; i++) ((THookFn)h->hooks[kind][i].fn)(h->hooks[kind][i].ctx, cpu);
+}
+
+#endif
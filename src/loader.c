@@ -2,26 +2,37 @@
 #include <string.h>
 #include "types.h"
 #include "loader.h"
+#include "utils.h"
 
-int loadProgram(TMemory mem, const word* program, uint32_t length)
+#ifndef DISABLE_LOAD_DUMP
+    #define ENABLE_LOAD_DUMP //print loaded binary, build with -DDISABLE_LOAD_DUMP to silence it
+#endif
+
+int loadProgramAt(TMemory mem, const word* program, uint32_t length, address at)
 {
-    
-    if (length > MEMSIZE)
+    if (length > MEMSIZE - at)
     {
-        printf("\nError: given program does not fit into 64K RAM.");
+        logMessage("\nError: given program does not fit into 64K RAM.");
         return -1;        
     }
     
     //load binary file into 6502 memory
-    address a = 0;
     for (uint32_t i = 0; i < length; i++)
     {
-        memWrite(mem, program[i], a++);
+        memWrite(mem, program[i], at + i);
     }
+    return 0;
+}
+
+int loadProgram(TMemory mem, const word* program, uint32_t length)
+{
+    if (loadProgramAt(mem, program, length, 0) != 0) return -1;
     
     //dump loaded binary file
-    printf("\nLoaded 6502 binary:");
-    memDump(mem, 0, a);
+#ifdef ENABLE_LOAD_DUMP
+    logMessage("\nLoaded 6502 binary:");
+    memDump(mem, 0, length);
+#endif
     
     return 0;
 }
@@ -35,7 +46,7 @@ int loadProgramFromFile(TMemory mem, const char* file)
         
     if (f == NULL)
     {
-        printf("IO error: could not open file %s \n", file);
+        logMessage("IO error: could not open file %s \n", file);
         return -1;
     }
 
@@ -50,8 +61,10 @@ int loadProgramFromFile(TMemory mem, const char* file)
     fclose(f);	
     
     //dump loaded binary file
-    printf("\nLoaded 6502 binary:");
+#ifdef ENABLE_LOAD_DUMP
+    logMessage("\nLoaded 6502 binary:");
     memDump(mem, 0, a);
+#endif
     
     return 0;    
 }
\ No newline at end of file
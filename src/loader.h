@@ -6,6 +6,9 @@
 //load 6202 binary from specified byte array
 int loadProgram(TMemory mem, const word* program, uint32_t length);
 
+//load 6502 binary to address at without dumping it, returns -1 if it does not fit below $10000
+int loadProgramAt(TMemory mem, const word* program, uint32_t length, address at);
+
 //load 6202 binary from file
 int loadProgramFromFile(TMemory mem, const char* file);
 
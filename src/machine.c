@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include "machine.h"
+#include "mem.h"
+#include "loader.h"
+#include "utils.h"
+
+
+TMachine machineCreate(void)
+{
+    TMachine m = (TMachine)malloc(sizeof(MachineStruct));
+    m->mem = memInit();
+    m->cpu = cpuInit(m->mem);
+    return m;
+}
+
+void machineDestroy(TMachine m)
+{
+    free(m->cpu->hooks);
+    free(m->cpu->hle);
+    free(m->cpu);
+    free(m->mem);
+    free(m);
+}
+
+void machineReset(TMachine m)
+{
+    memReset(m->mem);
+    cpuReset(m->cpu);
+}
+
+int machineLoad(TMachine m, const word* program, uint32_t length, address at)
+{
+    return loadProgramAt(m->mem, program, length, at);
+}
+
+eCpuStepStatus machineRun(TMachine m, uint64_t cycles)
+{
+    return cpuRun(m->cpu, cycles);
+}
+
+eCpuStepStatus machineRunUntil(TMachine m, uint64_t cycles, address pc)
+{
+    T6502 cpu = m->cpu;
+    int had = cpuIsBreakpoint(cpu, pc);
+
+    cpuSetBreakpoint(cpu, pc, 1);
+    eCpuStepStatus status = cpuRun(cpu, cycles);
+    if (!had) cpuSetBreakpoint(cpu, pc, 0);
+    return status;
+}
+
+void machineGetRegs(TMachine m, TMachineRegs* regs)
+{
+    T6502 cpu = m->cpu;
+    regs->A = cpu->A;
+    regs->X = cpu->X;
+    regs->Y = cpu->Y;
+    regs->P = cpu->P;
+    regs->SP = cpu->SP & 0xFF;
+    regs->PC = cpu->PC;
+    regs->cycles = cpu->cycles;
+    regs->instructions = cpu->instructions;
+}
+
+void machineSetRegs(TMachine m, const TMachineRegs* regs)
+{
+    T6502 cpu = m->cpu;
+    cpu->A = regs->A;
+    cpu->X = regs->X;
+    cpu->Y = regs->Y;
+    cpu->P = regs->P;
+    cpu->SP = 0x100 | regs->SP;
+    cpu->PC = regs->PC;
+}
+
+void machinePeek(TMachine m, address a, word* buf, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++) buf[i] = memPeek(m->mem, a + i);
+}
+
+void machinePoke(TMachine m, address a, const word* buf, uint32_t length)
+{
+    for (uint32_t i = 0; i < length; i++) memWrite(m->mem, buf[i], a + i);
+}
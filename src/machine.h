@@ -0,0 +1,65 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include "types.h"
+#include "6502.h"
+
+//Embedding API for hosts that drive the emulator from their own event loop: a machine is a CPU with its
+//64K memory bus, run in slices of cycles the host chooses. Nothing here prints to stdout: the library's
+//messages go to the process-wide logSetHandler, stderr unless the host sets another one once, before
+//creating machines (NULL drops them). Machines do not touch it.
+//Build the library objects with -DDISABLE_DBG_TRACE -DDISABLE_LOAD_DUMP (the build/quiet objects), the
+//other builds log a trace line for every instruction. The CPU (m->cpu) stays available for everything else: breakpoints,
+//watchpoints (watch.h), hooks (hooks.h), devices (apu.h, ppu.h).
+
+typedef struct
+{
+    word     A;
+    word     X;
+    word     Y;
+    word     P;
+    word     SP;            //lo byte, the stack is at $0100-$01FF
+    address  PC;
+    uint64_t cycles;        //read only
+    uint64_t instructions;  //read only
+} TMachineRegs;
+
+typedef struct
+{
+    T6502   cpu;
+    TMemory mem;
+} MachineStruct;
+
+typedef MachineStruct* TMachine;
+
+//create machine with cleared memory, CPU reset to $0000 (no reset vector yet)
+TMachine machineCreate(void);
+
+//free machine, devices the host attached have to be closed before
+void machineDestroy(TMachine m);
+
+//clear memory and reset the CPU, to reuse a machine for the next program
+void machineReset(TMachine m);
+
+//copy program to address at, returns -1 if it does not fit below $10000
+int machineLoad(TMachine m, const word* program, uint32_t length, address at);
+
+//run for at least the given number of cycles, or until a breakpoint, watchpoint or cpuStop ends the run
+//(CPU_STEP_BREAK, reason in m->cpu->stop) or an unknown opcode is hit (CPU_STEP_ERROR)
+eCpuStepStatus machineRun(TMachine m, uint64_t cycles);
+
+//like machineRun, but stop before the instruction at pc as well (CPU_STEP_BREAK, CPU_STOP_BREAKPOINT); returns
+//at once if PC is already there, unless the last run stopped there at a breakpoint
+eCpuStepStatus machineRunUntil(TMachine m, uint64_t cycles, address pc);
+
+//all registers in one call
+void machineGetRegs(TMachine m, TMachineRegs* regs);
+void machineSetRegs(TMachine m, const TMachineRegs* regs);
+
+//copy length bytes from a into buf without side effects on devices (wraps at $FFFF)
+void machinePeek(TMachine m, address a, word* buf, uint32_t length);
+
+//write length bytes from buf to a through the memory bus (wraps at $FFFF)
+void machinePoke(TMachine m, address a, const word* buf, uint32_t length);
+
+#endif
@@ -4,49 +4,277 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
 #include "6502.h"
 #include "mem.h"
 #include "utils.h"
 #include "loader.h"
+#include "profile.h"
+#include "flight.h"
+#include "pace.h"
+#include "apu.h"
+#include "ppu.h"
+#include "cart.h"
+#include "gdb.h"
+#include "batch.h"
+#include "budget.h"
+#ifdef ENABLE_BIN_TRACE
+    #include "trace.h"
+#endif
+
+
+#define RUN_SLICE 100000    //cycles per cpuRun call when unthrottled, Ctrl-C is checked in between
+#define CRASH_FILE "6502-crash.txt"
+
+static volatile sig_atomic_t interrupted = 0;
+static T6502 cpu = NULL;
+
+//Ctrl-C stops normally, termination requests stop with a crash dump
+static void onSignal(int sig)
+{
+    interrupted = (sig == SIGINT) ? 1 : sig;
+}
+
+//the emulator itself crashed: dump what the guest did last, then die as usual
+static void onFatalSignal(int sig)
+{
+    signal(sig, SIG_DFL);
+    flightDump(cpu, "fatal signal");
+    raise(sig);
+}
+
+//crash dump outside of a signal handler, with a note where it went
+static void writeCrashDump(const char* reason)
+{
+    if (flightDumpFile == NULL) return;
+    if (flightDump(cpu, reason) != 0) printf("IO error: could not write file %s \n", flightDumpFile);
+    else printf("Crash dump written to %s \n", flightDumpFile);
+}
+
+static void usage(void)
+{
+    printf("Usage: 6502 [-p folded-stacks-file] [-t trace-file] [-c crash-dump-file] [-s speed] [-a audio.wav] [-v frame.ppm] [-g port|socket] [-m cycles] [-n instructions] [-w seconds] [-u address] [-B] <6502-binary|cartridge.nes> \n");
+    printf("  -s speed: run at speed times the 2A03 clock (1 = real time), default: as fast as possible \n");
+    printf("  -a audio.wav: emulate the 2A03 APU at $4000-$4017 and record its output \n");
+    printf("  -v frame.ppm: emulate the 2C02 PPU at $2000-$3FFF and $4014 and save the last frame \n");
+    printf("  -g port|socket: wait for a GDB remote protocol debugger on 127.0.0.1:port or a Unix socket \n");
+    printf("  -m cycles, -n instructions, -w seconds: stop after this many cycles, instructions or seconds of wall-clock time \n");
+    printf("  -u address: stop when PC reaches address; -B: stop at BRK instead of executing it \n");
+    printf("  a program that jumps or branches to itself with no interrupt to come is halted and stops \n");
+    printf("       6502 --batch [-j threads] [-b cycles] [manifest|-] \n");
+    printf("  --batch: run every binary listed in the manifest (default: stdin), one JSON line per run, see src/batch.h \n");
+    printf("  -j threads: worker threads, default: one per CPU; -b cycles: budget of entries without cycles=, default: %llu \n", BATCH_DEFAULT_CYCLES);
+}
+
+//--batch [-j threads] [-b cycles] [manifest]
+static int runBatch(int argc, char *argv[])
+{
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t cycles = BATCH_DEFAULT_CYCLES;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:b:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j': threads = atoi(optarg); break;
+            case 'b': cycles = strtoull(optarg, NULL, 0); break;
+            default: usage(); return -1;
+        }
+    }
+
+    flightDumpFile = NULL;  //workers run side by side, their crash dumps would mix
+    logSetHandler(NULL, NULL);  //only the JSON lines go to stdout
+    int failed = batchRun((optind < argc) ? argv[optind] : NULL, stdout, threads, cycles);
+    if (failed < 0) return -2;
+    return (failed > 0) ? 1 : 0;
+}
+
+//write profile collected by the run loop, only a build with -DENABLE_PROFILER collects one
+static void writeProfile(const char* file)
+{
+    FILE* f = fopen(file, "w");
+    if (f == NULL)
+    {
+        printf("IO error: could not open file %s \n", file);
+        return;
+    }
+    profWriteFolded(f);
+    fclose(f);
+
+    profWriteHotspots(stdout, 20);
+    printf("Folded stacks written to %s \n", file);
+}
 
 
 int main(int argc, char *argv[])
 {	
-    
+    const char* profile_file = NULL;
+    const char* trace_file = NULL;
+    const char* audio_file = NULL;
+    const char* frame_file = NULL;
+    const char* gdb_socket = NULL;
+    double speed = 0;   //multiple of the 2A03 clock, 0: unthrottled
+    BudgetStruct budget;
+    int opt;
+
+    budgetInit(&budget);
+
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) return runBatch(argc - 1, argv + 1);
+
+    logSetHandler(logToStdout, NULL);   //traces, dumps and errors are the CLI's output
+    flightDumpFile = CRASH_FILE;
+
+    while ((opt = getopt(argc, argv, "p:t:c:s:a:v:g:m:n:w:u:B")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c': flightDumpFile = optarg; break;
+            case 'p': profile_file = optarg; break;
+            case 't': trace_file = optarg; break;
+            case 's': speed = atof(optarg); break;
+            case 'a': audio_file = optarg; break;
+            case 'v': frame_file = optarg; break;
+            case 'g': gdb_socket = optarg; break;
+            case 'm': budget.cycles = strtoull(optarg, NULL, 0); break;
+            case 'n': budget.instructions = strtoull(optarg, NULL, 0); break;
+            case 'w': budget.timeout = atof(optarg); break;
+            case 'u': budget.until = strtol(optarg, NULL, 0) & 0xFFFF; break;
+            case 'B': budget.brk = 1; break;
+            default: usage(); return -1;
+        }
+    }
+
     //exit if path to binary was not given
-    if (argc < 2) 
+    if (optind >= argc) 
     {
         printf("Input error: one argument expected: path to 6502-binary \n");
+        usage();
+        return -1;
+    }
+    const char* binary = argv[optind];
+
+#ifndef ENABLE_PROFILER
+    if (profile_file != NULL)
+    {
+        printf("Input error: profiling needs a build with -DENABLE_PROFILER (make profile) \n");
+        return -1;
+    }
+#endif
+
+#ifndef ENABLE_BIN_TRACE
+    if (trace_file != NULL)
+    {
+        printf("Input error: tracing needs a build with -DENABLE_BIN_TRACE (make trace) \n");
         return -1;
     }
+#endif
         
     //init RAM
     TMemory mem = memInit();
 
     //init CPU
-    T6502 cpu = cpuInit(mem);
+    cpu = cpuInit(mem);
 
-    //load binary into RAM
-    int status = loadProgramFromFile(mem, argv[1]);
+    //load binary into RAM, or map a .nes cartridge to $8000-$FFFF
+    TCart cart = NULL;
+    int status;
+    if (cartProbe(binary))
+    {
+        cart = cartOpen(cpu, binary);
+        status = (cart != NULL) ? 0 : -1;
+    }
+    else status = loadProgramFromFile(mem, binary);
 
     //exit if loading failed
     if (status != 0)
     {
-        printf("Error: could not load program %s \n", argv[1]);
+        printf("Error: could not load program %s \n", binary);
         return -2;
     }
+
+    //start at the reset vector of the loaded binary ($0000 if it does not set one)
+    cpuReset(cpu);
+
+    //devices, after the reset because it clears their scheduled events
+    TApu apu = NULL;
+    if (audio_file != NULL)
+    {
+        apu = apuInit(cpu);
+        if (apuOpenWav(apu, audio_file) != 0) return -2;
+    }
+    TPpu ppu = (frame_file != NULL) ? ppuInit(cpu) : NULL;
+    if (cart != NULL && ppu != NULL) cartSetPpu(cart, ppu);
+
+    //debugger controls the run until it detaches, after a kill there is nothing left to run
+    if (gdb_socket != NULL)
+    {
+        int served = gdbServe(cpu, gdb_socket);
+        if (served < 0) return -2;
+        if (served > 0) interrupted = 1;
+    }
+
+    //stop gracefully on Ctrl-C, so results like the profile are not lost
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGQUIT, onSignal);
+    signal(SIGSEGV, onFatalSignal);
+    signal(SIGBUS, onFatalSignal);
+    signal(SIGFPE, onFatalSignal);
+    signal(SIGABRT, onFatalSignal);
+    if (profile_file != NULL) profStart();
+#ifdef ENABLE_BIN_TRACE
+    if (trace_file != NULL && traceOpen(trace_file) != 0) return -2;
+#endif
         
 	//run
-	while(1)
+    int ret = 0;
+    PaceStruct pace;
+    paceStart(&pace, speed * CLOCK_2A03, cpu->cycles);
+    budgetStart(&budget, cpu);
+
+	while (!interrupted)
     {
-        eCpuStepStatus status = cpuStep(cpu); //step: fetch, decode, execute
+        uint64_t slice = (speed > 0) ? paceSlice(&pace) : RUN_SLICE;
+        eBudgetStop stop = budgetStep(&budget, cpu, slice); //fetch, decode, execute for a slice of cycles
         
-        if (status != CPU_STEP_OK) 
+        if (stop == BUDGET_ERROR) 
         {
             printf("An error occurred during execution. Exiting now.\n");
-            return -3;
+            writeCrashDump("execution error");
+            ret = -3;
+            break;
         }
+        if (stop != BUDGET_RUN)
+        {
+            printf("Stopped (%s) at 0x%.4X after %llu instructions \n", budgetStopName(stop, cpu->stop), cpu->PC, (unsigned long long)cpu->instructions);
+            break;
+        }
+
+        paceWait(&pace, cpu->cycles);   //returns at once when unthrottled
+    }
+
+    printf("Emulated %llu cycles in %.3f s: %.2fx 2A03 speed \n", (unsigned long long)cpu->cycles, paceElapsed(&pace), paceSpeed(&pace, cpu->cycles));
+
+    if (interrupted > 1)
+    {
+        writeCrashDump("terminated by signal");
+    }
+
+    if (apu != NULL) apuClose(apu);
+    if (ppu != NULL)
+    {
+        ppuSync(ppu);
+        if (ppuWritePpm(ppu, frame_file) == 0) printf("%llu frames rendered, last one written to %s \n", (unsigned long long)ppu->frames, frame_file);
+        ppuClose(ppu);
     }
+    if (cart != NULL) cartClose(cart);
+    if (profile_file != NULL) writeProfile(profile_file);
+#ifdef ENABLE_BIN_TRACE
+    traceClose();   //writes out what is still in the ring
+#endif
 
-    return 0;
-}
\ No newline at end of file
+    return ret;
+}
@@ -2,36 +2,216 @@
 #include <stdlib.h>
 #include <string.h>
 #include "mem.h"
+#include "utils.h"
+
+static const uint64_t no_clock = 0;    //until a CPU is connected
 
 TMemory memInit(void)
 {
-    TMemory mem = (word*)malloc(sizeof(word) * MEMSIZE);  
-    memset(mem, 0, sizeof(word) * MEMSIZE);
+    TMemory mem = (TMemory)malloc(sizeof(MemStruct));  
+    memset(mem, 0, sizeof(MemStruct));
+    mem->clock = &no_clock;
+    for (dword page = 0; page < PAGECOUNT; page++) mem->read[page] = &mem->ram[page * PAGESIZE];
     return mem;
 }
 
-//read 8bit word from 16bit address a
-word memRead(TMemory mem, address a)
+//clear RAM, only the pages written since the last reset in fuzzing builds
+void memReset(TMemory mem)
+{
+#ifndef ENABLE_COVERAGE
+    memset(mem->ram, 0, sizeof(mem->ram));
+#else
+    for (dword i = 0; i < mem->dirty_count; i++)
+    {
+        word page = mem->dirty_list[i];
+        memset(&mem->ram[page * PAGESIZE], 0, PAGESIZE);
+        mem->dirty[page] = 0;
+    }
+    mem->dirty_count = 0;
+#endif
+}
+
+//read register of the device mapped at a, after letting it catch up
+word memIoRead(TMemory mem, address a)
+{
+    TIoHandler* h = mem->io[a >> 8];
+    if (h->catchUp != NULL) h->catchUp(h->dev, *mem->clock);
+    return h->read(h->dev, a);
+}
+
+//write register of the device mapped at a, after letting it catch up
+void memIoWrite(TMemory mem, word w, address a)
+{
+    TIoHandler* h = mem->io[a >> 8];
+    if (h->catchUp != NULL) h->catchUp(h->dev, *mem->clock);
+    h->write(h->dev, w, a);
+}
+
+//device mapped before h on the page of a, NULL if h is the first one
+static TIoHandler* passTarget(TMemory mem, TIoHandler* h, address a)
+{
+    word page = a >> 8;
+    for (word i = mem->io_depth[page]; i > 1; i--)
+        if (mem->io_chain[page][i - 1] == h) return mem->io_chain[page][i - 2];
+    return NULL;
+}
+
+word memIoPassRead(TMemory mem, TIoHandler* h, address a)
+{
+    h = passTarget(mem, h, a);
+    if (h == NULL) return mem->ram[a];
+    if (h->catchUp != NULL) h->catchUp(h->dev, *mem->clock);
+    return h->read(h->dev, a);
+}
+
+void memIoPassWrite(TMemory mem, TIoHandler* h, word w, address a)
+{
+    h = passTarget(mem, h, a);
+    if (h == NULL)
+    {
+        memMarkDirty(mem, a);
+        mem->ram[a] = w;
+        return;
+    }
+    if (h->catchUp != NULL) h->catchUp(h->dev, *mem->clock);
+    h->write(h->dev, w, a);
+}
+
+word memIoPassPeek(TMemory mem, TIoHandler* h, address a)
+{
+    h = passTarget(mem, h, a);
+    if (h != NULL && h->peek != NULL) return h->peek(h->dev, a);
+    return mem->ram[a];
+}
+
+//read 8bit word from 16bit address a without side effects on devices
+word memPeek(TMemory mem, address a)
 {
-    return mem[a];
+    const word* page = mem->read[a >> 8];
+    if (page != NULL) return page[a & 0xFF];
+
+    TIoHandler* h = mem->io[a >> 8];
+    if (h != NULL && h->peek != NULL) return h->peek(h->dev, a);
+    return mem->ram[a];
 }
 
-//write 8bit word to 16bit address a
-void memWrite(TMemory mem, word w, address a)
+//position of h in the devices of page, -1 if it is not mapped there
+static int chainIndex(TMemory mem, dword page, TIoHandler* h)
 {
-    mem[a] = w;
+    for (word i = 0; i < mem->io_depth[page]; i++)
+        if (mem->io_chain[page][i] == h) return i;
+    return -1;
+}
+
+//last device of page and where memRead finds the page's bytes, after the devices of the page changed
+static void updatePage(TMemory mem, dword page)
+{
+    word depth = mem->io_depth[page];
+    mem->io[page] = depth ? mem->io_chain[page][depth - 1] : NULL;
+    mem->read[page] = depth ? mem->io_read[page][depth - 1] : &mem->ram[page * PAGESIZE];
+}
+
+//map device h to the pages first..last, returns 0 on success
+int memMapIo(TMemory mem, word first_page, word last_page, TIoHandler* h)
+{
+    dword i;
+    for (i = 0; i < mem->device_count; i++)
+        if (mem->devices[i] == h) break;
+
+    for (dword page = first_page; page <= last_page; page++)
+    {
+        if (chainIndex(mem, page, h) < 0 && mem->io_depth[page] >= MEM_IO_DEPTH)
+        {
+            logMessage("Error: too many devices on page $%.2X \n", page);
+            return -1;
+        }
+    }
+
+    if (i == mem->device_count)
+    {
+        if (mem->device_count >= MEM_MAX_DEVICES)
+        {
+            logMessage("Error: too many memory-mapped devices \n");
+            return -1;
+        }
+        mem->devices[mem->device_count++] = h;
+    }
+
+    //a page that already has a device is shared: h comes first and passes on what it does not decode
+    for (dword page = first_page; page <= last_page; page++)
+    {
+        if (chainIndex(mem, page, h) >= 0) continue;
+        mem->io_chain[page][mem->io_depth[page]] = h;
+        mem->io_read[page][mem->io_depth[page]] = NULL;
+        mem->io_depth[page]++;
+        updatePage(mem, page);
+    }
+    return 0;
+}
+
+//remove device h from all pages it is mapped to
+void memUnmapIo(TMemory mem, TIoHandler* h)
+{
+    for (dword page = 0; page < PAGECOUNT; page++)
+    {
+        int i = chainIndex(mem, page, h);
+        if (i < 0) continue;
+
+        dword above = mem->io_depth[page] - i - 1;
+        memmove(&mem->io_chain[page][i], &mem->io_chain[page][i + 1], above * sizeof(TIoHandler*));
+        memmove(&mem->io_read[page][i], &mem->io_read[page][i + 1], above * sizeof(const word*));
+        mem->io_depth[page]--;
+        updatePage(mem, page);
+    }
+
+    for (dword i = 0; i < mem->device_count; i++)
+    {
+        if (mem->devices[i] != h) continue;
+        mem->devices[i] = mem->devices[--mem->device_count];
+        break;
+    }
+}
+
+void memSetReadPage(TMemory mem, TIoHandler* h, word page, const word* data)
+{
+    int i = chainIndex(mem, page, h);
+    if (i < 0) return;
+    mem->io_read[page][i] = data;
+    updatePage(mem, page);
+}
+
+//let memory know the current cycle, cpuInit connects the CPU's cycle counter
+void memSetClock(TMemory mem, const uint64_t* clock)
+{
+    mem->clock = clock;
+}
+
+//catch up all devices to the current cycle, e.g. before looking at their output
+void memSync(TMemory mem)
+{
+    for (dword i = 0; i < mem->device_count; i++)
+        if (mem->devices[i]->catchUp != NULL) mem->devices[i]->catchUp(mem->devices[i]->dev, *mem->clock);
 }
 
 //print RAM contents for memory in range [from,to]
 void memDump(TMemory mem, address from, address to)
 {
     address i = from;
-    
-    printf("\n**********************************************************************");   
+    if (!logEnabled()) return;      //nothing to format a dump for
+
+    //one message per line of 16 bytes
+    char line[8 + 16 * 4];
+    int n = 0;
+    logMessage("\n**********************************************************************");   
     for (i = 0; i < to; i++)
     { 
-        if ((i) % 16 == 0) printf("\n%.4X: ", i);        
-        printf(" %.2X ", memRead(mem, i)); 
+        if ((i) % 16 == 0)
+        {
+            if (n > 0) logMessage("%s", line);
+            n = sprintf(line, "\n%.4X: ", i);
+        }
+        n += sprintf(line + n, " %.2X ", memPeek(mem, i)); 
     }   
-    printf("\n**********************************************************************\n\n");
+    if (n > 0) logMessage("%s", line);
+    logMessage("\n**********************************************************************\n\n");
 }
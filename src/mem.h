@@ -6,17 +6,125 @@
 
 //6502 has 256 pages of RAM, each page is 256 bytes => 64k (65536) bytes overall
 #define MEMSIZE 256*256
+#define PAGESIZE 256
+#define PAGECOUNT (MEMSIZE / PAGESIZE)
 
-typedef word* TMemory;
+#define MEM_MAX_DEVICES (16 + 3 * PAGECOUNT)  //devices, plus a watchpoint, a hook and an HLE guard on every page
+#define MEM_IO_DEPTH    8       //devices sharing one page
+
+//Memory-mapped device: pages mapped with memMapIo go through these callbacks instead of RAM.
+//Devices are synchronized lazily: before the CPU reads or writes one of their registers, catchUp advances
+//them from wherever they were to the current cycle in one batch. A device that has to act on its own (e.g.
+//raise an IRQ) schedules an event with cpuSchedule and catches up in that callback. Devices nobody looks
+//at cost nothing.
+//Several devices may share a page (e.g. APU and OAM DMA at $40xx): the one mapped last gets the accesses and
+//hands those it does not decode on with memIoPass*, to the device mapped before it on that page or to RAM.
+//The order is kept per page, so a device may share some of its pages with one device and others with another.
+//A device whose reads of a page have no side effects (ROM) can hand memory the page's bytes with
+//memSetReadPage: memRead then reads them directly, without catchUp or callback, as long as it is the last
+//device mapped on the page. Writes still go to the device.
+typedef struct IoHandlerStruct
+{
+    void*   dev;                                    //device state, passed to all callbacks
+    word    (*read)(void* dev, address a);          //register read, may have side effects
+    void    (*write)(void* dev, word w, address a); //register write
+    word    (*peek)(void* dev, address a);          //read without side effects (dumps, traces), NULL: read RAM
+    void    (*catchUp)(void* dev, uint64_t now);    //advance device to cycle now, NULL: device has no own timing
+} TIoHandler;
+
+typedef struct
+{
+    word    ram[MEMSIZE];               //64K RAM
+#ifdef ENABLE_COVERAGE
+    word    dirty[PAGECOUNT];           //1 if page was written since last reset
+    word    dirty_list[PAGECOUNT];      //numbers of the dirty pages, so a reset needs not to scan all pages
+    dword   dirty_count;                //number of entries in dirty_list
+#endif
+    TIoHandler* io[PAGECOUNT];          //device mapped to the page, NULL for plain RAM
+    TIoHandler* io_chain[PAGECOUNT][MEM_IO_DEPTH];  //devices sharing the page in mapping order, io[page] is the last
+    const word* io_read[PAGECOUNT][MEM_IO_DEPTH];   //bytes the device in io_chain reads from, NULL: read callback
+    word    io_depth[PAGECOUNT];        //number of devices in io_chain
+    const word* read[PAGECOUNT];        //bytes memRead takes for the page: its RAM, ROM of the last device or NULL
+    TIoHandler* devices[MEM_MAX_DEVICES];   //all mapped devices, for memSync
+    dword   device_count;
+    const uint64_t* clock;              //current cycle for catchUp, the CPU's cycle counter
+} MemStruct;
+
+typedef MemStruct* TMemory;
 
 //allocate RAM and return pointer to it
 TMemory memInit(void);
 
+//clear RAM; fuzzing builds (ENABLE_COVERAGE) reset after every short run and clear only the pages written
+//since the last reset, the other builds clear all of it and keep page tracking off the write path
+void memReset(TMemory mem);
+
+//device access, memRead/memWrite take these for pages mapped with memMapIo
+word memIoRead(TMemory mem, address a);
+void memIoWrite(TMemory mem, word w, address a);
+
+//for a device h on a shared page: pass an access it does not decode on to the device mapped before h on the
+//page of a, or RAM if there is none
+word memIoPassRead(TMemory mem, TIoHandler* h, address a);
+void memIoPassWrite(TMemory mem, TIoHandler* h, word w, address a);
+word memIoPassPeek(TMemory mem, TIoHandler* h, address a);
+
 //read 8bit word from 16bit address a
-word memRead(TMemory mem, address a);
+static inline word memRead(TMemory mem, address a)
+{
+    const word* page = mem->read[a >> 8];
+    if (page != NULL) return page[a & 0xFF];
+    return memIoRead(mem, a);
+}
+
+//remember the page of a for memReset
+static inline void memMarkDirty(TMemory mem, address a)
+{
+#ifdef ENABLE_COVERAGE
+    word page = a >> 8;
+    if (!mem->dirty[page])
+    {
+        mem->dirty[page] = 1;
+        mem->dirty_list[mem->dirty_count++] = page;
+    }
+#else
+    (void)mem;
+    (void)a;
+#endif
+}
 
 //write 8bit word to 16bit address a
-void memWrite(TMemory mem, word w, address a);
+static inline void memWrite(TMemory mem, word w, address a)
+{
+    if (mem->io[a >> 8] != NULL)
+    {
+        memIoWrite(mem, w, a);
+        return;
+    }
+
+    memMarkDirty(mem, a);
+    mem->ram[a] = w;
+}
+
+//read 8bit word from 16bit address a without side effects on devices
+word memPeek(TMemory mem, address a);
+
+//map device h to the pages first..last, on top of devices already there; returns 0 on success, -1 if there
+//are too many devices or a page is shared by MEM_IO_DEPTH devices already
+int memMapIo(TMemory mem, word first_page, word last_page, TIoHandler* h);
+
+//remove device h from all pages it is mapped to
+void memUnmapIo(TMemory mem, TIoHandler* h);
+
+//reads of page by device h come from the PAGESIZE bytes at data (NULL: through h->read again), e.g. on a
+//bank switch; h has to be mapped to the page
+void memSetReadPage(TMemory mem, TIoHandler* h, word page, const word* data);
+
+//let memory know the current cycle, cpuInit connects the CPU's cycle counter
+void memSetClock(TMemory mem, const uint64_t* clock);
+
+//catch up all devices to the current cycle, e.g. before looking at their output
+void memSync(TMemory mem);
 
 //print RAM contents for memory in range [from,to]
 void memDump(TMemory mem, address from, address to);
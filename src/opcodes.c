@@ -0,0 +1,16 @@
+#include "opcodes.h"
+#include "6502.h"
+
+#define OPCODE_INFO(opcode, mnemonic, mode, length, cycles) [opcode] = { mnemonic, mode, length, cycles },
+
+//per-opcode info of the variant being built, indexed by opcode, undocumented opcodes are all zero
+const TOpcodeInfo opcodeTable[256] = 
+{
+    OPCODE_LIST_VARIANT(OPCODE_INFO)
+};
+
+//short name of addressing mode, e.g. "ZRPX"
+const char* addrModeNames[MODE_COUNT] = 
+{
+    "IMPL", "ACCU", "IMMD", "ZRP", "ZRPX", "ZRPY", "ABS", "ABSX", "ABSY", "IND", "XIND", "INDY", "REL", "ZIND", "AXIND"
+};
@@ -0,0 +1,252 @@
+#ifndef OPCODES_H
+#define OPCODES_H
+
+#include "types.h"
+#include "variant.h"
+
+//addressing modes, named after the suffixes of the opcode defines in 6502.h
+typedef enum
+{
+    MODE_IMPL = 0,  //implied, 1 byte
+    MODE_ACCU,      //accumulator, 1 byte
+    MODE_IMMD,      //immediate, 2 bytes
+    MODE_ZRP,       //zeropage, 2 bytes
+    MODE_ZRPX,      //zeropage + X, 2 bytes
+    MODE_ZRPY,      //zeropage + Y, 2 bytes
+    MODE_ABS,       //absolute, 3 bytes
+    MODE_ABSX,      //absolute + X, 3 bytes
+    MODE_ABSY,      //absolute + Y, 3 bytes
+    MODE_IND,       //indirect (JMP only), 3 bytes
+    MODE_XIND,      //X indexed indirect, 2 bytes
+    MODE_INDY,      //indirect Y indexed, 2 bytes
+    MODE_REL,       //relative (branches), 2 bytes
+    MODE_ZIND,      //zeropage indirect (65C02), 2 bytes
+    MODE_AXIND,     //absolute X indexed indirect (65C02 JMP only), 3 bytes
+    MODE_COUNT
+} eAddrMode;
+
+typedef struct
+{
+    const char* mnemonic;   //NULL for undocumented opcodes and opcodes the variant lacks
+    eAddrMode   mode;
+    word        length;     //instruction length in bytes
+    word        cycles;     //base cycles, without page crossing and branch penalties
+} TOpcodeInfo;
+
+//the 65C02 fetches the pointer of JMP ($xxFF) correctly, which costs a cycle
+#ifdef CPU_CMOS
+    #define JMP_IND_CYCLES 6
+#else
+    #define JMP_IND_CYCLES 5
+#endif
+
+//All 151 documented opcodes: X(opcode, mnemonic, addressing mode, length in bytes, base cycles)
+//This list (plus OPCODE_LIST_65C02 in CPU_CMOS builds) is the single source for every per-opcode table,
+//expand it with a suitable X macro, or OPCODE_LIST_VARIANT for the opcodes of the variant being built.
+#define OPCODE_LIST(X) \
+    /* TRANSFER INSTRUCTIONS */ \
+    X(TAX_IMPL,  "TAX", MODE_IMPL, 1, 2) \
+    X(TXA_IMPL,  "TXA", MODE_IMPL, 1, 2) \
+    X(TAY_IMPL,  "TAY", MODE_IMPL, 1, 2) \
+    X(TYA_IMPL,  "TYA", MODE_IMPL, 1, 2) \
+    X(TSX_IMPL,  "TSX", MODE_IMPL, 1, 2) \
+    X(TXS_IMPL,  "TXS", MODE_IMPL, 1, 2) \
+    /* STORAGE INSTRUCTIONS */ \
+    X(LDA_IMMD,  "LDA", MODE_IMMD, 2, 2) \
+    X(LDA_ZRP,   "LDA", MODE_ZRP,  2, 3) \
+    X(LDA_ZRPX,  "LDA", MODE_ZRPX, 2, 4) \
+    X(LDA_ABS,   "LDA", MODE_ABS,  3, 4) \
+    X(LDA_ABSX,  "LDA", MODE_ABSX, 3, 4) \
+    X(LDA_ABSY,  "LDA", MODE_ABSY, 3, 4) \
+    X(LDA_XIND,  "LDA", MODE_XIND, 2, 6) \
+    X(LDA_INDY,  "LDA", MODE_INDY, 2, 5) \
+    X(LDX_IMMD,  "LDX", MODE_IMMD, 2, 2) \
+    X(LDX_ZRP,   "LDX", MODE_ZRP,  2, 3) \
+    X(LDX_ZRPY,  "LDX", MODE_ZRPY, 2, 4) \
+    X(LDX_ABS,   "LDX", MODE_ABS,  3, 4) \
+    X(LDX_ABSY,  "LDX", MODE_ABSY, 3, 4) \
+    X(LDY_IMMD,  "LDY", MODE_IMMD, 2, 2) \
+    X(LDY_ZRP,   "LDY", MODE_ZRP,  2, 3) \
+    X(LDY_ZRPX,  "LDY", MODE_ZRPX, 2, 4) \
+    X(LDY_ABS,   "LDY", MODE_ABS,  3, 4) \
+    X(LDY_ABSX,  "LDY", MODE_ABSX, 3, 4) \
+    X(STA_ZRP,   "STA", MODE_ZRP,  2, 3) \
+    X(STA_ZRPX,  "STA", MODE_ZRPX, 2, 4) \
+    X(STA_ABS,   "STA", MODE_ABS,  3, 4) \
+    X(STA_ABSX,  "STA", MODE_ABSX, 3, 5) \
+    X(STA_ABSY,  "STA", MODE_ABSY, 3, 5) \
+    X(STA_XIND,  "STA", MODE_XIND, 2, 6) \
+    X(STA_INDY,  "STA", MODE_INDY, 2, 6) \
+    X(STX_ZRP,   "STX", MODE_ZRP,  2, 3) \
+    X(STX_ZRPY,  "STX", MODE_ZRPY, 2, 4) \
+    X(STX_ABS,   "STX", MODE_ABS,  3, 4) \
+    X(STY_ZRP,   "STY", MODE_ZRP,  2, 3) \
+    X(STY_ZRPX,  "STY", MODE_ZRPX, 2, 4) \
+    X(STY_ABS,   "STY", MODE_ABS,  3, 4) \
+    /* ARITHMETIC INSTRUCTIONS */ \
+    X(ADC_IMMD,  "ADC", MODE_IMMD, 2, 2) \
+    X(ADC_ZRP,   "ADC", MODE_ZRP,  2, 3) \
+    X(ADC_ZRPX,  "ADC", MODE_ZRPX, 2, 4) \
+    X(ADC_ABS,   "ADC", MODE_ABS,  3, 4) \
+    X(ADC_ABSX,  "ADC", MODE_ABSX, 3, 4) \
+    X(ADC_ABSY,  "ADC", MODE_ABSY, 3, 4) \
+    X(ADC_XIND,  "ADC", MODE_XIND, 2, 6) \
+    X(ADC_INDY,  "ADC", MODE_INDY, 2, 5) \
+    X(SBC_IMMD,  "SBC", MODE_IMMD, 2, 2) \
+    X(SBC_ZRP,   "SBC", MODE_ZRP,  2, 3) \
+    X(SBC_ZRPX,  "SBC", MODE_ZRPX, 2, 4) \
+    X(SBC_ABS,   "SBC", MODE_ABS,  3, 4) \
+    X(SBC_ABSX,  "SBC", MODE_ABSX, 3, 4) \
+    X(SBC_ABSY,  "SBC", MODE_ABSY, 3, 4) \
+    X(SBC_XIND,  "SBC", MODE_XIND, 2, 6) \
+    X(SBC_INDY,  "SBC", MODE_INDY, 2, 5) \
+    X(INC_ZRP,   "INC", MODE_ZRP,  2, 5) \
+    X(INC_ZRPX,  "INC", MODE_ZRPX, 2, 6) \
+    X(INC_ABS,   "INC", MODE_ABS,  3, 6) \
+    X(INC_ABSX,  "INC", MODE_ABSX, 3, 7) \
+    X(INX_IMPL,  "INX", MODE_IMPL, 1, 2) \
+    X(INY_IMPL,  "INY", MODE_IMPL, 1, 2) \
+    X(DEC_ZRP,   "DEC", MODE_ZRP,  2, 5) \
+    X(DEC_ZRPX,  "DEC", MODE_ZRPX, 2, 6) \
+    X(DEC_ABS,   "DEC", MODE_ABS,  3, 6) \
+    X(DEC_ABSX,  "DEC", MODE_ABSX, 3, 7) \
+    X(DEX_IMPL,  "DEX", MODE_IMPL, 1, 2) \
+    X(DEY_IMPL,  "DEY", MODE_IMPL, 1, 2) \
+    /* SHIFT & ROTATE INSTRUCTIONS */ \
+    X(ASL_ACCU,  "ASL", MODE_ACCU, 1, 2) \
+    X(ASL_ZRP,   "ASL", MODE_ZRP,  2, 5) \
+    X(ASL_ZRPX,  "ASL", MODE_ZRPX, 2, 6) \
+    X(ASL_ABS,   "ASL", MODE_ABS,  3, 6) \
+    X(ASL_ABSX,  "ASL", MODE_ABSX, 3, 7) \
+    X(LSR_ACCU,  "LSR", MODE_ACCU, 1, 2) \
+    X(LSR_ZRP,   "LSR", MODE_ZRP,  2, 5) \
+    X(LSR_ZRPX,  "LSR", MODE_ZRPX, 2, 6) \
+    X(LSR_ABS,   "LSR", MODE_ABS,  3, 6) \
+    X(LSR_ABSX,  "LSR", MODE_ABSX, 3, 7) \
+    X(ROL_ACCU,  "ROL", MODE_ACCU, 1, 2) \
+    X(ROL_ZRP,   "ROL", MODE_ZRP,  2, 5) \
+    X(ROL_ZRPX,  "ROL", MODE_ZRPX, 2, 6) \
+    X(ROL_ABS,   "ROL", MODE_ABS,  3, 6) \
+    X(ROL_ABSX,  "ROL", MODE_ABSX, 3, 7) \
+    X(ROR_ACCU,  "ROR", MODE_ACCU, 1, 2) \
+    X(ROR_ZRP,   "ROR", MODE_ZRP,  2, 5) \
+    X(ROR_ZRPX,  "ROR", MODE_ZRPX, 2, 6) \
+    X(ROR_ABS,   "ROR", MODE_ABS,  3, 6) \
+    X(ROR_ABSX,  "ROR", MODE_ABSX, 3, 7) \
+    /* LOGIC INSTRUCTIONS */ \
+    X(AND_IMMD,  "AND", MODE_IMMD, 2, 2) \
+    X(AND_ZRP,   "AND", MODE_ZRP,  2, 3) \
+    X(AND_ZRPX,  "AND", MODE_ZRPX, 2, 4) \
+    X(AND_ABS,   "AND", MODE_ABS,  3, 4) \
+    X(AND_ABSX,  "AND", MODE_ABSX, 3, 4) \
+    X(AND_ABSY,  "AND", MODE_ABSY, 3, 4) \
+    X(AND_XIND,  "AND", MODE_XIND, 2, 6) \
+    X(AND_INDY,  "AND", MODE_INDY, 2, 5) \
+    X(ORA_IMMD,  "ORA", MODE_IMMD, 2, 2) \
+    X(ORA_ZRP,   "ORA", MODE_ZRP,  2, 3) \
+    X(ORA_ZRPX,  "ORA", MODE_ZRPX, 2, 4) \
+    X(ORA_ABS,   "ORA", MODE_ABS,  3, 4) \
+    X(ORA_ABSX,  "ORA", MODE_ABSX, 3, 4) \
+    X(ORA_ABSY,  "ORA", MODE_ABSY, 3, 4) \
+    X(ORA_XIND,  "ORA", MODE_XIND, 2, 6) \
+    X(ORA_INDY,  "ORA", MODE_INDY, 2, 5) \
+    X(EOR_IMMD,  "EOR", MODE_IMMD, 2, 2) \
+    X(EOR_ZRP,   "EOR", MODE_ZRP,  2, 3) \
+    X(EOR_ZRPX,  "EOR", MODE_ZRPX, 2, 4) \
+    X(EOR_ABS,   "EOR", MODE_ABS,  3, 4) \
+    X(EOR_ABSX,  "EOR", MODE_ABSX, 3, 4) \
+    X(EOR_ABSY,  "EOR", MODE_ABSY, 3, 4) \
+    X(EOR_XIND,  "EOR", MODE_XIND, 2, 6) \
+    X(EOR_INDY,  "EOR", MODE_INDY, 2, 5) \
+    /* COMPARE AND TEST BIT INSTRUCTIONS */ \
+    X(CMP_IMMD,  "CMP", MODE_IMMD, 2, 2) \
+    X(CMP_ZRP,   "CMP", MODE_ZRP,  2, 3) \
+    X(CMP_ZRPX,  "CMP", MODE_ZRPX, 2, 4) \
+    X(CMP_ABS,   "CMP", MODE_ABS,  3, 4) \
+    X(CMP_ABSX,  "CMP", MODE_ABSX, 3, 4) \
+    X(CMP_ABSY,  "CMP", MODE_ABSY, 3, 4) \
+    X(CMP_XIND,  "CMP", MODE_XIND, 2, 6) \
+    X(CMP_INDY,  "CMP", MODE_INDY, 2, 5) \
+    X(CPX_IMMD,  "CPX", MODE_IMMD, 2, 2) \
+    X(CPX_ZRP,   "CPX", MODE_ZRP,  2, 3) \
+    X(CPX_ABS,   "CPX", MODE_ABS,  3, 4) \
+    X(CPY_IMMD,  "CPY", MODE_IMMD, 2, 2) \
+    X(CPY_ZRP,   "CPY", MODE_ZRP,  2, 3) \
+    X(CPY_ABS,   "CPY", MODE_ABS,  3, 4) \
+    X(BIT_ZRP,   "BIT", MODE_ZRP,  2, 3) \
+    X(BIT_ABS,   "BIT", MODE_ABS,  3, 4) \
+    /* SET AND CLEAR INSTRUCTIONS */ \
+    X(SEC_IMPL,  "SEC", MODE_IMPL, 1, 2) \
+    X(SED_IMPL,  "SED", MODE_IMPL, 1, 2) \
+    X(SEI_IMPL,  "SEI", MODE_IMPL, 1, 2) \
+    X(CLC_IMPL,  "CLC", MODE_IMPL, 1, 2) \
+    X(CLD_IMPL,  "CLD", MODE_IMPL, 1, 2) \
+    X(CLI_IMPL,  "CLI", MODE_IMPL, 1, 2) \
+    X(CLV_IMPL,  "CLV", MODE_IMPL, 1, 2) \
+    /* JUMP AND SUBROUTINE INSTRUCTIONS */ \
+    X(JMP_ABS,   "JMP", MODE_ABS,  3, 3) \
+    X(JMP_IND,   "JMP", MODE_IND,  3, JMP_IND_CYCLES) \
+    X(JSR_ABS,   "JSR", MODE_ABS,  3, 6) \
+    X(RTS_IMPL,  "RTS", MODE_IMPL, 1, 6) \
+    X(RTI_IMPL,  "RTI", MODE_IMPL, 1, 6) \
+    /* BRANCH INSTRUCTIONS */ \
+    X(BCC_REL,   "BCC", MODE_REL,  2, 2) \
+    X(BCS_REL,   "BCS", MODE_REL,  2, 2) \
+    X(BEQ_REL,   "BEQ", MODE_REL,  2, 2) \
+    X(BMI_REL,   "BMI", MODE_REL,  2, 2) \
+    X(BNE_REL,   "BNE", MODE_REL,  2, 2) \
+    X(BPL_REL,   "BPL", MODE_REL,  2, 2) \
+    X(BVC_REL,   "BVC", MODE_REL,  2, 2) \
+    X(BVS_REL,   "BVS", MODE_REL,  2, 2) \
+    /* STACK INSTRUCTIONS */ \
+    X(PHA_IMPL,  "PHA", MODE_IMPL, 1, 3) \
+    X(PLA_IMPL,  "PLA", MODE_IMPL, 1, 4) \
+    X(PHP_IMPL,  "PHP", MODE_IMPL, 1, 3) \
+    X(PLP_IMPL,  "PLP", MODE_IMPL, 1, 4) \
+    /* MISC INSTRUCTIONS */ \
+    X(NOP_IMPL,  "NOP", MODE_IMPL, 1, 2) \
+    X(BRK_IMPL,  "BRK", MODE_IMPL, 1, 7) \
+
+//The 27 opcodes the 65C02 adds (without the Rockwell/WDC bit instructions, WAI and STP)
+#define OPCODE_LIST_65C02(X) \
+    X(BRA_REL,   "BRA", MODE_REL,  2, 2) \
+    X(PHX_IMPL,  "PHX", MODE_IMPL, 1, 3) \
+    X(PHY_IMPL,  "PHY", MODE_IMPL, 1, 3) \
+    X(PLX_IMPL,  "PLX", MODE_IMPL, 1, 4) \
+    X(PLY_IMPL,  "PLY", MODE_IMPL, 1, 4) \
+    X(STZ_ZRP,   "STZ", MODE_ZRP,  2, 3) \
+    X(STZ_ZRPX,  "STZ", MODE_ZRPX, 2, 4) \
+    X(STZ_ABS,   "STZ", MODE_ABS,  3, 4) \
+    X(STZ_ABSX,  "STZ", MODE_ABSX, 3, 5) \
+    X(TSB_ZRP,   "TSB", MODE_ZRP,  2, 5) \
+    X(TSB_ABS,   "TSB", MODE_ABS,  3, 6) \
+    X(TRB_ZRP,   "TRB", MODE_ZRP,  2, 5) \
+    X(TRB_ABS,   "TRB", MODE_ABS,  3, 6) \
+    X(INC_ACCU,  "INC", MODE_ACCU, 1, 2) \
+    X(DEC_ACCU,  "DEC", MODE_ACCU, 1, 2) \
+    X(BIT_IMMD,  "BIT", MODE_IMMD, 2, 2) \
+    X(BIT_ZRPX,  "BIT", MODE_ZRPX, 2, 4) \
+    X(BIT_ABSX,  "BIT", MODE_ABSX, 3, 4) \
+    X(JMP_AXIND, "JMP", MODE_AXIND, 3, 6) \
+    X(ORA_ZIND,  "ORA", MODE_ZIND, 2, 5) \
+    X(AND_ZIND,  "AND", MODE_ZIND, 2, 5) \
+    X(EOR_ZIND,  "EOR", MODE_ZIND, 2, 5) \
+    X(ADC_ZIND,  "ADC", MODE_ZIND, 2, 5) \
+    X(STA_ZIND,  "STA", MODE_ZIND, 2, 5) \
+    X(LDA_ZIND,  "LDA", MODE_ZIND, 2, 5) \
+    X(CMP_ZIND,  "CMP", MODE_ZIND, 2, 5) \
+    X(SBC_ZIND,  "SBC", MODE_ZIND, 2, 5) \
+
+#ifdef CPU_CMOS
+    #define OPCODE_LIST_VARIANT(X) OPCODE_LIST(X) OPCODE_LIST_65C02(X)
+#else
+    #define OPCODE_LIST_VARIANT(X) OPCODE_LIST(X)
+#endif
+
+//per-opcode info, indexed by opcode
+extern const TOpcodeInfo opcodeTable[256];
+
+//short name of addressing mode, e.g. "ZRPX"
+extern const char* addrModeNames[MODE_COUNT];
+
+#endif
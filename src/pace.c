@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <errno.h>
+#include "pace.h"
+
+
+static double diff(const struct timespec* a, const struct timespec* b)
+{
+    return (a->tv_sec - b->tv_sec) + (a->tv_nsec - b->tv_nsec) / 1e9;
+}
+
+static struct timespec add(const struct timespec* t, double secs)
+{
+    struct timespec r = *t;
+    long long ns = r.tv_nsec + (long long)(secs * 1e9);
+    r.tv_sec += ns / 1000000000LL;
+    r.tv_nsec = ns % 1000000000LL;
+    return r;
+}
+
+//start timeline at the current cycle count, hz = 0 means unthrottled (only the speed is measured)
+void paceStart(TPace p, double hz, uint64_t cycles)
+{
+    p->hz = hz;
+    p->start_cycles = cycles;
+    p->period = PACE_MIN_SLICE;
+    p->latency = 0;
+    clock_gettime(CLOCK_MONOTONIC, &p->start);
+    p->t0 = p->start;
+    p->t0_cycles = cycles;
+}
+
+//number of cycles to run in the next slice
+uint64_t paceSlice(TPace p)
+{
+    uint64_t n = (uint64_t)(p->period * p->hz);
+    return n ? n : 1;
+}
+
+//sleep until the wall clock reaches the time of the given cycle count
+void paceWait(TPace p, uint64_t cycles)
+{
+    struct timespec now, deadline;
+
+    if (p->hz <= 0) return;
+
+    deadline = add(&p->start, (cycles - p->start_cycles) / p->hz);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    double ahead = diff(&deadline, &now);
+    if (ahead < -PACE_MAX_BEHIND)
+    {
+        //host too slow (or process was stopped): start over instead of running flat out to catch up
+        p->start = now;
+        p->start_cycles = cycles;
+        return;
+    }
+    if (ahead <= 0) return;
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+
+    //calibrate: the slice should be long compared to how late we wake up
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    p->latency += (diff(&now, &deadline) - p->latency) / 16;
+
+    p->period = 8 * p->latency;
+    if (p->period < PACE_MIN_SLICE) p->period = PACE_MIN_SLICE;
+    if (p->period > PACE_MAX_SLICE) p->period = PACE_MAX_SLICE;
+}
+
+//seconds since paceStart
+double paceElapsed(TPace p)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return diff(&now, &p->t0);
+}
+
+//achieved speed since paceStart, as multiple of the 2A03 clock
+double paceSpeed(TPace p, uint64_t cycles)
+{
+    double secs = paceElapsed(p);
+    return (secs > 0) ? (cycles - p->t0_cycles) / secs / CLOCK_2A03 : 0;
+}
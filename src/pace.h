@@ -0,0 +1,47 @@
+#ifndef PACE_H
+#define PACE_H
+
+#include <time.h>
+#include "types.h"
+
+//Real-time pacing: run cpuRun in slices and sleep after each slice until the wall clock catches up with
+//the emulated cycles. Sleeping is done with clock_nanosleep on an absolute timeline (start time + cycles / hz),
+//so oversleeping in one slice is made up in the next one and no drift accumulates.
+//The slice length adapts to the measured wake-up latency: as short as possible for low jitter, but long
+//enough that the latency is small compared to it.
+
+#define CLOCK_2A03 1789773.0       //NTSC 2A03 clock in Hz
+
+#define PACE_MIN_SLICE 0.0005      //seconds
+#define PACE_MAX_SLICE 0.02        //seconds
+#define PACE_MAX_BEHIND 0.25       //if the host falls further behind, the timeline is restarted instead of racing to catch up
+
+typedef struct
+{
+    double   hz;            //target emulated clock
+    struct timespec start;  //wall clock time of start_cycles
+    uint64_t start_cycles;
+    double   period;        //current slice length in seconds
+    double   latency;       //average wake-up latency in seconds
+    struct timespec t0;     //for the speed report
+    uint64_t t0_cycles;
+} PaceStruct;
+
+typedef PaceStruct* TPace;
+
+//start timeline at the current cycle count, hz = 0 means unthrottled (only the speed is measured)
+void paceStart(TPace p, double hz, uint64_t cycles);
+
+//number of cycles to run in the next slice
+uint64_t paceSlice(TPace p);
+
+//sleep until the wall clock reaches the time of the given cycle count
+void paceWait(TPace p, uint64_t cycles);
+
+//achieved speed since paceStart, as multiple of the 2A03 clock
+double paceSpeed(TPace p, uint64_t cycles);
+
+//seconds since paceStart
+double paceElapsed(TPace p);
+
+#endif
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perfctr.h"
+
+
+const char* perfCounterNames[PERF_COUNT] = { "cycles", "instructions", "branch_misses", "l1i_misses", "l1d_misses" };
+
+static int fds[PERF_COUNT] = { -1, -1, -1, -1, -1 };
+static TPerfSample start;
+
+//value read with PERF_FORMAT_TOTAL_TIME_*, to notice counters that were multiplexed away
+typedef struct
+{
+    uint64_t value;
+    uint64_t enabled;
+    uint64_t running;
+} TPerfRead;
+
+
+static int openCounter(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint64_t cacheMisses(uint64_t cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+//read all counters, counters that did not run the whole time are invalid
+static void readAll(TPerfSample* s)
+{
+    for (int i = 0; i < PERF_COUNT; i++)
+    {
+        TPerfRead r;
+        s->value[i] = 0;
+        s->valid[i] = 0;
+
+        if (fds[i] < 0 || read(fds[i], &r, sizeof(r)) != sizeof(r)) continue;
+        if (r.running == 0) continue;
+
+        //multiplexed: scale up like perf stat does
+        s->value[i] = (r.running < r.enabled) ? (uint64_t)((double)r.value * r.enabled / r.running) : r.value;
+        s->valid[i] = 1;
+    }
+}
+
+//open all counters, returns the number of available ones (0: no perf events at all)
+int perfOpen(void)
+{
+    int count = 0;
+
+    fds[PERF_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[PERF_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[PERF_BRANCH_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    fds[PERF_L1I_MISSES] = openCounter(PERF_TYPE_HW_CACHE, cacheMisses(PERF_COUNT_HW_CACHE_L1I));
+    fds[PERF_L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE, cacheMisses(PERF_COUNT_HW_CACHE_L1D));
+
+    for (int i = 0; i < PERF_COUNT; i++)
+        if (fds[i] >= 0) count++;
+
+    return count;
+}
+
+void perfClose(void)
+{
+    for (int i = 0; i < PERF_COUNT; i++)
+    {
+        if (fds[i] >= 0) close(fds[i]);
+        fds[i] = -1;
+    }
+}
+
+//start of a measured slice
+void perfBegin(void)
+{
+    readAll(&start);
+}
+
+//end of a measured slice, s gets the counts since perfBegin
+void perfEnd(TPerfSample* s)
+{
+    readAll(s);
+    for (int i = 0; i < PERF_COUNT; i++)
+    {
+        s->valid[i] = s->valid[i] && start.valid[i];
+        s->value[i] = s->valid[i] ? s->value[i] - start.value[i] : 0;
+    }
+}
+
+//add counts of s to sum, a counter stays valid only if it is valid in both
+void perfAccumulate(TPerfSample* sum, const TPerfSample* s)
+{
+    for (int i = 0; i < PERF_COUNT; i++)
+    {
+        sum->valid[i] = sum->valid[i] && s->valid[i];
+        sum->value[i] += s->value[i];
+    }
+}
+
+//print s as JSON object, values divided by per (e.g. emulated instructions), invalid counters as null
+void perfWriteJson(FILE* f, const TPerfSample* s, uint64_t per)
+{
+    fprintf(f, "{ ");
+    for (int i = 0; i < PERF_COUNT; i++)
+    {
+        if (s->valid[i]) fprintf(f, "\"%s\": %.3f", perfCounterNames[i], per ? (double)s->value[i] / per : 0.0);
+        else fprintf(f, "\"%s\": null", perfCounterNames[i]);
+        fprintf(f, "%s", (i < PERF_COUNT - 1) ? ", " : " }");
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+#include <stdio.h>
+#include "types.h"
+
+//Host hardware counters (Linux perf_event_open) for the measurement tools.
+//The counters only count user space of the calling thread. Wrap a cpuRun slice in perfBegin/perfEnd
+//to see why a dispatch change is faster or slower: host instructions, branch misses and cache misses
+//per emulated instruction. Counters the kernel or the hardware does not offer are marked invalid,
+//everything else keeps working (e.g. in containers or VMs without a PMU).
+
+typedef enum
+{
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1I_MISSES,
+    PERF_L1D_MISSES,
+    PERF_COUNT
+} ePerfCounter;
+
+typedef struct
+{
+    uint64_t value[PERF_COUNT];
+    int      valid[PERF_COUNT];     //0 if the counter could not be opened or was not scheduled
+} TPerfSample;
+
+extern const char* perfCounterNames[PERF_COUNT];
+
+//open all counters, returns the number of available ones (0: no perf events at all)
+int perfOpen(void);
+
+void perfClose(void);
+
+//start of a measured slice
+void perfBegin(void);
+
+//end of a measured slice, s gets the counts since perfBegin
+void perfEnd(TPerfSample* s);
+
+//add counts of s to sum, a counter stays valid only if it is valid in both
+void perfAccumulate(TPerfSample* sum, const TPerfSample* s);
+
+//print s as JSON object, values divided by per (e.g. emulated instructions), invalid counters as null
+void perfWriteJson(FILE* f, const TPerfSample* s, uint64_t per);
+
+#endif
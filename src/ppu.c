@@ -0,0 +1,565 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ppu.h"
+#include "mem.h"
+#include "utils.h"
+
+
+#define FRAME_DOTS   (PPU_DOTS * PPU_LINES)
+#define VBLANK_DOT   (PPU_VBLANK_LINE * PPU_DOTS + 2)  //vblank is set at dot 1, i.e. once dots 0 and 1 are done
+#define OAM_DMA      0x4014
+#define DMA_CYCLES   513
+
+#define RENDERING(ppu) ((ppu)->mask & 0x18)
+
+
+//2C02 colors as 0xRRGGBB
+static const uint32_t colors[64] =
+{
+    0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
+    0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
+    0xADADAD, 0x155FD9, 0x4240FF, 0x7527FE, 0xA01ACC, 0xB71E7B, 0xB53120, 0x994E00,
+    0x6B6D00, 0x388700, 0x0C9300, 0x008F32, 0x007C8D, 0x000000, 0x000000, 0x000000,
+    0xFFFEFF, 0x64B0FF, 0x9290FF, 0xC676FF, 0xF36AFF, 0xFE6ECC, 0xFE8170, 0xEA9E22,
+    0xBCBE00, 0x88D800, 0x5CE430, 0x45E082, 0x48CDDE, 0x4F4F4F, 0x000000, 0x000000,
+    0xFFFEFF, 0xC0DFFF, 0xD3D2FF, 0xE8C8FF, 0xFBC2FF, 0xFEC4EA, 0xFECCC5, 0xF7D8A5,
+    0xE4E594, 0xCFEF96, 0xBDF4AB, 0xB3F3CC, 0xB5EBF2, 0xB8B8B8, 0x000000, 0x000000
+};
+
+//bit plane byte -> its 8 bits spread to every other bit, leftmost pixel in bits 0-1 of a tile row
+static uint16_t spread[256];
+static pthread_once_t spreadOnce = PTHREAD_ONCE_INIT;   //PPUs may be created on several threads at once
+
+static void initSpread(void)
+{
+    for (dword b = 0; b < 256; b++)
+    {
+        uint16_t s = 0;
+        for (dword i = 0; i < 8; i++)
+            if (b & (0x80 >> i)) s |= 1 << (2 * i);
+        spread[b] = s;
+    }
+}
+
+//8 pixels of 2 bits from the two bit planes of a tile row, pixel i in bits 2i..2i+1
+static inline uint16_t tileRow(word lo, word hi)
+{
+    return spread[lo] | (spread[hi] << 1);
+}
+
+//############################# PPU ADDRESS SPACE #############################
+
+static dword nametableIndex(TPpu ppu, address a)
+{
+    dword table = (a >> 10) & 3;
+    switch (ppu->mirroring)
+    {
+        case PPU_MIRROR_HORIZONTAL: table >>= 1; break;
+        case PPU_MIRROR_VERTICAL:   table &= 1; break;
+        case PPU_MIRROR_SINGLE0:    table = 0; break;
+        case PPU_MIRROR_SINGLE1:    table = 1; break;
+        case PPU_MIRROR_FOUR:       break;
+    }
+    return (table << 10) | (a & 0x3FF);
+}
+
+//$3F10/$3F14/$3F18/$3F1C are the backdrop entries of the background palettes
+static inline dword paletteIndex(address a)
+{
+    dword i = a & 0x1F;
+    return ((i & 0x13) == 0x10) ? (i & 0x0F) : i;
+}
+
+static word vramRead(TPpu ppu, address a)
+{
+    a &= 0x3FFF;
+    if (a < 0x2000) return ppu->chr[a >> 12][a & 0xFFF];
+    if (a < 0x3F00) return ppu->vram[nametableIndex(ppu, a)];
+    return ppu->palette[paletteIndex(a)];
+}
+
+static void vramWrite(TPpu ppu, word w, address a)
+{
+    a &= 0x3FFF;
+    if (a < 0x2000)
+    {
+        if (ppu->chr_writable) ppu->chr[a >> 12][a & 0xFFF] = w;
+    }
+    else if (a < 0x3F00) ppu->vram[nametableIndex(ppu, a)] = w;
+    else
+    {
+        ppu->palette[paletteIndex(a)] = w & 0x3F;
+        ppu->pixels_dirty = 1;
+    }
+}
+
+//############################# RENDERING #############################
+
+//palette entries as RGBA pixels in memory order, so a pixel is a single store
+static void buildPixels(TPpu ppu)
+{
+    for (dword i = 0; i < 32; i++)
+    {
+        word index = ppu->palette[i];
+        if (ppu->mask & 0x01) index &= 0x30;    //greyscale
+        uint32_t c = colors[index & 0x3F];
+        word rgba[4] = { c >> 16, c >> 8, c, 0xFF };
+        memcpy(&ppu->pixels[i], rgba, 4);
+    }
+    ppu->pixels_dirty = 0;
+}
+
+//sprites of the line into ppu->sprites; lower OAM index wins, even when it is behind the background
+static void evalSprites(TPpu ppu, dword line)
+{
+    memset(ppu->sprites, 0, sizeof(ppu->sprites));
+    if (!(ppu->mask & 0x10)) return;
+
+    dword height = (ppu->ctrl & 0x20) ? 16 : 8;
+    dword count = 0;
+
+    for (dword i = 0; i < 64; i++)
+    {
+        const word* s = &ppu->oam[i * 4];
+        int row = (int)line - (s[0] + 1);  //sprites are drawn one line below their Y
+        if (row < 0 || row >= (int)height) continue;
+        if (++count > 8)
+        {
+            ppu->status |= 0x20;
+            break;
+        }
+
+        word tile = s[1];
+        word attr = s[2];
+        if (attr & 0x80) row = height - 1 - row;
+
+        address p;
+        if (height == 16) p = ((tile & 1) << 12) + (tile & 0xFE) * 16 + ((row & 8) << 1) + (row & 7);
+        else p = ((ppu->ctrl & 0x08) << 9) + tile * 16 + row;
+        const word* t = ppu->chr[p >> 12] + (p & 0xFFF);     //both planes of a tile are in the same bank
+        uint16_t bits = tileRow(t[0], t[8]);
+
+        word flags = 0x10 | ((attr & 3) << 2) | ((attr & 0x20) << 1) | ((i == 0) ? 0x80 : 0);
+        for (dword j = 0; j < 8; j++)
+        {
+            dword x = s[3] + j;
+            if (x >= PPU_WIDTH) break;
+            word c = (bits >> (2 * ((attr & 0x40) ? 7 - j : j))) & 3;
+            if (c && !ppu->sprites[x]) ppu->sprites[x] = flags | c;
+        }
+    }
+}
+
+//background pixels px0..px1 of the line as palette index, a tile row at a time
+static void background(TPpu ppu, word* bg, dword px0, dword px1)
+{
+    dword v = ppu->span_v;
+    dword fine_y = (v >> 12) & 7;
+    dword coarse_y = (v >> 5) & 31;
+    address table = (ppu->ctrl & 0x10) << 8;
+    dword offset = px0 - ppu->span_px + ppu->fine_x;   //pixel from the left edge of span_v's tile
+    dword px = px0;
+
+    while (px < px1)
+    {
+        dword cx = (v & 31) + (offset >> 3);
+        address nt = 0x2000 | ((((v >> 10) & 3) ^ ((cx >> 5) & 1)) << 10);
+        cx &= 31;
+
+        word tile = vramRead(ppu, nt | (coarse_y << 5) | cx);
+        word attr = vramRead(ppu, nt | 0x3C0 | ((coarse_y >> 2) << 3) | (cx >> 2));
+        word pal = ((attr >> (((coarse_y & 2) << 1) | (cx & 2))) & 3) << 2;
+        address p = table + tile * 16 + fine_y;
+        const word* t = ppu->chr[p >> 12] + (p & 0xFFF);
+        uint16_t row = tileRow(t[0], t[8]);
+
+        for (dword i = offset & 7; i < 8 && px < px1; i++, px++, offset++)
+        {
+            word c = (row >> (2 * i)) & 3;
+            bg[px] = c ? (pal | c) : 0;
+        }
+    }
+}
+
+//pixels px0..px1 of a visible line into the framebuffer
+static void renderSpan(TPpu ppu, dword line, dword px0, dword px1)
+{
+    word* out = &ppu->rgba[(line * PPU_WIDTH + px0) * 4];
+    word bg[PPU_WIDTH];
+
+    if (ppu->pixels_dirty) buildPixels(ppu);
+
+    if (!RENDERING(ppu))
+    {
+        for (dword px = px0; px < px1; px++, out += 4) memcpy(out, &ppu->pixels[0], 4);
+        return;
+    }
+
+    if (ppu->mask & 0x08) background(ppu, bg, px0, px1);
+    else memset(bg + px0, 0, px1 - px0);
+
+    for (dword px = px0; px < px1; px++, out += 4)
+    {
+        word b = bg[px];
+        word s = ppu->sprites[px];
+        if (px < 8)
+        {
+            if (!(ppu->mask & 0x02)) b = 0;
+            if (!(ppu->mask & 0x04)) s = 0;
+        }
+
+        if ((s & 0x80) && b && px != 255 && (ppu->mask & 0x18) == 0x18) ppu->status |= 0x40;
+
+        word c = (s && (!b || !(s & 0x40))) ? (s & 0x1F) : b;
+        memcpy(out, &ppu->pixels[c], 4);
+    }
+}
+
+//scroll updates the PPU does on its own while rendering
+static void incrementY(TPpu ppu)
+{
+    dword v = ppu->v;
+    if ((v & 0x7000) != 0x7000)
+    {
+        ppu->v = v + 0x1000;
+        return;
+    }
+    v &= ~0x7000;
+    dword y = (v >> 5) & 31;
+    if (y == 29)
+    {
+        y = 0;
+        v ^= 0x0800;
+    }
+    else if (y == 31) y = 0;
+    else y++;
+    ppu->v = (v & ~0x03E0) | (y << 5);
+}
+
+static void copyX(TPpu ppu)
+{
+    ppu->v = (ppu->v & ~0x041F) | (ppu->t & 0x041F);
+}
+
+static void copyY(TPpu ppu)
+{
+    ppu->v = (ppu->v & 0x041F) | (ppu->t & ~0x041F & 0x7FFF);
+}
+
+static void updateNmi(TPpu ppu)
+{
+    cpuSetNmi(ppu->cpu, (ppu->status & 0x80) && (ppu->ctrl & 0x80));
+}
+
+//advance to target (dots since base): whole lines at once, a line that is not complete yet up to its dot
+static void run(TPpu ppu, uint64_t target)
+{
+    while (ppu->dot < target)
+    {
+        dword line = ppu->line;
+        dword x = ppu->x;
+        uint64_t left = target - ppu->dot;
+        dword to = (left < PPU_DOTS - x) ? x + (dword)left : PPU_DOTS;
+
+        if (line < PPU_HEIGHT)
+        {
+            if (x == 0)
+            {
+                ppu->span_v = ppu->v;
+                ppu->span_px = 0;
+                evalSprites(ppu, line);
+            }
+
+            //pixel px is output at dot px + 1
+            dword px0 = (x > 1) ? ((x - 1 < PPU_WIDTH) ? x - 1 : PPU_WIDTH) : 0;
+            dword px1 = (to > 1) ? ((to - 1 < PPU_WIDTH) ? to - 1 : PPU_WIDTH) : 0;
+            if (px1 > px0) renderSpan(ppu, line, px0, px1);
+
+            if (RENDERING(ppu) && x <= 256 && to > 256)
+            {
+                incrementY(ppu);
+                copyX(ppu);
+            }
+        }
+        else if (line == PPU_VBLANK_LINE)
+        {
+            if (x <= 1 && to > 1)
+            {
+                ppu->status |= 0x80;
+                updateNmi(ppu);
+            }
+        }
+        else if (line == PPU_PRERENDER_LINE)
+        {
+            if (x <= 1 && to > 1)
+            {
+                ppu->status &= 0x1F;
+                updateNmi(ppu);
+            }
+            if (RENDERING(ppu) && x <= 256 && to > 256) copyX(ppu);
+            if (RENDERING(ppu) && x <= 280 && to > 280) copyY(ppu);
+        }
+
+        ppu->dot += to - x;
+        ppu->x = to;
+        if (to == PPU_DOTS)
+        {
+            ppu->x = 0;
+            ppu->line++;
+            if (ppu->line == PPU_HEIGHT) ppu->frames++;
+            if (ppu->line == PPU_LINES) ppu->line = 0;
+        }
+    }
+}
+
+static void catchUp(void* dev, uint64_t now)
+{
+    TPpu ppu = (TPpu)dev;
+    run(ppu, (now - ppu->base) * PPU_DOTS_PER_CYCLE);
+}
+
+//raise the NMI on time, even if nobody reads the PPU
+static void vblankEvent(void* ctx, uint64_t when)
+{
+    TPpu ppu = (TPpu)ctx;
+    catchUp(ppu, when);
+
+    uint64_t next = (ppu->dot < VBLANK_DOT) ? VBLANK_DOT : ((ppu->dot - VBLANK_DOT) / FRAME_DOTS + 1) * FRAME_DOTS + VBLANK_DOT;
+    cpuSchedule(ppu->cpu, ppu->base + (next + PPU_DOTS_PER_CYCLE - 1) / PPU_DOTS_PER_CYCLE, vblankEvent, ppu);
+}
+
+//a register access in the visible part of a rendered line: the line continues with the new state from here
+static int midLine(TPpu ppu)
+{
+    if (ppu->line >= PPU_HEIGHT || ppu->x < 2 || ppu->x > PPU_WIDTH || !RENDERING(ppu)) return 0;
+
+    uint64_t start = ppu->dot - ppu->x;
+    if (ppu->split_at != start)
+    {
+        ppu->split_at = start;
+        ppu->split_lines++;
+    }
+    return 1;
+}
+
+//############################# BUS #############################
+
+static word ppuRead(void* dev, address a)
+{
+    TPpu ppu = (TPpu)dev;
+    word w = 0;
+
+    switch (a & 7)
+    {
+        case 2:
+            w = (ppu->status & 0xE0) | (ppu->read_buffer & 0x1F);
+            ppu->status &= 0x7F;
+            ppu->toggle = 0;
+            updateNmi(ppu);
+            break;
+        case 4:
+            w = ppu->oam[ppu->oam_addr];
+            break;
+        case 7:
+            //delayed by one read, except for the palette (the buffer gets the nametable byte below it)
+            w = ppu->read_buffer;
+            ppu->read_buffer = vramRead(ppu, ppu->v);
+            if ((ppu->v & 0x3FFF) >= 0x3F00)
+            {
+                w = ppu->read_buffer;
+                ppu->read_buffer = vramRead(ppu, ppu->v - 0x1000);
+            }
+            ppu->v = (ppu->v + ((ppu->ctrl & 0x04) ? 32 : 1)) & 0x7FFF;
+            break;
+        default:
+            break;
+    }
+    return w;
+}
+
+static word ppuPeek(void* dev, address a)
+{
+    TPpu ppu = (TPpu)dev;
+    switch (a & 7)
+    {
+        case 2: return ppu->status;
+        case 4: return ppu->oam[ppu->oam_addr];
+        case 7: return ppu->read_buffer;
+        default: return 0;
+    }
+}
+
+static void ppuWrite(void* dev, word w, address a)
+{
+    TPpu ppu = (TPpu)dev;
+
+    switch (a & 7)
+    {
+        case 0:
+            midLine(ppu);
+            ppu->ctrl = w;
+            ppu->t = (ppu->t & ~0x0C00) | ((w & 3) << 10);
+            updateNmi(ppu);
+            break;
+        case 1:
+            midLine(ppu);
+            if ((ppu->mask ^ w) & 0x01) ppu->pixels_dirty = 1;
+            ppu->mask = w;
+            break;
+        case 3:
+            ppu->oam_addr = w;
+            break;
+        case 4:
+            ppu->oam[ppu->oam_addr++] = w;
+            break;
+        case 5:
+            midLine(ppu);
+            if (!ppu->toggle)
+            {
+                ppu->t = (ppu->t & ~0x001F) | (w >> 3);
+                ppu->fine_x = w & 7;
+            }
+            else ppu->t = (ppu->t & ~0x73E0) | ((w & 7) << 12) | ((w & 0xF8) << 2);
+            ppu->toggle ^= 1;
+            break;
+        case 6:
+            if (!ppu->toggle) ppu->t = (ppu->t & 0x00FF) | ((w & 0x3F) << 8);
+            else
+            {
+                ppu->t = (ppu->t & 0x7F00) | w;
+                ppu->v = ppu->t;
+                if (midLine(ppu))
+                {
+                    ppu->span_v = ppu->v;
+                    ppu->span_px = ppu->x - 1;
+                }
+            }
+            ppu->toggle ^= 1;
+            break;
+        case 7:
+            midLine(ppu);
+            vramWrite(ppu, w, ppu->v);
+            ppu->v = (ppu->v + ((ppu->ctrl & 0x04) ? 32 : 1)) & 0x7FFF;
+            break;
+        default:
+            break;
+    }
+}
+
+static word dmaRead(void* dev, address a)
+{
+    TPpu ppu = (TPpu)dev;
+    return memIoPassRead(ppu->cpu->mem, &ppu->dma_io, a);
+}
+
+static word dmaPeek(void* dev, address a)
+{
+    TPpu ppu = (TPpu)dev;
+    return memIoPassPeek(ppu->cpu->mem, &ppu->dma_io, a);
+}
+
+//$4014: copy a CPU page to OAM, the CPU is stalled meanwhile
+static void dmaWrite(void* dev, word w, address a)
+{
+    TPpu ppu = (TPpu)dev;
+    T6502 cpu = ppu->cpu;
+
+    if (a != OAM_DMA)
+    {
+        memIoPassWrite(cpu->mem, &ppu->dma_io, w, a);
+        return;
+    }
+
+    ppuSync(ppu);
+    for (dword i = 0; i < 256; i++) ppu->oam[(ppu->oam_addr + i) & 0xFF] = memRead(cpu->mem, (w << 8) | i);
+    cpu->cycles += DMA_CYCLES + (cpu->cycles & 1);
+}
+
+//############################# API #############################
+
+TPpu ppuInit(T6502 cpu)
+{
+    pthread_once(&spreadOnce, initSpread);
+
+    TPpu ppu = (TPpu)calloc(1, sizeof(PpuStruct));
+    ppu->cpu = cpu;
+    ppu->chr[0] = ppu->chr_ram;
+    ppu->chr[1] = ppu->chr_ram + 0x1000;
+    ppu->chr_writable = 1;
+    ppu->mirroring = PPU_MIRROR_HORIZONTAL;
+    ppu->base = cpu->cycles;
+    ppu->split_at = UINT64_MAX;
+    ppu->pixels_dirty = 1;
+
+    ppu->io.dev = ppu;
+    ppu->io.read = ppuRead;
+    ppu->io.write = ppuWrite;
+    ppu->io.peek = ppuPeek;
+    ppu->io.catchUp = catchUp;
+    memMapIo(cpu->mem, 0x20, 0x3F, &ppu->io);
+
+    //OAM DMA only syncs the PPU itself, other accesses to page $40 are not the PPU's business
+    ppu->dma_io.dev = ppu;
+    ppu->dma_io.read = dmaRead;
+    ppu->dma_io.write = dmaWrite;
+    ppu->dma_io.peek = dmaPeek;
+    ppu->dma_io.catchUp = NULL;
+    memMapIo(cpu->mem, 0x40, 0x40, &ppu->dma_io);
+
+    cpuSchedule(cpu, ppu->base + (VBLANK_DOT + PPU_DOTS_PER_CYCLE - 1) / PPU_DOTS_PER_CYCLE, vblankEvent, ppu);
+    return ppu;
+}
+
+void ppuClose(TPpu ppu)
+{
+    cpuUnschedule(ppu->cpu, vblankEvent, ppu);
+    memUnmapIo(ppu->cpu->mem, &ppu->dma_io);
+    memUnmapIo(ppu->cpu->mem, &ppu->io);
+    free(ppu);
+}
+
+void ppuSetCartridge(TPpu ppu, ePpuMirroring mirroring, word* chr, int writable)
+{
+    ppuSync(ppu);
+    ppu->mirroring = mirroring;
+    if (chr == NULL) chr = ppu->chr_ram;
+    ppu->chr[0] = chr;
+    ppu->chr[1] = chr + 0x1000;
+    ppu->chr_writable = (chr != ppu->chr_ram) ? (writable != 0) : 1;
+}
+
+void ppuSetBanks(TPpu ppu, ePpuMirroring mirroring, word* chr_lo, word* chr_hi)
+{
+    ppuSync(ppu);
+    ppu->mirroring = mirroring;
+    ppu->chr[0] = chr_lo;
+    ppu->chr[1] = chr_hi;
+    ppu->chr_writable = 0;
+}
+
+void ppuSync(TPpu ppu)
+{
+    catchUp(ppu, ppu->cpu->cycles);
+}
+
+const word* ppuFramebuffer(TPpu ppu)
+{
+    return ppu->rgba;
+}
+
+int ppuWritePpm(TPpu ppu, const char* file)
+{
+    FILE* f = fopen(file, "wb");
+    if (f == NULL)
+    {
+        logMessage("IO error: could not open file %s \n", file);
+        return -1;
+    }
+
+    fprintf(f, "P6\n%d %d\n255\n", PPU_WIDTH, PPU_HEIGHT);
+    for (dword i = 0; i < PPU_WIDTH * PPU_HEIGHT; i++) fwrite(&ppu->rgba[i * 4], 1, 3, f);
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,103 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include "types.h"
+#include "6502.h"
+
+//Headless 2C02 PPU: registers at $2000-$2007 (mirrored up to $3FFF) and OAM DMA at $4014.
+//The PPU is a device on the memory bus and renders lazily: when the CPU touches a register, and at the
+//start of vblank (a scheduled event, it raises the NMI), it catches up to the current dot. Lines it passes
+//completely are rendered in one go, 8 pixels per tile row from bit-plane lookup tables, with the sprites of
+//the line composed in afterwards. A register access in the middle of a visible line splits the line at that
+//dot: the left part is rendered with the old state, the rest with the new one, which gives per-dot results
+//for raster effects (split scrolling, sprite 0 polling) without paying for them on every line.
+//Simplifications: no odd-frame dot skip, no sprite overflow bug, no open bus, writes take effect at the end
+//of the instruction (when the CPU's cycle counter has been advanced).
+
+#define PPU_WIDTH          256
+#define PPU_HEIGHT         240
+#define PPU_DOTS           341             //dots per scanline
+#define PPU_LINES          262             //scanlines per frame, NTSC
+#define PPU_VBLANK_LINE    241
+#define PPU_PRERENDER_LINE 261
+#define PPU_DOTS_PER_CYCLE 3
+
+typedef enum
+{
+    PPU_MIRROR_HORIZONTAL,      //$2000=$2400, $2800=$2C00
+    PPU_MIRROR_VERTICAL,        //$2000=$2800, $2400=$2C00
+    PPU_MIRROR_SINGLE0,
+    PPU_MIRROR_SINGLE1,
+    PPU_MIRROR_FOUR             //4K VRAM on the cartridge
+} ePpuMirroring;
+
+typedef struct
+{
+    T6502      cpu;
+    TIoHandler io;              //$2000-$3FFF
+    TIoHandler dma_io;          //$4014, shares page $40 with the APU
+
+    //PPU address space
+    word*      chr[2];          //pattern tables $0000-$0FFF and $1000-$1FFF, chr_ram unless a cartridge provides CHR ROM
+    word       chr_writable;
+    word       chr_ram[0x2000];
+    word       vram[0x1000];    //nametables, 2K used unless four-screen
+    word       palette[32];
+    word       oam[256];
+    ePpuMirroring mirroring;
+
+    //registers
+    word       ctrl;            //$2000
+    word       mask;            //$2001
+    word       status;          //$2002: vblank, sprite 0 hit, overflow
+    word       oam_addr;
+    word       read_buffer;     //$2007 read delay
+    dword      v;               //current VRAM address / scroll (15 bit)
+    dword      t;               //temporary VRAM address
+    word       fine_x;
+    word       toggle;          //$2005/$2006 write toggle (w)
+
+    //timing
+    uint64_t   base;            //CPU cycle of dot 0
+    uint64_t   dot;             //dots since base, rendered up to here
+    dword      line;            //current scanline
+    dword      x;               //current dot in the line
+    uint64_t   frames;          //completed frames
+    uint64_t   split_lines;     //visible lines split by a register access
+    uint64_t   split_at;        //dot the last split line started at
+
+    //current line
+    dword      span_v;          //v at span_px, the background of the line continues from here
+    dword      span_px;
+    word       sprites[PPU_WIDTH];  //sprite pixel per x: 0 transparent, else palette index | 0x40 behind | 0x80 sprite 0
+
+    uint32_t   pixels[32];      //palette as RGBA pixels, greyscale applied
+    word       pixels_dirty;    //palette or greyscale changed since pixels were built
+
+    word       rgba[PPU_WIDTH * PPU_HEIGHT * 4];
+} PpuStruct;
+
+typedef PpuStruct* TPpu;
+
+//create PPU, map it at $2000-$3FFF and $4014 and schedule vblank, call after cpuReset
+TPpu ppuInit(T6502 cpu);
+
+//unmap and free PPU
+void ppuClose(TPpu ppu);
+
+//set nametable mirroring, and CHR ROM (8K, not copied) or NULL for the internal CHR RAM
+void ppuSetCartridge(TPpu ppu, ePpuMirroring mirroring, word* chr, int writable);
+
+//set nametable mirroring and two 4K CHR ROM banks (not copied, read only), for mappers that switch them
+void ppuSetBanks(TPpu ppu, ePpuMirroring mirroring, word* chr_lo, word* chr_hi);
+
+//render up to the current cycle
+void ppuSync(TPpu ppu);
+
+//RGBA framebuffer, PPU_WIDTH x PPU_HEIGHT, 4 bytes per pixel; holds a complete frame during vblank
+const word* ppuFramebuffer(TPpu ppu);
+
+//write framebuffer as binary PPM (P6), returns 0 on success
+int ppuWritePpm(TPpu ppu, const char* file);
+
+#endif
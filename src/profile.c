@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "profile.h"
+
+//one node per distinct call path
+typedef struct
+{
+    address  entry;         //subroutine (or interrupt handler) address
+    uint32_t parent;        //index of caller node, root is 0
+    uint32_t first_child;   //index of first callee node, 0 if none
+    uint32_t next_sibling;  //index of next node with the same caller, 0 if none
+    uint64_t cycles;        //cycles spent in this path itself (without callees)
+} TProfNode;
+
+int profEnabled = 0;
+TProfCount profPcCounts[0x10000];
+uint64_t* profFrameCycles = NULL;
+
+static TProfNode* nodes = NULL;
+static uint32_t nodeCount = 0;
+static uint32_t stack[PROF_MAX_DEPTH];     //shadow call stack of node indices, stack[0] is root
+static uint32_t depth = 0;                 //index of the current frame
+static uint32_t lost = 0;                  //calls beyond PROF_MAX_DEPTH that were not pushed
+
+//start recording, resets all previous data
+void profStart(void)
+{
+    if (nodes == NULL) nodes = (TProfNode*)malloc(sizeof(TProfNode) * PROF_MAX_NODES);
+
+    memset(profPcCounts, 0, sizeof(profPcCounts));
+    memset(&nodes[0], 0, sizeof(TProfNode));
+    nodeCount = 1;
+    depth = 0;
+    lost = 0;
+    stack[0] = 0;
+    profFrameCycles = &nodes[0].cycles;
+    profEnabled = 1;
+}
+
+//find callee of current frame with given entry address, create it if it does not exist yet
+static uint32_t child(uint32_t parent, address entry)
+{
+    for (uint32_t i = nodes[parent].first_child; i != 0; i = nodes[i].next_sibling)
+        if (nodes[i].entry == entry) return i;
+
+    if (nodeCount >= PROF_MAX_NODES) return parent;
+
+    uint32_t i = nodeCount++;
+    nodes[i].entry = entry;
+    nodes[i].parent = parent;
+    nodes[i].first_child = 0;
+    nodes[i].next_sibling = nodes[parent].first_child;
+    nodes[i].cycles = 0;
+    nodes[parent].first_child = i;
+    return i;
+}
+
+//enter subroutine or interrupt handler at entry
+void profCall(address entry)
+{
+    if (depth + 1 >= PROF_MAX_DEPTH)
+    {
+        lost++;
+        return;
+    }
+    stack[depth + 1] = child(stack[depth], entry);
+    depth++;
+    profFrameCycles = &nodes[stack[depth]].cycles;
+}
+
+//leave subroutine or interrupt handler
+void profReturn(void)
+{
+    if (lost > 0) lost--;
+    else if (depth > 0) depth--;
+    profFrameCycles = &nodes[stack[depth]].cycles;
+}
+
+//write path from root to node i, separated by ';'
+static void writePath(FILE* f, uint32_t i)
+{
+    if (i == 0)
+    {
+        fprintf(f, "reset");
+        return;
+    }
+    writePath(f, nodes[i].parent);
+    fprintf(f, ";sub_%.4X", nodes[i].entry);
+}
+
+//write all call paths with their cycles as folded stacks
+void profWriteFolded(FILE* f)
+{
+    for (uint32_t i = 0; i < nodeCount; i++)
+    {
+        if (nodes[i].cycles == 0) continue;
+        writePath(f, i);
+        fprintf(f, " %llu\n", (unsigned long long)nodes[i].cycles);
+    }
+}
+
+//write the n PCs with the most cycles
+void profWriteHotspots(FILE* f, uint32_t n)
+{
+    uint64_t total = 0;
+    for (uint32_t pc = 0; pc < 0x10000; pc++) total += profPcCounts[pc].cycles;
+    if (total == 0) return;
+
+    fprintf(f, "\n*** Hotspots (by cycles) *** \n");
+    fprintf(f, "PC      instructions        cycles      %%\n");
+
+    //selection of the n largest entries, n is small
+    static word picked[0x10000];
+    memset(picked, 0, sizeof(picked));
+    for (uint32_t k = 0; k < n; k++)
+    {
+        uint32_t best = 0;
+        int found = 0;
+        for (uint32_t pc = 0; pc < 0x10000; pc++)
+        {
+            if (picked[pc] || profPcCounts[pc].cycles == 0) continue;
+            if (!found || profPcCounts[pc].cycles > profPcCounts[best].cycles)
+            {
+                best = pc;
+                found = 1;
+            }
+        }
+        if (!found) break;
+
+        picked[best] = 1;
+        fprintf(f, "0x%.4X  %12llu  %12llu  %5.1f\n", best, (unsigned long long)profPcCounts[best].instructions,
+                (unsigned long long)profPcCounts[best].cycles, 100.0 * profPcCounts[best].cycles / total);
+    }
+    fprintf(f, "************************* \n");
+}
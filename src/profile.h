@@ -0,0 +1,56 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include "types.h"
+
+//Guest profiler, compiled into the run loop only with -DENABLE_PROFILER.
+//It keeps a per-PC histogram of instructions and cycles and a shadow call stack, which follows
+//JSR/RTS and BRK/RTI. Cycles are attributed to the call path they were spent in, which is written
+//as folded stacks ("reset;sub_0208;sub_0300 1234") as flame graph tools expect them.
+
+#define PROF_MAX_DEPTH 256      //deeper calls are attributed to the deepest tracked frame
+#define PROF_MAX_NODES 65536    //distinct call paths, further paths are attributed to their caller
+
+//histogram entry, instructions and cycles side by side so one instruction touches one cache line
+typedef struct
+{
+    uint64_t instructions;
+    uint64_t cycles;
+} TProfCount;
+
+extern int profEnabled;                     //recording is skipped while 0
+extern TProfCount profPcCounts[0x10000];    //per-PC histogram
+extern uint64_t* profFrameCycles;           //cycle counter of the current call path
+
+//start recording, resets all previous data
+void profStart(void);
+
+//shadow stack maintenance, called for JSR/BRK and RTS/RTI only
+void profCall(address entry);
+void profReturn(void);
+
+//account one executed instruction: it was fetched at pc, opcode is the one executed, next_pc is the new PC
+static inline void profRecord(address pc, word opcode, address next_pc, uint32_t cycles)
+{
+    profPcCounts[pc].instructions++;
+    profPcCounts[pc].cycles += cycles;
+
+    //the call instruction itself still belongs to the caller
+    *profFrameCycles += cycles;
+
+    //JSR (0x20), BRK (0x00), RTS (0x60) and RTI (0x40) are the only opcodes with bits 0-4 clear and bit 7 clear
+    if ((opcode & 0x9F) == 0)
+    {
+        if (opcode == 0x20 || opcode == 0x00) profCall(next_pc);
+        else profReturn();
+    }
+}
+
+//write all call paths with their cycles as folded stacks
+void profWriteFolded(FILE* f);
+
+//write the n PCs with the most cycles
+void profWriteHotspots(FILE* f, uint32_t n);
+
+#endif
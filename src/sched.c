@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include "sched.h"
+#include "utils.h"
+
+
+//a fires before b
+static int before(const TEvent* a, const TEvent* b)
+{
+    return (a->when < b->when) || (a->when == b->when && a->seq < b->seq);
+}
+
+static void swap(TScheduler s, uint32_t i, uint32_t j)
+{
+    TEvent t = s->heap[i];
+    s->heap[i] = s->heap[j];
+    s->heap[j] = t;
+}
+
+static void siftUp(TScheduler s, uint32_t i)
+{
+    while (i > 0)
+    {
+        uint32_t parent = (i - 1) / 2;
+        if (!before(&s->heap[i], &s->heap[parent])) break;
+        swap(s, i, parent);
+        i = parent;
+    }
+}
+
+static void siftDown(TScheduler s, uint32_t i)
+{
+    while (1)
+    {
+        uint32_t left = 2 * i + 1;
+        uint32_t right = left + 1;
+        uint32_t min = i;
+
+        if (left < s->count && before(&s->heap[left], &s->heap[min])) min = left;
+        if (right < s->count && before(&s->heap[right], &s->heap[min])) min = right;
+        if (min == i) break;
+
+        swap(s, i, min);
+        i = min;
+    }
+}
+
+//remove heap entry i
+static void removeAt(TScheduler s, uint32_t i)
+{
+    s->count--;
+    if (i == s->count) return;
+
+    s->heap[i] = s->heap[s->count];
+    siftDown(s, i);
+    siftUp(s, i);
+}
+
+//remove all events
+void schedReset(TScheduler s)
+{
+    s->count = 0;
+    s->seq = 0;
+}
+
+//add event fn(ctx, when), returns 0 on success, -1 if the heap is full
+int schedAdd(TScheduler s, uint64_t when, TEventFn fn, void* ctx)
+{
+    if (s->count >= SCHED_MAX_EVENTS)
+    {
+        logMessage("Error: too many scheduled events \n");
+        return -1;
+    }
+
+    TEvent* e = &s->heap[s->count];
+    e->when = when;
+    e->seq = s->seq++;
+    e->fn = fn;
+    e->ctx = ctx;
+
+    siftUp(s, s->count++);
+    return 0;
+}
+
+//remove all events with the given callback and context
+void schedRemove(TScheduler s, TEventFn fn, void* ctx)
+{
+    uint32_t i = 0;
+    while (i < s->count)
+    {
+        if (s->heap[i].fn == fn && s->heap[i].ctx == ctx)
+        {
+            removeAt(s, i);
+            i = 0;  //the entry moved into i may have moved up
+        }
+        else i++;
+    }
+}
+
+//run all events due at cycle now, in deadline order; callbacks may add and remove events
+void schedDispatch(TScheduler s, uint64_t now)
+{
+    while (s->count && s->heap[0].when <= now)
+    {
+        TEvent e = s->heap[0];
+        removeAt(s, 0);
+        e.fn(e.ctx, e.when);
+    }
+}
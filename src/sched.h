@@ -0,0 +1,51 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "types.h"
+
+//Event scheduler for devices and timers: a binary min-heap of callbacks keyed by absolute cycle.
+//cpuRun executes uninterrupted up to the earliest deadline and dispatches the due events at that slice
+//boundary, so the cost is per event, not per instruction. An event fires at the first instruction
+//boundary at or after its deadline; the callback gets the deadline to compensate the overshoot.
+
+#define SCHED_MAX_EVENTS 64
+#define SCHED_NEVER UINT64_MAX
+
+typedef void (*TEventFn)(void* ctx, uint64_t when);
+
+typedef struct
+{
+    uint64_t when;      //absolute cycle
+    uint64_t seq;       //insertion order, events with the same deadline fire in that order
+    TEventFn fn;
+    void*    ctx;
+} TEvent;
+
+typedef struct
+{
+    TEvent   heap[SCHED_MAX_EVENTS];
+    uint32_t count;
+    uint64_t seq;
+} SchedStruct;
+
+typedef SchedStruct* TScheduler;
+
+//remove all events
+void schedReset(TScheduler s);
+
+//add event fn(ctx, when), returns 0 on success, -1 if the heap is full
+int schedAdd(TScheduler s, uint64_t when, TEventFn fn, void* ctx);
+
+//remove all events with the given callback and context
+void schedRemove(TScheduler s, TEventFn fn, void* ctx);
+
+//run all events due at cycle now, in deadline order; callbacks may add and remove events
+void schedDispatch(TScheduler s, uint64_t now);
+
+//deadline of the earliest event, SCHED_NEVER if there is none
+static inline uint64_t schedNext(TScheduler s)
+{
+    return s->count ? s->heap[0].when : SCHED_NEVER;
+}
+
+#endif
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "trace.h"
+#include "opcodes.h"
+#include "utils.h"
+
+
+#define WRITE_BATCH 4096    //records encoded per batch before the tail is published
+
+
+TTraceRing* traceRing = NULL;
+
+static FILE* traceFile = NULL;
+static pthread_t writer;
+static int stopping = 0;    //set by traceClose after the last record, atomic access only
+
+
+//length of the instruction, unknown opcodes count as 1 byte
+static word instrLength(word opcode)
+{
+    word len = opcodeTable[opcode].length;
+    return (len == 0) ? 1 : len;
+}
+
+//encode record r against prev into buf, returns number of bytes written (at most 16)
+uint32_t traceEncode(const TTraceRecord* prev, const TTraceRecord* r, word* buf)
+{
+    uint32_t n = 1;
+    word flags = 0;
+    word len = instrLength(r->opcode);
+
+    if (r->pc != (address)(prev->pc + instrLength(prev->opcode)))
+    {
+        flags |= TRACE_F_PC;
+        buf[n++] = r->pc & 0xFF;
+        buf[n++] = r->pc >> 8;
+    }
+
+    buf[n++] = r->opcode;
+    if (len > 1) buf[n++] = r->op1;
+    if (len > 2) buf[n++] = r->op2;
+
+    if (r->a != prev->a)   { flags |= TRACE_F_A;  buf[n++] = r->a; }
+    if (r->x != prev->x)   { flags |= TRACE_F_X;  buf[n++] = r->x; }
+    if (r->y != prev->y)   { flags |= TRACE_F_Y;  buf[n++] = r->y; }
+    if (r->p != prev->p)   { flags |= TRACE_F_P;  buf[n++] = r->p; }
+    if (r->sp != prev->sp) { flags |= TRACE_F_SP; buf[n++] = r->sp; }
+
+    //cycle delta as unsigned LEB128, almost always a single byte
+    uint64_t delta = r->cycle - prev->cycle;
+    do
+    {
+        word b = delta & 0x7F;
+        delta >>= 7;
+        buf[n++] = b | (delta ? 0x80 : 0);
+    } while (delta);
+
+    buf[0] = flags;
+    return n;
+}
+
+//decode one record from buf (of size len) against prev into r, returns bytes consumed or 0 if incomplete
+uint32_t traceDecode(const TTraceRecord* prev, const word* buf, uint32_t len, TTraceRecord* r)
+{
+    uint32_t n = 1;
+    if (len < 3) return 0;
+
+    word flags = buf[0];
+    *r = *prev;
+
+    if (flags & TRACE_F_PC)
+    {
+        r->pc = buf[1] | (buf[2] << 8);
+        n += 2;
+    }
+    else r->pc = prev->pc + instrLength(prev->opcode);
+
+    if (n >= len) return 0;
+    r->opcode = buf[n++];
+    word ilen = instrLength(r->opcode);
+    if (n + (ilen - 1) > len) return 0;
+    if (ilen > 1) r->op1 = buf[n++];
+    if (ilen > 2) r->op2 = buf[n++];
+
+    if (flags & TRACE_F_A)  { if (n >= len) return 0; r->a = buf[n++]; }
+    if (flags & TRACE_F_X)  { if (n >= len) return 0; r->x = buf[n++]; }
+    if (flags & TRACE_F_Y)  { if (n >= len) return 0; r->y = buf[n++]; }
+    if (flags & TRACE_F_P)  { if (n >= len) return 0; r->p = buf[n++]; }
+    if (flags & TRACE_F_SP) { if (n >= len) return 0; r->sp = buf[n++]; }
+
+    uint64_t delta = 0;
+    uint32_t shift = 0;
+    word b;
+    do
+    {
+        if (n >= len || shift > 63) return 0;
+        b = buf[n++];
+        delta |= (uint64_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    r->cycle = prev->cycle + delta;
+
+    return n;
+}
+
+//writer thread: drain ring, encode records and append them to the file
+static void* writerMain(void* arg)
+{
+    TTraceRing* ring = traceRing;
+    TTraceRecord prev;
+    static word buf[WRITE_BATCH * 16];
+
+    memset(&prev, 0, sizeof(prev));
+
+    while (1)
+    {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = ring->tail;
+
+        if (head == tail)
+        {
+            if (__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+            {
+                //records pushed before stopping was set may have come in after head was read
+                if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) break;
+                continue;
+            }
+
+            //nothing to do, back off a little instead of burning a core
+            struct timespec ts = { 0, 100000 };
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+        if (head - tail > WRITE_BATCH) head = tail + WRITE_BATCH;
+
+        uint32_t n = 0;
+        for (uint64_t i = tail; i < head; i++)
+        {
+            const TTraceRecord* r = &ring->records[i & (TRACE_RING_SIZE - 1)];
+            n += traceEncode(&prev, r, buf + n);
+            prev = *r;
+        }
+
+        //records are copied, hand the slots back before the (slow) file write
+        __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+
+        fwrite(buf, 1, n, traceFile);
+    }
+
+    return NULL;
+}
+
+//open trace file and start writer thread, returns 0 on success
+int traceOpen(const char* file)
+{
+    traceFile = fopen(file, "wb");
+    if (traceFile == NULL)
+    {
+        logMessage("IO error: could not open file %s \n", file);
+        return -1;
+    }
+    setvbuf(traceFile, NULL, _IOFBF, 1 << 20);
+    fwrite(TRACE_MAGIC, 1, TRACE_MAGIC_LEN, traceFile);
+
+    traceRing = (TTraceRing*)calloc(1, sizeof(TTraceRing));
+    __atomic_store_n(&stopping, 0, __ATOMIC_RELAXED);  //the writer is not running yet
+
+    if (pthread_create(&writer, NULL, writerMain, NULL) != 0)
+    {
+        logMessage("Error: could not start trace writer \n");
+        free(traceRing);
+        traceRing = NULL;
+        fclose(traceFile);
+        return -1;
+    }
+
+    return 0;
+}
+
+//drain the ring, stop writer thread and close trace file
+void traceClose(void)
+{
+    if (traceRing == NULL) return;
+
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);  //the records pushed so far are visible with it
+    pthread_join(writer, NULL);
+
+    fclose(traceFile);
+    free(traceRing);
+    traceRing = NULL;
+}
+
+//ring is full: wait until the writer thread has made room
+void traceWait(void)
+{
+    while (traceRing->head - __atomic_load_n(&traceRing->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_SIZE)
+        sched_yield();
+}
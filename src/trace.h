@@ -0,0 +1,92 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+#include "mem.h"
+
+//Compact binary execution trace, compiled into the run loop only with -DENABLE_BIN_TRACE.
+//The run loop captures one fixed-size record per instruction (state before execution) into a lock-free
+//single-producer/single-consumer ring. A writer thread takes the records out, delta-encodes them against
+//the previous record and appends them to the trace file. tools/tracedump.c turns the file back into text.
+//
+//File format: TRACE_MAGIC, then one entry per instruction:
+//  flags     1 byte, TRACE_F_* bits, set for fields that are stored explicitly
+//  pc        2 bytes LE, only if TRACE_F_PC (otherwise previous pc + previous instruction length)
+//  opcode    1 byte, followed by its operand bytes (instruction length - 1, 0 for unknown opcodes)
+//  A,X,Y,P,SP 1 byte each, only if the corresponding flag is set (otherwise same as before)
+//  cycles    LEB128 varint, cycles since previous record
+
+#define TRACE_MAGIC "6502TRC1"
+#define TRACE_MAGIC_LEN 8
+
+#define TRACE_F_PC  0x01
+#define TRACE_F_A   0x02
+#define TRACE_F_X   0x04
+#define TRACE_F_Y   0x08
+#define TRACE_F_P   0x10
+#define TRACE_F_SP  0x20
+
+#define TRACE_RING_SIZE (1 << 16)   //records, must be a power of 2
+
+typedef struct
+{
+    uint64_t cycle;     //cycle counter before execution
+    address  pc;
+    word     opcode;
+    word     op1;       //operand bytes, only valid up to the instruction length
+    word     op2;
+    word     a;
+    word     x;
+    word     y;
+    word     p;
+    word     sp;        //lo byte of the stack pointer
+} TTraceRecord;
+
+typedef struct
+{
+    TTraceRecord records[TRACE_RING_SIZE];
+    uint64_t head __attribute__((aligned(64)));     //next slot to write, only changed by the producer
+    uint64_t tail __attribute__((aligned(64)));     //next slot to read, only changed by the writer thread
+} TTraceRing;
+
+extern TTraceRing* traceRing;   //NULL while no trace is open
+
+//open trace file and start writer thread, returns 0 on success
+int traceOpen(const char* file);
+
+//drain the ring, stop writer thread and close trace file
+void traceClose(void);
+
+//ring is full: wait until the writer thread has made room
+void traceWait(void);
+
+//capture state before executing the instruction at pc
+static inline void traceRecord(TMemory mem, address pc, word a, word x, word y, word p, word sp, uint64_t cycle)
+{
+    TTraceRing* ring = traceRing;
+    uint64_t head = ring->head;
+
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_SIZE) traceWait();
+
+    TTraceRecord* r = &ring->records[head & (TRACE_RING_SIZE - 1)];
+    r->cycle = cycle;
+    r->pc = pc;
+    r->opcode = memPeek(mem, pc);
+    r->op1 = memPeek(mem, pc + 1);
+    r->op2 = memPeek(mem, pc + 2);
+    r->a = a;
+    r->x = x;
+    r->y = y;
+    r->p = p;
+    r->sp = sp;
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+//encode record r against prev into buf, returns number of bytes written (at most 16)
+uint32_t traceEncode(const TTraceRecord* prev, const TTraceRecord* r, word* buf);
+
+//decode one record from buf (of size len) against prev into r, returns bytes consumed or 0 if incomplete
+uint32_t traceDecode(const TTraceRecord* prev, const word* buf, uint32_t len, TTraceRecord* r);
+
+#endif
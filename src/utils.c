@@ -1,8 +1,10 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdarg.h>
 #include <math.h>
 #include "utils.h"
 #include "mem.h"
+#include "disasm.h"
 
 //6502 registers
 extern word 	X;  
@@ -20,23 +22,63 @@ const char* int2bin[] = {"0000", "0001", "0010", "0011", "0100", "0101", "0110",
 word bitmasks[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
 
 
+void logToStdout(void* ctx, const char* message)
+{
+    fputs(message, stdout);
+}
+
+void logToStderr(void* ctx, const char* message)
+{
+    fputs(message, stderr);
+}
+
+static TLogFn logFn = logToStderr;     //stdout belongs to the host, the CLI sets logToStdout
+static void* logCtx = NULL;
+
+void logSetHandler(TLogFn fn, void* ctx)
+{
+    logFn = fn;
+    logCtx = ctx;
+}
+
+int logEnabled(void)
+{
+    return logFn != NULL;
+}
+
+void logMessage(const char* format, ...)
+{
+    if (logFn == NULL) return;
+
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    logFn(logCtx, message);
+}
+
 void printRegs(T6502 cpu)
 {
-    printf("*** Register contents *** \n");
-    printf("X:  0x%.2X (%s.%s) \n", cpu->X, int2bin[(cpu->X >> 4) & 0xF], int2bin[cpu->X & 0xF]);
-    printf("Y:  0x%.2X (%s.%s) \n", cpu->Y, int2bin[(cpu->Y >> 4) & 0xF], int2bin[cpu->Y & 0xF]);    
-    printf("A:  0x%.2X (%s.%s) \n", cpu->A, int2bin[(cpu->A >> 4) & 0xF], int2bin[cpu->A & 0xF]);
-    printf("P:  0x%.2X N=%d,V=%d,B=%d,D=%d,I=%d,Z=%d,C=%d\n",  cpu->P, ((cpu->P >> 7) & 0x1), ((cpu->P >> 6) & 0x1), 
+    logMessage("*** Register contents *** \n");
+    logMessage("X:  0x%.2X (%s.%s) \n", cpu->X, int2bin[(cpu->X >> 4) & 0xF], int2bin[cpu->X & 0xF]);
+    logMessage("Y:  0x%.2X (%s.%s) \n", cpu->Y, int2bin[(cpu->Y >> 4) & 0xF], int2bin[cpu->Y & 0xF]);    
+    logMessage("A:  0x%.2X (%s.%s) \n", cpu->A, int2bin[(cpu->A >> 4) & 0xF], int2bin[cpu->A & 0xF]);
+    logMessage("P:  0x%.2X N=%d,V=%d,B=%d,D=%d,I=%d,Z=%d,C=%d\n",  cpu->P, ((cpu->P >> 7) & 0x1), ((cpu->P >> 6) & 0x1), 
                 ((cpu->P >> 4) & 0x1), ((cpu->P >> 3) & 0x1), ((cpu->P >> 2) & 0x1), ((cpu->P >> 1) & 0x1), ((cpu->P) & 0x1)); 
-    printf("IR: 0x%.2X (%s.%s) \n", cpu->IR, int2bin[(cpu->IR >> 4) & 0xF], int2bin[cpu->IR & 0xF]);
-    printf("SP: 0x%.2X (%s.%s) \n", cpu->SP, int2bin[(cpu->SP >> 4) & 0xF], int2bin[cpu->SP & 0xF]);
-    printf("PC: 0x%.4X \n", cpu->PC);    
-    printf("************************* \n");
+    logMessage("IR: 0x%.2X (%s.%s) \n", cpu->IR, int2bin[(cpu->IR >> 4) & 0xF], int2bin[cpu->IR & 0xF]);
+    logMessage("SP: 0x%.2X (%s.%s) \n", cpu->SP & 0xFF, int2bin[(cpu->SP >> 4) & 0xF], int2bin[cpu->SP & 0xF]);
+    logMessage("PC: 0x%.4X \n", cpu->PC);    
+    logMessage("************************* \n");
 }
 
-void printExecInfo(word opcode)
+void printExecInfo(T6502 cpu, word opcode)
 {
-    printf("Executing opcode 0x%.2X... \n", opcode);
+    if (!logEnabled()) return;     //no disassembly per instruction for nothing
+
+    char text[DISASM_TEXT_MAX];
+    disasmMemory(cpu->mem, cpu->PC, text);
+    logMessage("Executing opcode 0x%.2X at 0x%.4X: %s \n", opcode, cpu->PC, text);
 }
 
 #ifdef DELME
@@ -87,7 +129,7 @@ word getBit(word w, uint32_t bit_number)
 {
     if (bit_number > 7)
     {
-        printf("ERROR: can't get bit %u", bit_number);
+        logMessage("ERROR: can't get bit %u", bit_number);
         return 0xFF; //invalid
     }
 
@@ -99,7 +141,7 @@ void setBit(word* w, uint32_t bit_number)
 {
     if (bit_number > 7)
     {
-        printf("ERROR: can't set bit %u", bit_number);
+        logMessage("ERROR: can't set bit %u", bit_number);
         return;
     }
     
@@ -111,7 +153,7 @@ void clearBit(word* w, uint32_t bit_number)
 {
     if (bit_number > 7)
     {
-        printf("ERROR: can't clear bit %u", bit_number);
+        logMessage("ERROR: can't clear bit %u", bit_number);
         return;
     }
     
@@ -4,9 +4,25 @@
 #include "types.h"
 #include "6502.h"
 
+//messages of the library (warnings, errors): handler gets the formatted text, by default it goes to stderr
+typedef void (*TLogFn)(void* ctx, const char* message);
+
+//set message handler, NULL drops all messages (embedding, see machine.h)
+void logSetHandler(TLogFn fn, void* ctx);
+
+//handlers writing the text to stdout (the emulator's CLI) or stderr (the default)
+void logToStdout(void* ctx, const char* message);
+void logToStderr(void* ctx, const char* message);
+
+//format and hand a message to the handler
+void logMessage(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+//1 if messages go anywhere, to skip building expensive ones
+int logEnabled(void);
+
 void printRegs(T6502 cpu);
 
-void printExecInfo(word opcode);
+void printExecInfo(T6502 cpu, word opcode);
 
 address lohi2addr(word lo, word hi);
 
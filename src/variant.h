@@ -0,0 +1,21 @@
+#ifndef VARIANT_H
+#define VARIANT_H
+
+//CPU variant, chosen at build time (make VARIANT=2a03|nmos|65c02), every variant gets its own dispatch and ALU:
+//- 2A03 (default): the NES CPU, the D flag can be set but ADC/SBC are always binary
+//- NMOS (-DCPU_NMOS): original 6502 with decimal mode, N V Z of decimal results as the NMOS parts compute them
+//- 65C02 (-DCPU_65C02): CMOS 6502 with decimal mode (valid N Z, one extra cycle), the new opcodes and the
+//  (zp) addressing mode, JMP ($xxFF) fixed, D cleared on interrupts
+#if defined(CPU_65C02)
+    #define CPU_VARIANT "65C02"
+    #define CPU_HAS_BCD
+    #define CPU_CMOS
+#elif defined(CPU_NMOS)
+    #define CPU_VARIANT "6502"
+    #define CPU_HAS_BCD
+#else
+    #define CPU_2A03
+    #define CPU_VARIANT "2A03"
+#endif
+
+#endif
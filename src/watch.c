@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <string.h>
+#include "watch.h"
+
+
+static word watchRead(void* dev, address a)
+{
+    TWatch w = (TWatch)dev;
+    if (w->reads[a]) cpuStop(w->cpu, CPU_STOP_WATCH_READ, a);
+    return memIoPassRead(w->cpu->mem, &w->io[a >> 8], a);
+}
+
+static void watchWrite(void* dev, word v, address a)
+{
+    TWatch w = (TWatch)dev;
+    if (w->writes[a]) cpuStop(w->cpu, CPU_STOP_WATCH_WRITE, a);
+    memIoPassWrite(w->cpu->mem, &w->io[a >> 8], v, a);
+}
+
+static word watchPeek(void* dev, address a)
+{
+    TWatch w = (TWatch)dev;
+    return memIoPassPeek(w->cpu->mem, &w->io[a >> 8], a);
+}
+
+TWatch watchInit(T6502 cpu)
+{
+    TWatch w = (TWatch)malloc(sizeof(WatchStruct));
+    memset(w, 0, sizeof(WatchStruct));
+    w->cpu = cpu;
+
+    for (dword page = 0; page < PAGECOUNT; page++)
+    {
+        w->io[page].dev = w;
+        w->io[page].read = watchRead;
+        w->io[page].write = watchWrite;
+        w->io[page].peek = watchPeek;
+    }
+    return w;
+}
+
+void watchClose(TWatch w)
+{
+    for (dword page = 0; page < PAGECOUNT; page++)
+        if (w->watched[page] > 0) memUnmapIo(w->cpu->mem, &w->io[page]);
+    free(w);
+}
+
+//count changed by delta for address a, maps or unmaps the page handler as needed; returns -1 (count
+//unchanged) if the handler could not be mapped
+static int account(TWatch w, address a, int delta)
+{
+    word page = a >> 8;
+
+    if (delta > 0 && w->watched[page]++ == 0 && memMapIo(w->cpu->mem, page, page, &w->io[page]) != 0)
+    {
+        w->watched[page]--;
+        return -1;
+    }
+    if (delta < 0 && --w->watched[page] == 0) memUnmapIo(w->cpu->mem, &w->io[page]);
+    return 0;
+}
+
+int watchAdd(TWatch w, address first, address last, word kind)
+{
+    address a = first;
+    do
+    {
+        if (((kind & WATCH_READ) && w->reads[a] == 255) || ((kind & WATCH_WRITE) && w->writes[a] == 255))
+        {
+            //undo what is done so far
+            if (a != first) watchRemove(w, first, a - 1, kind);
+            return -1;
+        }
+        int failed = 0;
+        if (kind & WATCH_READ)
+        {
+            w->reads[a]++;
+            if (account(w, a, 1) != 0)
+            {
+                w->reads[a]--;
+                failed = 1;
+            }
+        }
+        if ((kind & WATCH_WRITE) && !failed)
+        {
+            w->writes[a]++;
+            if (account(w, a, 1) != 0)
+            {
+                w->writes[a]--;
+                if (kind & WATCH_READ) watchRemove(w, a, a, WATCH_READ);
+                failed = 1;
+            }
+        }
+        if (failed)
+        {
+            //the page has too many devices, undo what is done so far
+            if (a != first) watchRemove(w, first, a - 1, kind);
+            return -1;
+        }
+    } while (a++ != last);
+    return 0;
+}
+
+void watchRemove(TWatch w, address first, address last, word kind)
+{
+    address a = first;
+    do
+    {
+        if ((kind & WATCH_READ) && w->reads[a] > 0)
+        {
+            w->reads[a]--;
+            account(w, a, -1);
+        }
+        if ((kind & WATCH_WRITE) && w->writes[a] > 0)
+        {
+            w->writes[a]--;
+            account(w, a, -1);
+        }
+    } while (a++ != last);
+}
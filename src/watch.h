@@ -0,0 +1,41 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "types.h"
+#include "6502.h"
+
+//Watchpoint engine: any number of read and/or write watchpoints on address ranges, overlapping is fine.
+//Only pages holding a watched address get a handler on the memory bus, it counts per address how many
+//watchpoints want to see a read or a write and reports hits with cpuStop (CPU_STOP_WATCH_READ/WRITE, the
+//CPU's break handler decides whether the run stops). All other pages stay on the direct RAM path of
+//memRead/memWrite. Instruction fetches count as reads. Devices mapped after a watchpoint hide it on their
+//pages, so set watchpoints after the devices are set up.
+
+#define WATCH_READ  0x01
+#define WATCH_WRITE 0x02
+
+typedef struct
+{
+    T6502      cpu;
+    word       reads[MEMSIZE];      //read watchpoints per address
+    word       writes[MEMSIZE];     //write watchpoints per address
+    uint32_t   watched[PAGECOUNT];  //sum of both counters over the page, its handler is mapped while > 0
+    TIoHandler io[PAGECOUNT];
+} WatchStruct;
+
+typedef WatchStruct* TWatch;
+
+//create watchpoint engine for cpu
+TWatch watchInit(T6502 cpu);
+
+//remove all watchpoints and free engine
+void watchClose(TWatch w);
+
+//watch addresses first..last (inclusive, may wrap) for kind (WATCH_READ | WATCH_WRITE), returns 0 on success,
+//-1 if an address already has 255 watchpoints of that kind or a page cannot take another device (memMapIo)
+int watchAdd(TWatch w, address first, address last, word kind);
+
+//remove a watchpoint added with the same arguments
+void watchRemove(TWatch w, address first, address last, word kind);
+
+#endif
@@ -0,0 +1,191 @@
+/*****************************************************************
+*** Exhaustive check of ADC/SBC in decimal mode against a     ***
+*** reference model, for every A, operand and carry.          ***
+*** Also checks that cpuStep dispatches exactly the opcodes   ***
+*** listed in opcodeTable.                                    ***
+*****************************************************************/
+
+//The reference is the bit-exact NMOS model of VICE (N and V from the intermediate result, Z from the binary
+//sum, SBC flags all binary). The 65C02 is only defined for valid BCD operands: there N and Z come from the
+//decimal result and the instruction takes one extra cycle. The 2A03 has no decimal mode, ADC/SBC with D
+//set must give the binary results.
+//Every combination of instruction and carry runs on its own thread with its own CPU, all created at
+//the same time, so the one-time setup of the decimal tables is exercised from several threads as well.
+//The cpuStep switch is written by hand while cycles, lengths and mnemonics come from the X macro list in
+//opcodes.h: every opcode is stepped once, it has to run if and only if opcodeTable lists it.
+//Exit code is the number of mismatches, capped at 255.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "../src/6502.h"
+#include "../src/mem.h"
+#include "../src/opcodes.h"
+#include "../src/utils.h"
+
+
+#define CODE_START       0x0200
+#define MAX_REPORTED     5      //mismatches printed per thread
+
+
+typedef struct
+{
+    int      sbc;               //0: ADC, 1: SBC
+    int      carry;
+    uint32_t checked;
+    uint32_t failed;
+} TBcdRun;
+
+
+//############################# REFERENCE #############################
+
+//result in the lo byte, N V Z C at their positions in P in the hi byte
+static uint32_t refAdc(int a, int b, int c)
+{
+#ifdef CPU_HAS_BCD
+    uint32_t t = (a & 0x0F) + (b & 0x0F) + c;
+    if (t > 0x09) t += 0x06;
+    if (t <= 0x0F) t = (t & 0x0F) + (a & 0xF0) + (b & 0xF0);
+    else t = (t & 0x0F) + (a & 0xF0) + (b & 0xF0) + 0x10;
+    int z = ((a + b + c) & 0xFF) == 0;
+    int n = (t & 0x80) != 0;
+    int v = ((a ^ t) & 0x80) && !((a ^ b) & 0x80);
+    if ((t & 0x1F0) > 0x90) t += 0x60;
+    int carry = (t & 0xFF0) > 0xF0;
+#else
+    uint32_t t = a + b + c;
+    int z = (t & 0xFF) == 0;
+    int n = (t & 0x80) != 0;
+    int v = ((a ^ t) & 0x80) && !((a ^ b) & 0x80);
+    int carry = t > 0xFF;
+#endif
+    return (t & 0xFF) | ((n << 7) | (v << 6) | (z << 1) | carry) << 8;
+}
+
+static uint32_t refSbc(int a, int b, int c)
+{
+    uint32_t bin = a - b - (c ? 0 : 1);
+    int carry = bin < 0x100;
+    int n = (bin & 0x80) != 0;
+    int z = (bin & 0xFF) == 0;
+    int v = ((a ^ bin) & 0x80) && ((a ^ b) & 0x80);
+#ifdef CPU_HAS_BCD
+    uint32_t t = (a & 0x0F) - (b & 0x0F) - (c ? 0 : 1);
+    if (t & 0x10) t = ((t - 0x06) & 0x0F) | ((a & 0xF0) - (b & 0xF0) - 0x10);
+    else t = (t & 0x0F) | ((a & 0xF0) - (b & 0xF0));
+    if (t & 0x100) t -= 0x60;
+#else
+    uint32_t t = bin;
+#endif
+    return (t & 0xFF) | ((n << 7) | (v << 6) | (z << 1) | carry) << 8;
+}
+
+
+//############################# DISPATCH #############################
+
+//opcodes on which cpuStep and opcodeTable disagree
+static uint32_t checkDispatch(void)
+{
+    T6502 cpu = cpuInit(memInit());
+    uint32_t failed = 0;
+
+    for (dword op = 0; op < 256; op++)
+    {
+        memWrite(cpu->mem, op, CODE_START);
+        cpu->PC = CODE_START;
+        int dispatched = (cpuStep(cpu) != CPU_STEP_ERROR);
+        int listed = (opcodeTable[op].mnemonic != NULL);
+        if (dispatched != listed)
+        {
+            printf("opcode $%.2X: %s opcodeTable, %s by cpuStep \n", op, listed ? "in" : "not in", dispatched ? "run" : "not run");
+            failed++;
+        }
+    }
+
+    free(cpu->mem);
+    free(cpu);
+    return failed;
+}
+
+
+//############################# RUN #############################
+
+static void* check(void* arg)
+{
+    TBcdRun* run = (TBcdRun*)arg;
+    T6502 cpu = cpuInit(memInit());
+    word opcode = run->sbc ? SBC_IMMD : ADC_IMMD;
+
+    for (int a = 0; a < 256; a++)
+    for (int b = 0; b < 256; b++)
+    {
+#ifdef CPU_CMOS
+        //undefined for invalid BCD digits
+        if ((a & 0x0F) > 9 || a >= 0xA0 || (b & 0x0F) > 9 || b >= 0xA0) continue;
+#endif
+        memWrite(cpu->mem, opcode, CODE_START);
+        memWrite(cpu->mem, b, CODE_START + 1);
+        cpu->PC = CODE_START;
+        cpu->A = a;
+        cpu->P = 0x38 | run->carry;     //D and I set
+        uint64_t start = cpu->cycles;
+        cpuStep(cpu);
+
+        uint32_t ref = run->sbc ? refSbc(a, b, run->carry) : refAdc(a, b, run->carry);
+        word result = ref & 0xFF;
+        word flags = ref >> 8;
+        uint32_t cycles = 2;
+#ifdef CPU_CMOS
+        flags = (flags & 0x41) | (result & 0x80) | (result == 0 ? 0x02 : 0);
+        cycles = 3;
+#endif
+
+        run->checked++;
+        if (cpu->A != result || (cpu->P & 0xC3) != flags || cpu->cycles - start != cycles)
+        {
+            if (run->failed < MAX_REPORTED)
+            {
+                printf("%s C=%d A=%.2X M=%.2X: got A=%.2X P=%.2X in %llu cycles, expected A=%.2X P=%.2X in %u \n",
+                       run->sbc ? "SBC" : "ADC", run->carry, a, b, cpu->A, cpu->P & 0xC3,
+                       (unsigned long long)(cpu->cycles - start), result, flags, cycles);
+            }
+            run->failed++;
+        }
+    }
+
+    free(cpu->mem);
+    free(cpu);
+    return NULL;
+}
+
+int main(void)
+{
+    logSetHandler(NULL, NULL);
+
+    TBcdRun runs[4];
+    pthread_t tid[4];
+    for (int i = 0; i < 4; i++)
+    {
+        runs[i].sbc = i >> 1;
+        runs[i].carry = i & 1;
+        runs[i].checked = 0;
+        runs[i].failed = 0;
+        pthread_create(&tid[i], NULL, check, &runs[i]);
+    }
+
+    uint32_t checked = 0;
+    uint32_t failed = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        pthread_join(tid[i], NULL);
+        checked += runs[i].checked;
+        failed += runs[i].failed;
+    }
+
+    printf("%s: %u ADC/SBC cases in decimal mode, %u failed \n", CPU_VARIANT, checked, failed);
+
+    uint32_t dispatch = checkDispatch();
+    printf("%s: %u opcodes where cpuStep and opcodeTable disagree \n", CPU_VARIANT, dispatch);
+    failed += dispatch;
+    return failed > 255 ? 255 : failed;
+}
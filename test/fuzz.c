@@ -0,0 +1,182 @@
+/*****************************************************************
+*** Coverage-guided fuzzing harness for the CPU core.         ***
+*****************************************************************/
+
+//The input bytes are loaded as 6502 binary at address 0 and run for a fixed number of cycles.
+//Coverage (PC edges and opcodes) is collected in covMap, see coverage.h.
+//
+//Three ways to drive it:
+//- libFuzzer: build with clang -fsanitize=fuzzer -DFUZZ_LIBFUZZER, covMap is registered as extra counters
+//- AFL: if __AFL_SHM_ID is set, covMap is the shared AFL map; inputs are read from file or stdin. Started by
+//  afl-fuzz, the harness runs AFL's fork server: CPU and RAM are set up once, and every input runs in a
+//  child forked from there instead of a new process. Compiling with afl-cc is not needed, the coverage
+//  comes from the run loop, so afl-fuzz is best run with AFL_SKIP_BIN_CHECK=1.
+//- standalone: ./fuzz <input> ... runs all inputs and reports coverage and executions per second
+//
+//CPU and RAM are allocated once. Between two inputs only the pages the previous run has written are cleared.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+#include "../src/6502.h"
+#include "../src/mem.h"
+#include "../src/loader.h"
+#include "../src/coverage.h"
+#include "../src/utils.h"
+
+
+#define FUZZ_BUDGET 30000   //max cycles per input
+#define MAX_INPUT   MEMSIZE //inputs beyond 64K would not fit into RAM anyway
+#define FORKSRV_FD  198     //AFL's control pipe, status pipe is FORKSRV_FD + 1
+
+
+//pooled instance, reused for every input
+static T6502 cpu = NULL;
+
+#ifdef FUZZ_LIBFUZZER
+//libFuzzer picks up 8bit counters from this section and treats them as additional coverage
+__attribute__((section("__libfuzzer_extra_counters"))) static word extraCounters[COV_MAP_SIZE];
+#endif
+
+
+static void fuzzInit(void)
+{
+    if (cpu != NULL) return;
+    logSetHandler(NULL, NULL);  //random programs hit unknown opcodes and wrap the stack all the time
+    cpu = cpuInit(memInit());
+#ifdef FUZZ_LIBFUZZER
+    covMap = extraCounters;
+#endif
+}
+
+//run one input and return 0, the result is in covMap
+int fuzzOne(const uint8_t* data, size_t size)
+{
+    fuzzInit();
+
+    //reset instance: only dirty pages are cleared, registers get their power-up values
+    memReset(cpu->mem);
+    cpuReset(cpu);
+    covReset();
+
+    if (size > MAX_INPUT) size = MAX_INPUT;
+    if (loadProgram(cpu->mem, data, size) != 0) return 0;
+
+    cpuRun(cpu, FUZZ_BUDGET);
+
+    return 0;
+}
+
+#ifdef FUZZ_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    return fuzzOne(data, size);
+}
+
+#else
+
+//read whole file (or stdin if f is stdin) into buf, returns number of bytes read
+static size_t readInput(FILE* f, uint8_t* buf)
+{
+    size_t n = 0;
+    size_t r;
+    while (n < MAX_INPUT && (r = fread(buf + n, 1, MAX_INPUT - n, f)) > 0) n += r;
+    return n;
+}
+
+//attach to AFL's shared coverage map if we run under afl-fuzz
+static void attachAflMap(void)
+{
+    const char* id = getenv("__AFL_SHM_ID");
+    if (id == NULL) return;
+
+    void* map = shmat(atoi(id), NULL, 0);
+    if (map != (void*)-1) covMap = (word*)map;
+}
+
+//AFL fork server: tell afl-fuzz we are up, then fork a child per input it asks for and report the child's
+//pid and exit status; returns in the child, or right away if afl-fuzz did not start us
+static void runForkServer(void)
+{
+    uint32_t msg = 0;
+    if (write(FORKSRV_FD + 1, &msg, 4) != 4) return;
+
+    while (1)
+    {
+        if (read(FORKSRV_FD, &msg, 4) != 4) exit(0);    //afl-fuzz is gone
+
+        pid_t pid = fork();
+        if (pid < 0) exit(1);
+        if (pid == 0)
+        {
+            close(FORKSRV_FD);
+            close(FORKSRV_FD + 1);
+            return;
+        }
+
+        int status;
+        if (write(FORKSRV_FD + 1, &pid, 4) != 4) exit(1);
+        if (waitpid(pid, &status, 0) < 0) exit(1);
+        if (write(FORKSRV_FD + 1, &status, 4) != 4) exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static uint8_t buf[MAX_INPUT];
+
+    attachAflMap();
+
+    //the core reports unknown instructions on stdout, which is just noise here
+    if (freopen("/dev/null", "w", stdout) == NULL) return -1;
+
+    //no file given: single input from stdin (AFL default)
+    if (argc < 2)
+    {
+        fuzzInit();
+        if (getenv("__AFL_SHM_ID") != NULL) runForkServer();
+        size_t n = readInput(stdin, buf);
+        return fuzzOne(buf, n);
+    }
+
+    //standalone: run all given inputs, accumulate coverage over all of them
+    static word total[COV_MAP_SIZE];
+    struct timespec t0, t1;
+    double secs = 0;
+    int runs = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        FILE* f = fopen(argv[i], "rb");
+        if (f == NULL)
+        {
+            fprintf(stderr, "IO error: could not open file %s \n", argv[i]);
+            continue;
+        }
+        size_t n = readInput(f, buf);
+        fclose(f);
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        fuzzOne(buf, n);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        secs += (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+        runs++;
+
+        for (uint32_t j = 0; j < COV_MAP_SIZE; j++) total[j] |= covMap[j];
+    }
+
+    memcpy(covMap, total, COV_MAP_SIZE);
+    uint32_t edges, opcodes;
+    covCount(&edges, &opcodes);
+
+    fprintf(stderr, "runs: %d, edges: %u, opcodes: %u, execs/s: %.0f\n", runs, edges, opcodes, (secs > 0) ? runs / secs : 0.0);
+
+    return 0;
+}
+
+#endif
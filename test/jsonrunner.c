@@ -0,0 +1,425 @@
+/*****************************************************************
+*** Run single-instruction JSON test-vector corpora           ***
+*** (one file per opcode, e.g. 65x02/nes6502/v1/a9.json).     ***
+*****************************************************************/
+
+//Every file is a JSON array of test cases:
+//{ "name": "...",
+//  "initial": { "pc": n, "s": n, "a": n, "x": n, "y": n, "p": n, "ram": [ [addr, val], ... ] },
+//  "final":   { same as initial },
+//  "cycles":  [ [addr, val, "read"|"write"], ... ] }
+//
+//A case passes if registers and the listed RAM match the final state and the instruction took as many
+//cycles as there are bus accesses in "cycles".
+//
+//Files are mmapped and parsed in place, case by case, without building a DOM.
+//Each worker thread owns one CPU and one RAM which are reused for all cases of all files it picks up.
+//Between two cases only the addresses listed in the previous case are cleared again.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../src/6502.h"
+#include "../src/mem.h"
+#include "../src/utils.h"
+
+
+#define MAX_RAM_ENTRIES 64      //a single instruction never touches more than a handful of addresses
+#define MAX_THREADS 64
+#define MAX_REPORTED_FAILS 3    //number of failed cases printed per file
+
+
+typedef struct
+{
+    uint32_t pc;
+    uint32_t s;
+    uint32_t a;
+    uint32_t x;
+    uint32_t y;
+    uint32_t p;
+    uint32_t ram_count;
+    address  ram_addr[MAX_RAM_ENTRIES];
+    word     ram_val[MAX_RAM_ENTRIES];
+} TState;
+
+//cursor into the mmapped file
+typedef struct
+{
+    const char* pos;
+    const char* end;
+    int error;
+} TParser;
+
+typedef struct
+{
+    char name[128];
+    TState initial;
+    TState final;
+    uint32_t cycles;            //entries in "cycles", one bus access per cycle
+} TCase;
+
+//work shared by all threads
+static char** files;
+static int file_count;
+static int next_file = 0;
+static int verbose = 0;
+static unsigned long total_passed = 0;
+static unsigned long total_failed = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+// ################################ minimal pull parser ################################
+
+static void skipWs(TParser* jp)
+{
+    while (jp->pos < jp->end && (*jp->pos == ' ' || *jp->pos == '\n' || *jp->pos == '\r' || *jp->pos == '\t' || *jp->pos == ','))
+        jp->pos++;
+}
+
+//consume character c (after whitespace), flag an error if it is not there
+static int expect(TParser* jp, char c)
+{
+    skipWs(jp);
+    if (jp->pos >= jp->end || *jp->pos != c)
+    {
+        jp->error = 1;
+        return 0;
+    }
+    jp->pos++;
+    return 1;
+}
+
+//peek at next significant character without consuming it
+static char peek(TParser* jp)
+{
+    skipWs(jp);
+    return (jp->pos < jp->end) ? *jp->pos : 0;
+}
+
+static uint32_t parseUInt(TParser* jp)
+{
+    uint32_t n = 0;
+    skipWs(jp);
+    if (jp->pos >= jp->end || *jp->pos < '0' || *jp->pos > '9')
+    {
+        jp->error = 1;
+        return 0;
+    }
+    while (jp->pos < jp->end && *jp->pos >= '0' && *jp->pos <= '9')
+    {
+        n = n * 10 + (*jp->pos - '0');
+        jp->pos++;
+    }
+    return n;
+}
+
+//parse string into buf (truncated to size), escapes are kept as they are
+static void parseString(TParser* jp, char* buf, size_t size)
+{
+    size_t n = 0;
+    if (!expect(jp, '"')) return;
+    while (jp->pos < jp->end && *jp->pos != '"')
+    {
+        if (*jp->pos == '\\' && jp->pos + 1 < jp->end) jp->pos++;
+        if (n + 1 < size) buf[n++] = *jp->pos;
+        jp->pos++;
+    }
+    if (size > 0) buf[n] = 0;
+    expect(jp, '"');
+}
+
+//skip any JSON value (used for unknown keys)
+static void skipValue(TParser* jp)
+{
+    char c = peek(jp);
+    if (c == '"')
+    {
+        char dummy[1];
+        parseString(jp, dummy, sizeof(dummy));
+    }
+    else if (c == '[' || c == '{')
+    {
+        int depth = 0;
+        do
+        {
+            if (*jp->pos == '"')
+            {
+                char dummy[1];
+                parseString(jp, dummy, sizeof(dummy));
+                continue;
+            }
+            if (*jp->pos == '[' || *jp->pos == '{') depth++;
+            if (*jp->pos == ']' || *jp->pos == '}') depth--;
+            jp->pos++;
+        } while (depth > 0 && jp->pos < jp->end);
+    }
+    else
+    {
+        while (jp->pos < jp->end && *jp->pos != ',' && *jp->pos != '}' && *jp->pos != ']') jp->pos++;
+    }
+}
+
+static void parseState(TParser* jp, TState* st)
+{
+    char key[16];
+
+    memset(st, 0, sizeof(TState));
+    expect(jp, '{');
+    while (!jp->error && peek(jp) != '}')
+    {
+        parseString(jp, key, sizeof(key));
+        expect(jp, ':');
+
+        if      (strcmp(key, "pc") == 0) st->pc = parseUInt(jp);
+        else if (strcmp(key, "s") == 0)  st->s = parseUInt(jp);
+        else if (strcmp(key, "a") == 0)  st->a = parseUInt(jp);
+        else if (strcmp(key, "x") == 0)  st->x = parseUInt(jp);
+        else if (strcmp(key, "y") == 0)  st->y = parseUInt(jp);
+        else if (strcmp(key, "p") == 0)  st->p = parseUInt(jp);
+        else if (strcmp(key, "ram") == 0)
+        {
+            expect(jp, '[');
+            while (!jp->error && peek(jp) != ']')
+            {
+                expect(jp, '[');
+                uint32_t a = parseUInt(jp);
+                uint32_t v = parseUInt(jp);
+                expect(jp, ']');
+
+                if (st->ram_count < MAX_RAM_ENTRIES)
+                {
+                    st->ram_addr[st->ram_count] = (address)a;
+                    st->ram_val[st->ram_count] = (word)v;
+                    st->ram_count++;
+                }
+            }
+            expect(jp, ']');
+        }
+        else skipValue(jp);
+    }
+    expect(jp, '}');
+}
+
+//count the elements of an array, skipping their values
+static uint32_t parseArrayLength(TParser* jp)
+{
+    uint32_t n = 0;
+    expect(jp, '[');
+    while (!jp->error && peek(jp) != ']' && jp->pos < jp->end)
+    {
+        skipValue(jp);
+        n++;
+    }
+    expect(jp, ']');
+    return n;
+}
+
+//parse next test case, returns 0 at end of array or on error
+static int parseCase(TParser* jp, TCase* tc)
+{
+    char key[16];
+
+    if (peek(jp) != '{') return 0;
+
+    tc->name[0] = 0;
+    tc->cycles = 0;
+    expect(jp, '{');
+    while (!jp->error && peek(jp) != '}')
+    {
+        parseString(jp, key, sizeof(key));
+        expect(jp, ':');
+
+        if      (strcmp(key, "name") == 0)    parseString(jp, tc->name, sizeof(tc->name));
+        else if (strcmp(key, "initial") == 0) parseState(jp, &tc->initial);
+        else if (strcmp(key, "final") == 0)   parseState(jp, &tc->final);
+        else if (strcmp(key, "cycles") == 0)  tc->cycles = parseArrayLength(jp);
+        else skipValue(jp);
+    }
+    expect(jp, '}');
+
+    return !jp->error;
+}
+
+
+// ################################ test execution ################################
+
+//clear all addresses the given state has touched
+static void clearState(TMemory mem, const TState* st)
+{
+    for (uint32_t i = 0; i < st->ram_count; i++) memWrite(mem, 0, st->ram_addr[i]);
+}
+
+static void applyState(T6502 cpu, const TState* st)
+{
+    for (uint32_t i = 0; i < st->ram_count; i++) memWrite(cpu->mem, st->ram_val[i], st->ram_addr[i]);
+
+    cpu->PC = st->pc;
+    cpu->SP = 0x0100 | st->s;   //stack is hard wired to page 1
+    cpu->A = st->a;
+    cpu->X = st->x;
+    cpu->Y = st->y;
+    cpu->P = st->p;
+}
+
+//returns 1 if CPU and RAM match the expected state, otherwise describes the first mismatch in msg
+static int checkState(T6502 cpu, const TState* st, char* msg, size_t size)
+{
+    if (cpu->PC != st->pc)             { snprintf(msg, size, "PC 0x%.4X, expected 0x%.4X", cpu->PC, st->pc); return 0; }
+    if ((cpu->SP & 0xFF) != st->s)     { snprintf(msg, size, "SP 0x%.2X, expected 0x%.2X", cpu->SP & 0xFF, st->s); return 0; }
+    if (cpu->A != st->a)               { snprintf(msg, size, "A 0x%.2X, expected 0x%.2X", cpu->A, st->a); return 0; }
+    if (cpu->X != st->x)               { snprintf(msg, size, "X 0x%.2X, expected 0x%.2X", cpu->X, st->x); return 0; }
+    if (cpu->Y != st->y)               { snprintf(msg, size, "Y 0x%.2X, expected 0x%.2X", cpu->Y, st->y); return 0; }
+    if (cpu->P != st->p)               { snprintf(msg, size, "P 0x%.2X, expected 0x%.2X", cpu->P, st->p); return 0; }
+
+    for (uint32_t i = 0; i < st->ram_count; i++)
+    {
+        word w = memRead(cpu->mem, st->ram_addr[i]);
+        if (w != st->ram_val[i])
+        {
+            snprintf(msg, size, "mem[0x%.4X] 0x%.2X, expected 0x%.2X", st->ram_addr[i], w, st->ram_val[i]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//run all cases of one file, reusing the given CPU
+static void runFile(T6502 cpu, const char* file)
+{
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("IO error: could not open file %s \n", file);
+        return;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size == 0)
+    {
+        printf("IO error: could not stat file %s \n", file);
+        close(fd);
+        return;
+    }
+
+    const char* data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        printf("IO error: could not map file %s \n", file);
+        return;
+    }
+    madvise((void*)data, sb.st_size, MADV_SEQUENTIAL);
+
+    TParser jp = { data, data + sb.st_size, 0 };
+    TCase tc;
+    TState previous = { 0 };
+    unsigned long passed = 0;
+    unsigned long failed = 0;
+    char msg[128];
+
+    expect(&jp, '[');
+    while (parseCase(&jp, &tc))
+    {
+        //undo the previous case by touching only the addresses it listed
+        clearState(cpu->mem, &previous);
+
+        applyState(cpu, &tc.initial);
+        uint64_t start = cpu->cycles;
+        eCpuStepStatus status = cpuStep(cpu);
+        uint64_t cycles = cpu->cycles - start;
+
+        if (status == CPU_STEP_OK && checkState(cpu, &tc.final, msg, sizeof(msg)) && cycles == tc.cycles)
+        {
+            passed++;
+        }
+        else
+        {
+            if (status != CPU_STEP_OK) snprintf(msg, sizeof(msg), "CPU step error");
+            else if (cycles != tc.cycles && checkState(cpu, &tc.final, msg, sizeof(msg)))
+                snprintf(msg, sizeof(msg), "%llu cycles, expected %u", (unsigned long long)cycles, tc.cycles);
+            if (verbose || failed < MAX_REPORTED_FAILS) printf("%s: FAILED \"%s\": %s\n", file, tc.name, msg);
+            failed++;
+        }
+
+        //the final state lists every address the instruction touched, initial ones included
+        clearState(cpu->mem, &tc.initial);
+        previous = tc.final;
+    }
+    clearState(cpu->mem, &previous);
+
+    if (jp.error) printf("%s: parse error at offset %ld\n", file, (long)(jp.pos - data));
+    printf("%s: %lu/%lu passed\n", file, passed, passed + failed);
+
+    munmap((void*)data, sb.st_size);
+
+    pthread_mutex_lock(&lock);
+    total_passed += passed;
+    total_failed += failed;
+    pthread_mutex_unlock(&lock);
+}
+
+//worker: pick next file until all are done
+static void* worker(void* arg)
+{
+    T6502 cpu = cpuInit(memInit());
+
+    while (1)
+    {
+        int i = __atomic_fetch_add(&next_file, 1, __ATOMIC_RELAXED);
+        if (i >= file_count) break;
+        runFile(cpu, files[i]);
+    }
+
+    free(cpu->mem);
+    free(cpu);
+    return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j': threads = atoi(optarg); break;
+            case 'v': verbose = 1; break;
+            default:
+                printf("Usage: %s [-j threads] [-v] <test.json> ...\n", argv[0]);
+                return -1;
+        }
+    }
+
+    //exit if no test file was given
+    if (optind >= argc)
+    {
+        printf("Input error: at least one JSON test file expected \n");
+        return -1;
+    }
+
+    //the vectors wrap the stack on purpose, the library's warnings about it would bury the results
+    logSetHandler(NULL, NULL);
+
+    files = &argv[optind];
+    file_count = argc - optind;
+
+    if (threads < 1) threads = 1;
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if (threads > file_count) threads = file_count;
+
+    pthread_t tid[MAX_THREADS];
+    for (int i = 0; i < threads; i++) pthread_create(&tid[i], NULL, worker, NULL);
+    for (int i = 0; i < threads; i++) pthread_join(tid[i], NULL);
+
+    printf("\nTotal: %lu/%lu passed\n", total_passed, total_passed + total_failed);
+
+    return (total_failed == 0) ? 0 : 1;
+}
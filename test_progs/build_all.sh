@@ -1,6 +1,2 @@
-for d in */ ; do
-    echo "building $d..."
-    cd $d
-    xa *
-    cd ..
-done
+#assembles every test program into a.o65 next to its source, all in one process (needs "make asm")
+../build/asm */*.asm
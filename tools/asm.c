@@ -0,0 +1,111 @@
+/*****************************************************************
+*** Assemble 6502 sources with the built-in assembler.        ***
+*****************************************************************/
+
+//Drop-in for the xa calls of the test program scripts: every source is assembled in this one process and
+//written as raw binary (first to last byte written) to a.o65 next to it, or to the file given with -O.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/asm.h"
+
+
+static char* readSource(const char* file)
+{
+    FILE* f = fopen(file, "rb");
+    if (f == NULL) return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char* source = malloc(size + 1);
+    if (source != NULL)
+    {
+        size_t n = fread(source, 1, size, f);
+        source[n] = '\0';
+    }
+    fclose(f);
+    return source;
+}
+
+//a.o65 in the directory of file
+static void defaultOutput(const char* file, char* out, size_t size)
+{
+    const char* slash = strrchr(file, '/');
+    if (slash == NULL) snprintf(out, size, "a.o65");
+    else snprintf(out, size, "%.*s/a.o65", (int)(slash - file), file);
+}
+
+static int writeBinary(TAsm as, TMemory mem, const char* file)
+{
+    FILE* f = fopen(file, "wb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "IO error: could not open file %s \n", file);
+        return -1;
+    }
+    //start up to end, including gaps left by *= / .org
+    uint32_t len = (address)(as->end - as->start);
+    if (len == 0 && as->size > 0) len = 0x10000;
+    for (uint32_t i = 0; i < len; i++)
+        fputc(memPeek(mem, (address)(as->start + i)), f);
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    address origin = 0;
+    const char* output = NULL;
+    int argi = 1;
+
+    while (argi < argc && argv[argi][0] == '-')
+    {
+        if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) origin = strtol(argv[++argi], NULL, 0);
+        else if (strcmp(argv[argi], "-O") == 0 && argi + 1 < argc) output = argv[++argi];
+        else break;
+        argi++;
+    }
+    if (argi >= argc || (output != NULL && argc - argi > 1))
+    {
+        fprintf(stderr, "Usage: %s [-o origin] [-O output] <file.asm> ...\n", argv[0]);
+        fprintf(stderr, "       writes <dir of file>/a.o65 per source unless -O is given (single source only)\n");
+        return -1;
+    }
+
+    static AsmStruct as;
+    TMemory mem = memInit();
+    int failed = 0;
+
+    for (; argi < argc; argi++)
+    {
+        const char* file = argv[argi];
+        char* source = readSource(file);
+        if (source == NULL)
+        {
+            fprintf(stderr, "IO error: could not open file %s \n", file);
+            failed++;
+            continue;
+        }
+
+        memReset(mem);
+        if (asmAssemble(&as, mem, source, origin) != 0)
+        {
+            fprintf(stderr, "%s:%u: error: %s\n", file, as.error_line, as.error);
+            failed++;
+        }
+        else
+        {
+            char out[1024];
+            if (output != NULL) snprintf(out, sizeof(out), "%s", output);
+            else defaultOutput(file, out, sizeof(out));
+            if (writeBinary(&as, mem, out) != 0) failed++;
+        }
+        free(source);
+    }
+
+    free(mem);
+    return failed ? -2 : 0;
+}
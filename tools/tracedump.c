@@ -0,0 +1,132 @@
+/*****************************************************************
+*** Decode a binary execution trace (6502 -t) into text.      ***
+*****************************************************************/
+
+//One line per instruction: cycle, PC, instruction bytes, disassembly and the registers before execution.
+//The trace is read in blocks, so files much larger than RAM are fine.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/trace.h"
+#include "../src/opcodes.h"
+#include "../src/disasm.h"
+
+
+#define BLOCK 65536
+
+
+//one line per record, formatted by hand: printf would make decoding CPU-bound instead of I/O-bound
+static void printRecord(FILE* out, const TTraceRecord* r)
+{
+    char line[128];
+    char* p = line + 10;
+
+    //cycle, right aligned in 10 columns (wider if needed)
+    char digits[20];
+    int n = 0;
+    uint64_t c = r->cycle;
+    do
+    {
+        digits[n++] = '0' + c % 10;
+        c /= 10;
+    } while (c > 0);
+    if (n > 10) p = line + n;
+    memset(line, ' ', p - line - n);
+    for (int i = 0; i < n; i++) p[-1 - i] = digits[i];
+
+    memcpy(p, "  ", 2);
+    p = disasmHex16(p + 2, r->pc);
+    memcpy(p, "  ", 2);
+    p += 2;
+
+    word len = opcodeTable[r->opcode].length;
+    memset(p, ' ', 8);
+    disasmHex8(p, r->opcode);
+    if (len > 1) disasmHex8(p + 3, r->op1);
+    if (len > 2) disasmHex8(p + 6, r->op2);
+    p += 10;
+
+    char text[DISASM_TEXT_MAX];
+    uint32_t tlen = disasmFormat(text, r->pc, r->opcode, r->op1, r->op2);
+    memset(p, ' ', DISASM_TEXT_MAX - 1);
+    memcpy(p, text, tlen);
+    p += DISASM_TEXT_MAX - 1;
+
+    memcpy(p, "A=", 2);
+    p = disasmHex8(p + 2, r->a);
+    memcpy(p, " X=", 3);
+    p = disasmHex8(p + 3, r->x);
+    memcpy(p, " Y=", 3);
+    p = disasmHex8(p + 3, r->y);
+    memcpy(p, " P=", 3);
+    p = disasmHex8(p + 3, r->p);
+    memcpy(p, " SP=", 4);
+    p = disasmHex8(p + 4, r->sp);
+    *p++ = '\n';
+
+    fwrite(line, 1, p - line, out);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <trace-file>\n", argv[0]);
+        return -1;
+    }
+
+    FILE* f = fopen(argv[1], "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "IO error: could not open file %s \n", argv[1]);
+        return -1;
+    }
+
+    char magic[TRACE_MAGIC_LEN];
+    if (fread(magic, 1, TRACE_MAGIC_LEN, f) != TRACE_MAGIC_LEN || memcmp(magic, TRACE_MAGIC, TRACE_MAGIC_LEN) != 0)
+    {
+        fprintf(stderr, "Error: %s is not a 6502 trace file \n", argv[1]);
+        fclose(f);
+        return -2;
+    }
+
+    static char out[1 << 20];
+    setvbuf(stdout, out, _IOFBF, sizeof(out));
+
+    static word buf[BLOCK];
+    uint32_t len = 0;
+    uint32_t pos = 0;
+    uint64_t count = 0;
+    TTraceRecord prev, r;
+    memset(&prev, 0, sizeof(prev));
+
+    while (1)
+    {
+        uint32_t n = traceDecode(&prev, buf + pos, len - pos, &r);
+        if (n == 0)
+        {
+            //record incomplete: move rest to the front and read the next block
+            memmove(buf, buf + pos, len - pos);
+            len -= pos;
+            pos = 0;
+
+            size_t got = fread(buf + len, 1, BLOCK - len, f);
+            if (got == 0) break;
+            len += got;
+            continue;
+        }
+
+        printRecord(stdout, &r);
+        prev = r;
+        pos += n;
+        count++;
+    }
+
+    fclose(f);
+
+    if (pos != len) fprintf(stderr, "Warning: %u trailing bytes, trace is truncated \n", len - pos);
+    fprintf(stderr, "%llu instructions\n", (unsigned long long)count);
+
+    return 0;
+}